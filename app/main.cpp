@@ -1,10 +1,108 @@
 #include "mainwindow.hpp"
 #include "gitversion.hpp"
+#include "repository/skinrepository.hpp"
+#include "repository/skinbatch.hpp"
+#include "repository/assetoptimizer.hpp"
+#include "base/trace.hpp"
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QTextStream>
+
+namespace {
+
+// Batch modes run without a window, they must not need a display
+bool isHeadless(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--validate") == 0 || qstrcmp(argv[i], "--estimate") == 0
+            || qstrncmp(argv[i], "--deploy", 8) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int validateSkins(const QStringList& paths)
+{
+    QTextStream out(stdout);
+    int result = 0;
+    for (const auto& report : SkinBatch::validate(paths)) {
+        if (!report.error.isEmpty()) {
+            out << report.path << ": error: " << report.error << '\n';
+        }
+        for (const auto& d : report.diagnostics) {
+            out << report.path << ": " << Diagnostic::severityName(d.severity) << ": "
+                << d.screen << '/' << d.widget << ": " << d.message << '\n';
+        }
+        if (report.hasErrors()) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+int deploySkin(const QStringList& paths, const QString& target, bool quantize)
+{
+    QTextStream out(stdout);
+    if (paths.size() != 1) {
+        out << "error: exactly one skin must be given to deploy\n";
+        return 1;
+    }
+    const DeployReport report = AssetOptimizer(quantize).deploy(paths.first(), target);
+    if (!report.error.isEmpty()) {
+        out << paths.first() << ": error: " << report.error << '\n';
+        return 1;
+    }
+    int result = 0;
+    for (const auto& asset : report.assets) {
+        if (!asset.error.isEmpty()) {
+            out << asset.fileName << ": error: " << asset.error << '\n';
+            result = 1;
+            continue;
+        }
+        out << asset.fileName << ": " << asset.originalSize << " -> " << asset.optimizedSize
+            << " bytes, saved " << asset.saved() << " ("
+            << (asset.format.isEmpty() ? QString("original") : asset.format) << ")\n";
+    }
+    out << "total: " << report.originalSize() << " -> " << report.optimizedSize()
+        << " bytes, saved " << report.originalSize() - report.optimizedSize() << '\n';
+    return result;
+}
+
+// Quoted CSV field
+QString csvField(QString value)
+{
+    return '"' + value.replace('"', "\"\"") + '"';
+}
+
+int estimateSkins(const QStringList& paths)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    out << "skin,screen,pixmap_bytes,pixmaps,painted_pixels,screen_pixels,overdraw,"
+           "blended_layers\n";
+    int result = 0;
+    for (const auto& report : SkinBatch::estimate(paths)) {
+        if (!report.error.isEmpty()) {
+            err << report.path << ": error: " << report.error << '\n';
+            result = 1;
+        }
+        for (const auto& e : report.estimates) {
+            out << csvField(report.path) << ',' << csvField(e.screen) << ',' << e.pixmapBytes
+                << ',' << e.pixmapCount << ',' << e.paintedArea << ',' << e.screenArea << ','
+                << QString::number(e.overdraw(), 'f', 2) << ',' << e.blendedLayers << '\n';
+        }
+    }
+    return result;
+}
+
+} // namespace
 
 int main(int argc, char* argv[])
 {
+    if (isHeadless(argc, argv) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication app(argc, argv);
     QCoreApplication::setOrganizationName("e2designer");
     QCoreApplication::setApplicationName("e2designer");
@@ -15,14 +113,69 @@ int main(int argc, char* argv[])
     parser.setApplicationDescription(QCoreApplication::applicationName());
     parser.addHelpOption();
     parser.addVersionOption();
-    parser.addPositionalArgument("file", "the skin.xml file to open.");
+    parser.addPositionalArgument("file", "the skin.xml file to open, or skins to validate.");
+    QCommandLineOption cacheOption("model-cache",
+                                   "Keep a binary model cache next to the skin to speed up loading.");
+    parser.addOption(cacheOption);
+    QCommandLineOption traceOption(
+      "trace", "Record load, save, paint and command timings as Chrome trace JSON.", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption validateOption(
+      "validate", "Check the given skins concurrently without opening the editor.");
+    parser.addOption(validateOption);
+    QCommandLineOption estimateOption(
+      "estimate", "Print memory use and overdraw of every screen of the given skins as CSV.");
+    parser.addOption(estimateOption);
+    QCommandLineOption deployOption(
+      "deploy", "Write a copy of the skin with optimised pixmaps to the directory.", "directory");
+    parser.addOption(deployOption);
+    QCommandLineOption quantizeOption(
+      "quantize", "Allow lossy palettes and reduce alpha to the alphatest mode when deploying.");
+    parser.addOption(quantizeOption);
     parser.process(app);
 
+    SkinRepository::instance().setCacheEnabled(parser.isSet(cacheOption));
+
+    // The environment variable allows tracing when started from a launcher
+    QString traceFile = parser.value(traceOption);
+    if (traceFile.isEmpty()) {
+        traceFile = QString::fromLocal8Bit(qgetenv("E2DESIGNER_TRACE"));
+    }
+    Tracer::instance().setEnabled(!traceFile.isEmpty());
+
+    if (parser.isSet(validateOption)) {
+        int result = validateSkins(parser.positionalArguments());
+        if (!traceFile.isEmpty()) {
+            Tracer::instance().exportChromeTrace(traceFile);
+        }
+        return result;
+    }
+    if (parser.isSet(estimateOption)) {
+        int result = estimateSkins(parser.positionalArguments());
+        if (!traceFile.isEmpty()) {
+            Tracer::instance().exportChromeTrace(traceFile);
+        }
+        return result;
+    }
+    if (parser.isSet(deployOption)) {
+        int result = deploySkin(parser.positionalArguments(),
+                                parser.value(deployOption),
+                                parser.isSet(quantizeOption));
+        if (!traceFile.isEmpty()) {
+            Tracer::instance().exportChromeTrace(traceFile);
+        }
+        return result;
+    }
+
     Q_INIT_RESOURCE(resources);
     MainWindow window;
     if (!parser.positionalArguments().isEmpty())
         window.openFile(parser.positionalArguments().first());
     window.show();
 
-    return app.exec();
+    int result = app.exec();
+    if (!traceFile.isEmpty()) {
+        Tracer::instance().exportChromeTrace(traceFile);
+    }
+    return result;
 }
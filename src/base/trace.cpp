@@ -0,0 +1,87 @@
+#include "trace.hpp"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace {
+
+// Small sequential thread numbers read better than native handles
+int currentThread()
+{
+    static std::atomic<int> nextThread{ 1 };
+    thread_local int thread = nextThread++;
+    return thread;
+}
+
+} // namespace
+
+Tracer::Tracer()
+    : m_enabled(false)
+{
+    m_timer.start();
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::addEvent(const char* category,
+                      const char* name,
+                      const QString& detail,
+                      qint64 start,
+                      qint64 duration)
+{
+    Event event{ category, name, detail, start, duration, currentThread() };
+    QMutexLocker locker(&m_mutex);
+    m_events.append(event);
+}
+
+QVector<Tracer::Event> Tracer::events() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_events;
+}
+
+void Tracer::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_events.clear();
+}
+
+QByteArray Tracer::toChromeTrace() const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray array;
+    for (const auto& e : events()) {
+        // Complete events, timestamps in microseconds
+        QJsonObject event;
+        event.insert("cat", e.category);
+        event.insert("name", e.name);
+        event.insert("ph", "X");
+        event.insert("ts", e.start);
+        event.insert("dur", e.duration);
+        event.insert("pid", pid);
+        event.insert("tid", e.thread);
+        if (!e.detail.isEmpty()) {
+            event.insert("args", QJsonObject{ { "detail", e.detail } });
+        }
+        array.append(event);
+    }
+    QJsonObject root{ { "traceEvents", array }, { "displayTimeUnit", "ms" } };
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool Tracer::exportChromeTrace(const QString& fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "failed to write trace:" << file.errorString();
+        return false;
+    }
+    file.write(toChromeTrace());
+    return file.commit();
+}
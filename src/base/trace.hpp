@@ -0,0 +1,97 @@
+#pragma once
+
+#include "base/singleton.hpp"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+/**
+ * @brief collects timed zones and exports them as Chrome trace JSON
+ * Disabled by default, then a zone costs one relaxed atomic load.
+ * The result can be opened in chrome://tracing or ui.perfetto.dev
+ */
+class Tracer : public SingletonMixin<Tracer>
+{
+    Q_DISABLE_COPY(Tracer)
+    friend class SingletonMixin<Tracer>;
+
+public:
+    struct Event
+    {
+        const char* category;
+        const char* name;
+        QString detail;
+        qint64 start; // us since tracer start
+        qint64 duration;
+        int thread;
+    };
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Microseconds since the tracer was created
+    qint64 now() const { return m_timer.nsecsElapsed() / 1000; }
+    void addEvent(const char* category,
+                  const char* name,
+                  const QString& detail,
+                  qint64 start,
+                  qint64 duration);
+
+    QVector<Event> events() const;
+    void clear();
+
+    QByteArray toChromeTrace() const;
+    bool exportChromeTrace(const QString& fileName) const;
+
+private:
+    Tracer();
+
+    std::atomic<bool> m_enabled;
+    QElapsedTimer m_timer;
+    mutable QMutex m_mutex;
+    QVector<Event> m_events;
+};
+
+/**
+ * @brief records the lifetime of the scope as a trace event
+ * category and name must be string literals
+ */
+class TraceZone
+{
+    Q_DISABLE_COPY(TraceZone)
+
+public:
+    TraceZone(const char* category, const char* name)
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::instance().isEnabled() ? Tracer::instance().now() : -1)
+    {}
+    ~TraceZone()
+    {
+        if (m_start >= 0) {
+            auto& tracer = Tracer::instance();
+            tracer.addEvent(m_category, m_name, m_detail, m_start, tracer.now() - m_start);
+        }
+    }
+
+    bool isActive() const { return m_start >= 0; }
+    // Shown in the event arguments, check isActive() before building expensive strings
+    void setDetail(const QString& detail)
+    {
+        if (isActive()) {
+            m_detail = detail;
+        }
+    }
+
+private:
+    const char* m_category;
+    const char* m_name;
+    qint64 m_start;
+    QString m_detail;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(category, name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(category, name)
@@ -1,3 +1,3 @@
 #include "uniqueid.hpp"
 
-uint UniqueId::nextId = 0;
+std::atomic<uint> UniqueId::nextId{ UniqueId::invalid + 1 };
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <QtGlobal>
+#include <atomic>
 #include <limits>
 
 class UniqueId
 {
 public:
+    // Never assigned to an object
+    static constexpr uint invalid = 0;
+
     UniqueId()
         : m_id(getNextId())
     {}
@@ -43,12 +47,14 @@ public:
     uint id() const { return m_id; }
 
 private:
-    static uint nextId;
+    // Objects are also created by parsers in worker threads
+    static std::atomic<uint> nextId;
     static uint getNextId()
     {
         // TODO: if you need more ids you should somehow reuse
-        Q_ASSERT(nextId < std::numeric_limits<uint>::max());
-        return nextId++;
+        const uint id = nextId.fetch_add(1, std::memory_order_relaxed);
+        Q_ASSERT(id < std::numeric_limits<uint>::max());
+        return id;
     }
     uint m_id;
 };
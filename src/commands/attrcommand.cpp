@@ -1,5 +1,7 @@
 #include "attrcommand.hpp"
 #include "skin/widgetdata.hpp"
+#include "model/screensmodel.hpp"
+#include "base/trace.hpp"
 
 AttrCommand::AttrCommand(WidgetData* widget, int key, const QVariant& value, QUndoCommand* parent)
     : QUndoCommand(parent)
@@ -18,14 +20,54 @@ AttrCommand::AttrCommand(WidgetData* widget, int key, const QVariant& value, QUn
 
 void AttrCommand::redo()
 {
+    TRACE_ZONE("command", "AttrCommand::redo");
     m_widget->setAttr(m_key, m_value);
 }
 
 void AttrCommand::undo()
 {
+    TRACE_ZONE("command", "AttrCommand::undo");
     m_widget->setAttr(m_key, m_oldValue);
 }
 
+BatchAttrCommand::BatchAttrCommand(const QVector<WidgetData*>& widgets,
+                                   int key,
+                                   const QVariant& value,
+                                   QUndoCommand* parent)
+    : QUndoCommand(parent)
+    , m_widgets(widgets)
+    , m_key(key)
+    , m_value(value)
+{
+    Q_ASSERT(!m_widgets.isEmpty());
+    m_oldValues.reserve(m_widgets.size());
+    for (auto* w : qAsConst(m_widgets)) {
+        m_oldValues.append(w->getAttr(m_key));
+    }
+
+    int index = key + 1; // first key is invalid
+    const QString name(Property::propertyEnum().key(index));
+    setText(QString("%1 = %2 (%3 widgets)").arg(name, value.toString()).arg(m_widgets.size()));
+}
+
+void BatchAttrCommand::redo()
+{
+    TRACE_ZONE("command", "BatchAttrCommand::redo");
+    WidgetChangesBatch batch(m_widgets.first()->model());
+    for (auto* w : qAsConst(m_widgets)) {
+        w->setAttr(m_key, m_value);
+    }
+}
+
+void BatchAttrCommand::undo()
+{
+    TRACE_ZONE("command", "BatchAttrCommand::undo");
+    WidgetChangesBatch batch(m_widgets.first()->model());
+    for (int i = 0; i < m_widgets.size(); ++i) {
+        m_widgets[i]->setAttr(m_key, m_oldValues[i]);
+    }
+}
+
 QVector<int> pathFromIndex(QModelIndex idx)
 {
     QVector<int> path;
@@ -55,11 +97,13 @@ MoveWidgetCommand::MoveWidgetCommand(WidgetData* widget, QPointF pos)
 
 void MoveWidgetCommand::redo()
 {
+    TRACE_ZONE("command", "MoveWidgetCommand::redo");
     m_widget->move(m_point);
 }
 
 void MoveWidgetCommand::undo()
 {
+    TRACE_ZONE("command", "MoveWidgetCommand::undo");
     m_widget->setPosition(m_pos);
 }
 
@@ -82,6 +126,54 @@ void MoveWidgetCommand::updateText()
     setText(QString("Move %1,%2").arg(m_point.toPoint().x()).arg(m_point.toPoint().y()));
 }
 
+MoveWidgetsCommand::MoveWidgetsCommand(const QVector<WidgetData*>& widgets,
+                                       const QVector<QPoint>& points,
+                                       bool mergeable,
+                                       QUndoCommand* parent)
+    : QUndoCommand(parent)
+    , m_widgets(widgets)
+    , m_points(points)
+    , m_mergeable(mergeable)
+{
+    Q_ASSERT(!m_widgets.isEmpty() && m_widgets.size() == m_points.size());
+    m_positions.reserve(m_widgets.size());
+    for (auto* w : qAsConst(m_widgets)) {
+        m_positions.append(w->position());
+    }
+    setText(QString("Move %1 widgets").arg(m_widgets.size()));
+}
+
+void MoveWidgetsCommand::redo()
+{
+    TRACE_ZONE("command", "MoveWidgetsCommand::redo");
+    WidgetChangesBatch batch(m_widgets.first()->model());
+    for (int i = 0; i < m_widgets.size(); ++i) {
+        m_widgets[i]->move(m_points[i]);
+    }
+}
+
+void MoveWidgetsCommand::undo()
+{
+    TRACE_ZONE("command", "MoveWidgetsCommand::undo");
+    WidgetChangesBatch batch(m_widgets.first()->model());
+    for (int i = 0; i < m_widgets.size(); ++i) {
+        m_widgets[i]->setPosition(m_positions[i]);
+    }
+}
+
+bool MoveWidgetsCommand::mergeWith(const QUndoCommand* other)
+{
+    if (!m_mergeable || id() != other->id()) {
+        return false;
+    }
+    auto otherCommand = static_cast<const MoveWidgetsCommand*>(other);
+    if (otherCommand->m_widgets == m_widgets) {
+        m_points = otherCommand->m_points;
+        return true;
+    }
+    return false;
+}
+
 ResizeWidgetCommand::ResizeWidgetCommand(WidgetData* widget, QSizeF size)
     : m_widget(widget)
     , m_size(size)
@@ -92,11 +184,13 @@ ResizeWidgetCommand::ResizeWidgetCommand(WidgetData* widget, QSizeF size)
 
 void ResizeWidgetCommand::redo()
 {
+    TRACE_ZONE("command", "ResizeWidgetCommand::redo");
     m_widget->resize(m_size);
 }
 
 void ResizeWidgetCommand::undo()
 {
+    TRACE_ZONE("command", "ResizeWidgetCommand::undo");
     m_widget->setSize(m_value);
 }
 
@@ -130,12 +224,14 @@ ChangeRectWidgetCommand::ChangeRectWidgetCommand(WidgetData* widget, QRectF rect
 
 void ChangeRectWidgetCommand::redo()
 {
+    TRACE_ZONE("command", "ChangeRectWidgetCommand::redo");
     m_widget->resize(m_rect.size());
     m_widget->move(m_rect.topLeft());
 }
 
 void ChangeRectWidgetCommand::undo()
 {
+    TRACE_ZONE("command", "ChangeRectWidgetCommand::undo");
     m_widget->setSize(m_size);
     m_widget->setPosition(m_pos);
 }
@@ -13,17 +13,23 @@ QVector<int> pathFromIndex(QModelIndex idx);
 QModelIndex pathToIndex(QVector<int> path, QAbstractItemModel* model);
 
 class AttrCommand;
+class BatchAttrCommand;
 class MoveWidgetCommand;
+class MoveWidgetsCommand;
 class ResizeWidgetCommand;
 class ChangeRectWidgetCommand;
 class RemoveRowsCommand;
 class InsertRowsCommand;
+class MoveRowsCommand;
 using CommandClasses = TypeList<AttrCommand,
                                 MoveWidgetCommand,
                                 ResizeWidgetCommand,
                                 ChangeRectWidgetCommand,
                                 RemoveRowsCommand,
-                                InsertRowsCommand>;
+                                InsertRowsCommand,
+                                BatchAttrCommand,
+                                MoveWidgetsCommand,
+                                MoveRowsCommand>;
 
 template<typename T>
 static inline int getCommandId()
@@ -50,6 +56,27 @@ private:
     QVariant m_value;
 };
 
+/**
+ * @brief Sets the same attribute value on several widgets
+ * Model notifications are batched, so views are updated once.
+ */
+class BatchAttrCommand : public QUndoCommand
+{
+public:
+    BatchAttrCommand(const QVector<WidgetData*>& widgets,
+                     int key,
+                     const QVariant& value,
+                     QUndoCommand* parent = nullptr);
+    void redo() final;
+    void undo() final;
+
+private:
+    QVector<WidgetData*> m_widgets;
+    int m_key;
+    QVector<QVariant> m_oldValues;
+    QVariant m_value;
+};
+
 class MoveWidgetCommand : public QUndoCommand
 {
 public:
@@ -66,6 +93,30 @@ private:
     PositionAttr m_pos;
 };
 
+/**
+ * @brief Moves several widgets at once (align, distribute, nudge)
+ * Consecutive mergeable moves of the same set of widgets, which are
+ * keyboard nudges, become one step. Other moves are never merged.
+ */
+class MoveWidgetsCommand : public QUndoCommand
+{
+public:
+    MoveWidgetsCommand(const QVector<WidgetData*>& widgets,
+                       const QVector<QPoint>& points,
+                       bool mergeable = false,
+                       QUndoCommand* parent = nullptr);
+    int id() const final { return m_mergeable ? getCommandId<decltype(this)>() : -1; }
+    void redo() final;
+    void undo() final;
+    bool mergeWith(const QUndoCommand* other) final;
+
+private:
+    QVector<WidgetData*> m_widgets;
+    QVector<QPoint> m_points;
+    QVector<PositionAttr> m_positions;
+    bool m_mergeable;
+};
+
 class ResizeWidgetCommand : public QUndoCommand
 {
 public:
@@ -0,0 +1,126 @@
+#include "retargetcommand.hpp"
+#include "skin/widgetdata.hpp"
+#include "model/screensmodel.hpp"
+#include "model/outputsmodel.hpp"
+#include "base/trace.hpp"
+
+RetargetCommand::RetargetCommand(WidgetData& root,
+                                 OutputsModel& outputs,
+                                 WindowStylesList& styles,
+                                 const QSize& resolution,
+                                 QUndoCommand* parent)
+    : QUndoCommand(parent)
+    , m_root(root)
+    , m_outputs(outputs)
+    , m_styles(styles)
+    , m_oldResolution(outputs.getOutput(0).size())
+    , m_resolution(resolution)
+{
+    TRACE_ZONE("command", "RetargetCommand::RetargetCommand");
+    // Can not work without a model
+    Q_ASSERT(m_root.model() != nullptr);
+    Q_ASSERT(!m_oldResolution.isEmpty());
+
+    const qreal sx = qreal(m_resolution.width()) / m_oldResolution.width();
+    const qreal sy = qreal(m_resolution.height()) / m_oldResolution.height();
+    collectWidgets(sx, sy);
+    collectStyles(sx, sy);
+    setText(QString("retarget to %1x%2").arg(m_resolution.width()).arg(m_resolution.height()));
+}
+
+void RetargetCommand::redo()
+{
+    TRACE_ZONE("command", "RetargetCommand::redo");
+    apply(true);
+}
+
+void RetargetCommand::undo()
+{
+    TRACE_ZONE("command", "RetargetCommand::undo");
+    apply(false);
+}
+
+void RetargetCommand::collectWidgets(qreal sx, qreal sy)
+{
+    auto change = [this](WidgetData* w, int key, const QVariant& value, bool changed) {
+        if (changed) {
+            m_changes.append({ w, key, w->getAttr(key), value });
+        }
+    };
+    // Lines should not disappear when scaled down
+    const qreal lineScale = qMin(sx, sy);
+
+    QVector<WidgetData*> stack;
+    for (int i = 0; i < m_root.childCount(); ++i) {
+        stack.append(m_root.child(i));
+    }
+    while (!stack.isEmpty()) {
+        WidgetData* w = stack.takeLast();
+        for (int i = 0; i < w->childCount(); ++i) {
+            stack.append(w->child(i));
+        }
+
+        const PositionAttr position = w->position().scaled(sx, sy);
+        change(w,
+               Property::position,
+               QVariant::fromValue(position),
+               position.toStr() != w->position().toStr());
+        const SizeAttr size = w->size().scaled(sx, sy);
+        change(w, Property::size, QVariant::fromValue(size), size.toStr() != w->size().toStr());
+        const FontAttr font = w->font().scaled(sy);
+        change(w, Property::font, QVariant::fromValue(font), font.size() != w->font().size());
+        const OffsetAttr offset = w->shadowOffset().scaled(sx, sy);
+        change(w,
+               Property::shadowOffset,
+               QVariant::fromValue(offset),
+               offset.toStr() != w->shadowOffset().toStr());
+        if (w->itemHeight() > 0) {
+            const int itemHeight = qMax(1, qRound(w->itemHeight() * sy));
+            change(w, Property::itemHeight, itemHeight, itemHeight != w->itemHeight());
+        }
+        if (w->borderWidth() > 0) {
+            const int borderWidth = qMax(1, qRound(w->borderWidth() * lineScale));
+            change(w, Property::borderWidth, borderWidth, borderWidth != w->borderWidth());
+        }
+    }
+}
+
+void RetargetCommand::collectStyles(qreal sx, qreal sy)
+{
+    for (const WindowStyle& style : m_styles) {
+        const WindowStyleTitle title = style.title();
+        WindowStyleTitle scaled;
+        scaled.position = title.position.scaled(sx, sy);
+        scaled.font = title.font.scaled(sy);
+        if (scaled.position.toStr() != title.position.toStr()
+            || scaled.font.size() != title.font.size()) {
+            m_styleChanges.append({ style.name(), title, scaled });
+        }
+    }
+}
+
+void RetargetCommand::apply(bool forward)
+{
+    // Everything is reported to views in one go
+    WidgetChangesBatch batch(m_root.model());
+    m_outputs.setResolution(0, forward ? m_resolution : m_oldResolution);
+
+    for (const auto& change : qAsConst(m_styleChanges)) {
+        const int i = m_styles.getIndex(change.name);
+        if (i < 0)
+            continue;
+        WindowStyle style = m_styles.itemAt(i);
+        style.setTitle(forward ? change.newTitle : change.oldTitle);
+        m_styles.setStyle(i, style);
+    }
+
+    if (forward) {
+        for (const auto& change : qAsConst(m_changes)) {
+            change.widget->setAttr(change.key, change.newValue);
+        }
+    } else {
+        for (auto it = m_changes.crbegin(); it != m_changes.crend(); ++it) {
+            it->widget->setAttr(it->key, it->oldValue);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "model/windowstyle.hpp"
+#include <QSize>
+#include <QUndoCommand>
+#include <QVariant>
+#include <QVector>
+
+class WidgetData;
+class OutputsModel;
+
+/**
+ * @brief Scales the whole document to another output resolution
+ * Pixel positions and sizes, font sizes, item heights, border widths and
+ * shadow offsets of all widgets, titles of window styles and the first
+ * output change in one step with one batched notification. Center,
+ * percent and fill values are relative already and stay as they are.
+ */
+class RetargetCommand : public QUndoCommand
+{
+public:
+    RetargetCommand(WidgetData& root,
+                    OutputsModel& outputs,
+                    WindowStylesList& styles,
+                    const QSize& resolution,
+                    QUndoCommand* parent = nullptr);
+    void redo() final;
+    void undo() final;
+
+    // Widget attributes changed by the command
+    int changeCount() const { return m_changes.size(); }
+
+private:
+    struct Change
+    {
+        WidgetData* widget;
+        int key;
+        QVariant oldValue;
+        QVariant newValue;
+    };
+    struct StyleChange
+    {
+        QString name;
+        WindowStyleTitle oldTitle;
+        WindowStyleTitle newTitle;
+    };
+    void collectWidgets(qreal sx, qreal sy);
+    void collectStyles(qreal sx, qreal sy);
+    void apply(bool forward);
+
+    // Reference to the root element of the model
+    WidgetData& m_root;
+    OutputsModel& m_outputs;
+    WindowStylesList& m_styles;
+    QSize m_oldResolution;
+    QSize m_resolution;
+    QVector<Change> m_changes;
+    QVector<StyleChange> m_styleChanges;
+};
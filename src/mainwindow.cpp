@@ -5,18 +5,25 @@
 #include <QColorDialog>
 #include <QFile>
 #include <QBuffer>
+#include <QClipboard>
 #include <QFileDialog>
 #include <QGraphicsView>
 #include <QItemEditorFactory>
 #include <QLineEdit>
+#include <QDockWidget>
+#include <QListView>
 #include <QMenu>
 #include <QMessageBox>
+#include <QMimeData>
 #include <QRgb>
 #include <QScreen>
 #include <QSettings>
 #include <QStyledItemDelegate>
+#include <QHeaderView>
+#include <QInputDialog>
 #include <QSpinBox>
 #include <QSplitter>
+#include <QStatusBar>
 
 #include "colorlistbox.hpp"
 #include "colorlistwindow.hpp"
@@ -24,7 +31,11 @@
 #include "fontlistwindow.hpp"
 #include "listbox.hpp"
 #include "model/colorsmodel.hpp"
+#include "model/screenestimator.hpp"
+#include "model/skinvalidator.hpp"
+#include "model/thumbnailsmodel.hpp"
 #include "repository/skinrepository.hpp"
+#include "repository/assetoptimizer.hpp"
 #include "outputslistwindow.hpp"
 
 #ifdef APPIMAGE_UPDATE
@@ -83,6 +94,19 @@ MainWindow::MainWindow(QWidget* parent)
             this,
             &MainWindow::setTitle);
 
+    // Files edited by other programs are merged into the open skin
+    SkinRepository::instance().setWatchEnabled(true);
+    auto* watcher = SkinRepository::instance().watcher();
+    connect(watcher, &SkinWatcher::reloaded, this, [this](const QString& fileName) {
+        statusBar()->showMessage(tr("Reloaded %1").arg(fileName), 5000);
+    });
+    connect(watcher,
+            &SkinWatcher::reloadFailed,
+            this,
+            [this](const QString& fileName, const QString& error) {
+                statusBar()->showMessage(tr("Can not reload %1: %2").arg(fileName, error));
+            });
+
     ui->propView->setModel(m_propertiesModel);
     // start editing with one click
     connect(ui->propView,
@@ -118,6 +142,14 @@ MainWindow::MainWindow(QWidget* parent)
             &QItemSelectionModel::currentChanged,
             this,
             &MainWindow::onCurrentSelectionChanged);
+    connect(ui->treeView->selectionModel(),
+            &QItemSelectionModel::selectionChanged,
+            this,
+            &MainWindow::onSelectionChanged);
+
+    createThumbnailsDock();
+    createDiagnosticsDock();
+    createEstimatesDock();
 }
 
 MainWindow::~MainWindow()
@@ -153,11 +185,10 @@ void MainWindow::onCurrentSelectionChanged(const QModelIndex& index, const QMode
     Q_UNUSED(previous);
     qDebug() << "current changed" << index;
     m_propertiesModel->setWidget(index);
+    // Rows are kept between widgets, so groups of the previous render are collapsed
     for (int i = 0; i < m_propertiesModel->rowCount(); i++) {
         auto index = m_propertiesModel->index(i, 0);
-        if (index.data(ShallExpandRole).toBool()) {
-            ui->propView->expand(index);
-        }
+        ui->propView->setExpanded(index, index.data(ShallExpandRole).toBool());
     }
 
     setEditorText(index);
@@ -324,10 +355,17 @@ void MainWindow::delWidget()
 {
     if (!m_scene)
         return;
-    QModelIndex idx = ui->treeView->selectionModel()->currentIndex();
-    SkinRepository::screens()->removeRow(idx.row(), idx.parent());
-    //    mView->deleteSelected();
-    // FIXME: is m_view always authoritative?
+    SkinRepository::screens()->removeWidgets(selectedWidgets());
+}
+
+QModelIndexList MainWindow::selectedWidgets() const
+{
+    return ui->treeView->selectionModel()->selectedRows(ScreensModel::ColumnElement);
+}
+
+void MainWindow::onSelectionChanged()
+{
+    m_propertiesModel->setTargets(selectedWidgets());
 }
 
 void MainWindow::editColors()
@@ -467,10 +505,252 @@ void MainWindow::createActions()
     connect(ui->actionEditFonts, &QAction::triggered, this, &MainWindow::editFonts);
     connect(ui->actionEditOutputs, &QAction::triggered, this, &MainWindow::editOutputs);
 
+    createArrangeMenu();
+    createClipboardActions();
+    createRetargetAction();
+
     // Connect buttons
     connect(ui->refreshButton, &QPushButton::clicked, this, &MainWindow::loadEditorText);
 }
 
+void MainWindow::createArrangeMenu()
+{
+    auto* menu = new QMenu(tr("Arrange"), this);
+    ui->menuBar->insertMenu(ui->menuView->menuAction(), menu);
+
+    auto addAlign = [this, menu](const QString& text, Qt::Alignment alignment) {
+        connect(menu->addAction(text), &QAction::triggered, this, [this, alignment] {
+            SkinRepository::screens()->alignWidgets(selectedWidgets(), alignment);
+        });
+    };
+    addAlign(tr("Align Left"), Qt::AlignLeft);
+    addAlign(tr("Align Horizontal Center"), Qt::AlignHCenter);
+    addAlign(tr("Align Right"), Qt::AlignRight);
+    menu->addSeparator();
+    addAlign(tr("Align Top"), Qt::AlignTop);
+    addAlign(tr("Align Vertical Center"), Qt::AlignVCenter);
+    addAlign(tr("Align Bottom"), Qt::AlignBottom);
+    menu->addSeparator();
+
+    auto addDistribute = [this, menu](const QString& text, Qt::Orientation orientation) {
+        connect(menu->addAction(text), &QAction::triggered, this, [this, orientation] {
+            SkinRepository::screens()->distributeWidgets(selectedWidgets(), orientation);
+        });
+    };
+    addDistribute(tr("Distribute Horizontally"), Qt::Horizontal);
+    addDistribute(tr("Distribute Vertically"), Qt::Vertical);
+}
+
+void MainWindow::createClipboardActions()
+{
+    auto* copy = new QAction(tr("Copy"), this);
+    copy->setShortcut(QKeySequence::Copy);
+    connect(copy, &QAction::triggered, this, [this] {
+        QApplication::clipboard()->setMimeData(
+          SkinRepository::screens()->copyWidgets(selectedWidgets()));
+    });
+
+    auto* paste = new QAction(tr("Paste"), this);
+    paste->setShortcut(QKeySequence::Paste);
+    connect(paste, &QAction::triggered, this, &MainWindow::pasteWidgets);
+
+    auto* duplicate = new QAction(tr("Duplicate"), this);
+    duplicate->setShortcut(QKeySequence(Qt::CTRL + Qt::Key_D));
+    connect(duplicate, &QAction::triggered, this, [this] {
+        SkinRepository::screens()->duplicateWidgets(selectedWidgets());
+    });
+
+    ui->menuEdit->insertActions(ui->actionAddWidget, { copy, paste, duplicate });
+    ui->menuEdit->insertSeparator(ui->actionAddWidget);
+}
+
+void MainWindow::createRetargetAction()
+{
+    auto* retarget = new QAction(tr("Retarget Resolution..."), this);
+    connect(retarget, &QAction::triggered, this, &MainWindow::retargetSkin);
+    ui->menuEdit->insertAction(ui->actionFitPixmap, retarget);
+}
+
+void MainWindow::retargetSkin()
+{
+    auto* outputs = SkinRepository::outputs();
+    const QSize current = outputs->getOutput(0).size();
+    if (current.isEmpty()) {
+        QMessageBox::warning(this, tr("Retarget"), tr("The skin has no output resolution."));
+        return;
+    }
+
+    const QStringList presets{ "1280x720", "1920x1080", "3840x2160" };
+    bool ok = false;
+    const QString text = QInputDialog::getItem(this,
+                                               tr("Retarget"),
+                                               tr("Output resolution (now %1x%2):")
+                                                 .arg(current.width())
+                                                 .arg(current.height()),
+                                               presets,
+                                               1,
+                                               true,
+                                               &ok);
+    const QStringList parts = text.split('x');
+    if (!ok || parts.size() != 2)
+        return;
+    const QSize resolution(parts[0].trimmed().toInt(), parts[1].trimmed().toInt());
+    if (resolution.isEmpty() || resolution == current)
+        return;
+
+    // Pixmaps are written to a separate directory, the skin keeps its files
+    const auto answer = QMessageBox::question(
+      this, tr("Retarget"), tr("Write resampled copies of the pixmaps to another directory?"));
+    if (answer == QMessageBox::Yes) {
+        const QString target = QFileDialog::getExistingDirectory(this, tr("Pixmap directory"));
+        if (target.isEmpty())
+            return;
+        const DeployReport report =
+          AssetOptimizer().resample(qreal(resolution.width()) / current.width(),
+                                    qreal(resolution.height()) / current.height(),
+                                    target);
+        if (!report.error.isEmpty()) {
+            QMessageBox::warning(this, tr("Retarget"), report.error);
+            return;
+        }
+        for (const auto& asset : report.assets) {
+            if (!asset.error.isEmpty()) {
+                qWarning() << "Can not resample" << asset.fileName << asset.error;
+            }
+        }
+    }
+
+    SkinRepository::screens()->retarget(resolution, *outputs, *SkinRepository::styles());
+    statusBar()->showMessage(
+      tr("Retargeted to %1x%2").arg(resolution.width()).arg(resolution.height()), 5000);
+}
+
+void MainWindow::pasteWidgets()
+{
+    auto* model = SkinRepository::screens();
+    const QMimeData* data = QApplication::clipboard()->mimeData();
+    QModelIndex index = ui->treeView->selectionModel()->currentIndex();
+    index = index.sibling(index.row(), ScreensModel::ColumnElement);
+
+    // Into the current widget, next to it or as a new screen
+    if (index.isValid() && model->pasteWidgets(data, index, model->rowCount(index)))
+        return;
+    if (index.isValid() && model->pasteWidgets(data, index.parent(), index.row() + 1))
+        return;
+    model->pasteWidgets(data, QModelIndex(), model->rowCount());
+}
+
+void MainWindow::createThumbnailsDock()
+{
+    auto* model = new ThumbnailsModel(SkinRepository::screens(), this);
+    auto* view = new QListView();
+    view->setModel(model);
+    view->setViewMode(QListView::IconMode);
+    view->setResizeMode(QListView::Adjust);
+    view->setMovement(QListView::Static);
+    view->setUniformItemSizes(true);
+    view->setIconSize(model->thumbnailSize());
+    view->setSpacing(4);
+
+    // Jump to the screen in the tree, the scene follows the current index
+    connect(view, &QListView::activated, this, [this, model](const QModelIndex& index) {
+        ui->treeView->setCurrentIndex(model->mapToSource(index));
+    });
+
+    auto* dock = new QDockWidget(tr("Screens"), this);
+    dock->setObjectName("thumbnailsDock");
+    dock->setWidget(view);
+    addDockWidget(Qt::LeftDockWidgetArea, dock);
+    dock->hide();
+    ui->menuView->addAction(dock->toggleViewAction());
+}
+
+void MainWindow::createDiagnosticsDock()
+{
+    auto* outputs = SkinRepository::outputs();
+    auto* validator = new SkinValidator(SkinRepository::screens(), this);
+    validator->setOutputRect(QRect(QPoint(0, 0), outputs->getOutput(0).size()));
+    connect(outputs,
+            &OutputsModel::valueChanged,
+            this,
+            [validator](int id, const VideoOutput& output) {
+                if (id == 0) {
+                    validator->setOutputRect(QRect(QPoint(0, 0), output.size()));
+                }
+            });
+
+    auto* view = new QTreeView();
+    view->setModel(validator);
+    view->setRootIsDecorated(false);
+    view->setUniformRowHeights(true);
+    view->header()->setStretchLastSection(true);
+
+    // Jump to the widget, the scene follows the current index
+    connect(view, &QTreeView::activated, this, [this](const QModelIndex& index) {
+        uint id = index.data(SkinValidator::WidgetIdRole).toUInt();
+        QModelIndex widget = SkinRepository::screens()->indexFromId(id);
+        if (widget.isValid()) {
+            ui->treeView->setCurrentIndex(widget);
+        }
+    });
+
+    auto* dock = new QDockWidget(tr("Diagnostics"), this);
+    dock->setObjectName("diagnosticsDock");
+    dock->setWidget(view);
+    addDockWidget(Qt::BottomDockWidgetArea, dock);
+    dock->hide();
+    ui->menuView->addAction(dock->toggleViewAction());
+
+    // Show the count in the title
+    connect(validator, &QAbstractItemModel::modelReset, dock, [dock, validator] {
+        const int count = validator->rowCount();
+        dock->setWindowTitle(count ? tr("Diagnostics (%1)").arg(count) : tr("Diagnostics"));
+    });
+}
+
+void MainWindow::createEstimatesDock()
+{
+    auto* outputs = SkinRepository::outputs();
+    auto* estimator = new ScreenEstimator(SkinRepository::screens(), this);
+    estimator->setBpp(outputs->getOutput(0).bpp());
+    connect(outputs,
+            &OutputsModel::valueChanged,
+            this,
+            [estimator](int id, const VideoOutput& output) {
+                if (id == 0) {
+                    estimator->setBpp(output.bpp());
+                }
+            });
+
+    auto* proxy = new QSortFilterProxyModel(this);
+    proxy->setSourceModel(estimator);
+    proxy->setSortRole(ScreenEstimator::SortRole);
+
+    auto* view = new QTreeView();
+    view->setModel(proxy);
+    view->setRootIsDecorated(false);
+    view->setUniformRowHeights(true);
+    view->setSortingEnabled(true);
+    view->sortByColumn(ScreenEstimator::ColumnPixmapBytes, Qt::DescendingOrder);
+    view->header()->setStretchLastSection(true);
+
+    // Jump to the screen, the scene follows the current index
+    connect(view, &QTreeView::activated, this, [this](const QModelIndex& index) {
+        uint id = index.data(ScreenEstimator::WidgetIdRole).toUInt();
+        QModelIndex screen = SkinRepository::screens()->indexFromId(id);
+        if (screen.isValid()) {
+            ui->treeView->setCurrentIndex(screen);
+        }
+    });
+
+    auto* dock = new QDockWidget(tr("Performance"), this);
+    dock->setObjectName("performanceDock");
+    dock->setWidget(view);
+    addDockWidget(Qt::BottomDockWidgetArea, dock);
+    dock->hide();
+    ui->menuView->addAction(dock->toggleViewAction());
+}
+
 void MainWindow::readSettings()
 {
     QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
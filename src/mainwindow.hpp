@@ -36,6 +36,7 @@ protected:
 
 private slots:
     void onCurrentSelectionChanged(const QModelIndex& index, const QModelIndex& previous);
+    void onSelectionChanged();
 
     void newSkin();
     void open();
@@ -64,6 +65,16 @@ private slots:
 private:
     // menu and toolbar
     void createActions();
+    void createArrangeMenu();
+    void createClipboardActions();
+    void pasteWidgets();
+    void createRetargetAction();
+    void retargetSkin();
+    void createThumbnailsDock();
+    void createDiagnosticsDock();
+    void createEstimatesDock();
+    // Selected widgets in the tree view, one index per row
+    QModelIndexList selectedWidgets() const;
     void readSettings();
     void writeSettings();
     // shows save before close dialog
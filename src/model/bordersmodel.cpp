@@ -7,8 +7,8 @@ void BorderStorage::setStyle(WindowStyle* style)
         auto bs = style->borderSet();
         for (int i = 0; i < BorderSet::count(); ++i) {
             auto bp = static_cast<Property::BorderPosition>(i);
-            auto path = SkinRepository::instance().resolveFilename(bs.getBorder(bp).fileName());
-            pixmaps[bp].load(path);
+            auto path = SkinRepository::current().resolveFilename(bs.getBorder(bp).fileName());
+            pixmaps[bp] = PixmapStorage::pixmap(path);
             observers[bp]->setPath(path);
         }
     } else {
@@ -17,4 +17,5 @@ void BorderStorage::setStyle(WindowStyle* style)
             observers[i]->setPath(QString());
         }
     }
+    emit changed();
 }
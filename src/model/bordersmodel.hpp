@@ -46,7 +46,7 @@ private:
 
     void reload(int index, const QString& path)
     {
-        pixmaps[index].load(path);
+        pixmaps[index] = PixmapStorage::pixmap(path);
         emit changed();
     }
 
@@ -77,6 +77,28 @@ void ColorsList::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void ColorsList::fromStream(QDataStream& stream)
+{
+    removeItems(0, itemsCount());
+
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString name;
+        quint32 value;
+        stream >> name >> value;
+        appendItem(Color(name, value));
+    }
+}
+
+void ColorsList::toStream(QDataStream& stream) const
+{
+    stream << qint32(itemsCount());
+    for (const Color& item : *this) {
+        stream << item.name() << quint32(item.value());
+    }
+}
+
 // ColorsModel
 
 ColorsModel::ColorsModel(QObject* parent)
@@ -250,6 +272,13 @@ void ColorsModel::fromXml(QXmlStreamReader& xml)
     endResetModel();
 }
 
+void ColorsModel::fromStream(QDataStream& stream)
+{
+    beginResetModel();
+    ColorsList::fromStream(stream);
+    endResetModel();
+}
+
 void ColorsModel::emitValueChanged(const QString& name, const Color& value) const
 {
     emit valueChanged(name, value.value());
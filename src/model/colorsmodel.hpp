@@ -8,6 +8,7 @@
 
 class QXmlStreamReader;
 class QXmlStreamWriter;
+class QDataStream;
 
 /**
  * @brief Stores color (name, value) pair defined in skin
@@ -39,9 +40,11 @@ class ColorsList : public NamedList<Color>, public XmlData
 {
 protected:
     void fromXml(QXmlStreamReader& xml);
+    void fromStream(QDataStream& stream);
 
 public:
     void toXml(QXmlStreamWriter& xml) const;
+    void toStream(QDataStream& stream) const;
 };
 
 /**
@@ -96,6 +99,8 @@ public:
 
     // Xml:
     void fromXml(QXmlStreamReader& xml);
+    // Binary cache:
+    void fromStream(QDataStream& stream);
 
     // Get value by name:
     //    inline bool contains(QString name) { return
@@ -2,6 +2,7 @@
 #include "repository/skinrepository.hpp"
 #include <QCoreApplication>
 #include <QDebug>
+#include <QDataStream>
 #include <QFontDatabase>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
@@ -48,12 +49,12 @@ void Font::load()
 {
     m_fontId = -1;
     QString fname = m_fileName;
-    if (fname.isEmpty()) {
+    if (fname.isEmpty() || SkinRepository::current().isHeadless()) {
         return;
     }
-    if (SkinRepository::instance().dir().exists(fname)) {
+    if (SkinRepository::current().dir().exists(fname)) {
         // add font from skin
-        fname = SkinRepository::instance().dir().filePath(fname);
+        fname = SkinRepository::current().dir().filePath(fname);
     } else {
         // add font from default collection
         QDir dir = QDir(QCoreApplication::applicationDirPath());
@@ -110,6 +111,27 @@ void FontsList::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void FontsList::fromStream(QDataStream& stream)
+{
+    removeItems(0, itemsCount());
+
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString name, fileName;
+        stream >> name >> fileName;
+        appendItem(Font(name, fileName));
+    }
+}
+
+void FontsList::toStream(QDataStream& stream) const
+{
+    stream << qint32(itemsCount());
+    for (const Font& f : *this) {
+        stream << f.name() << f.value();
+    }
+}
+
 // FontsModel
 
 FontsModel::FontsModel(QObject* parent)
@@ -238,6 +260,14 @@ void FontsModel::toXml(QXmlStreamWriter& xml) const
 {
     FontsList::toXml(xml);
 }
+
+void FontsModel::fromStream(QDataStream& stream)
+{
+    beginResetModel();
+    FontsList::fromStream(stream);
+    endResetModel();
+}
+
 void FontsModel::emitValueChanged(const QString& name, const Font& value) const
 {
     emit valueChanged(name, value);
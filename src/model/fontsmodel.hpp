@@ -6,6 +6,7 @@
 
 class QXmlStreamReader;
 class QXmlStreamWriter;
+class QDataStream;
 
 /**
  * @brief Stores font (name, filename) pair defined in skin
@@ -43,9 +44,11 @@ class FontsList : public NamedList<Font>, public XmlData
 {
 protected:
     void fromXml(QXmlStreamReader& xml);
+    void fromStream(QDataStream& stream);
 
 public:
     void toXml(QXmlStreamWriter& xml) const;
+    void toStream(QDataStream& stream) const;
 };
 
 /**
@@ -93,6 +96,8 @@ public:
     // Xml
     void fromXml(QXmlStreamReader& xml);
     void toXml(QXmlStreamWriter& xml) const;
+    // Binary cache
+    void fromStream(QDataStream& stream);
 
 signals:
     void valueChanged(const QString& name, const Font& value) const;
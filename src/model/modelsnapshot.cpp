@@ -0,0 +1,215 @@
+#include "modelsnapshot.hpp"
+#include "model/screensmodel.hpp"
+#include "base/trace.hpp"
+
+// ModelSnapshot
+
+const WidgetSnapshot* ModelSnapshot::find(uint id) const
+{
+    QVector<const WidgetSnapshot*> stack;
+    for (const auto& screen : screens) {
+        stack.append(screen.data());
+    }
+    while (!stack.isEmpty()) {
+        const WidgetSnapshot* node = stack.takeLast();
+        if (node->id == id)
+            return node;
+        for (const auto& child : node->children) {
+            stack.append(child.data());
+        }
+    }
+    return nullptr;
+}
+
+// ModelSnapshotBuilder
+
+ModelSnapshotBuilder::ModelSnapshotBuilder(ScreensModel* model,
+                                           const WindowStylesList* styles,
+                                           QObject* parent)
+    : QObject(parent)
+    , m_model(model)
+    , m_styles(styles)
+    , m_generation(1)
+    , m_colorsDirty(true)
+    , m_fontsDirty(true)
+    , m_stylesDirty(true)
+{
+    connect(m_model, &ScreensModel::widgetChanged, this, &ModelSnapshotBuilder::onWidgetChanged);
+    connect(
+      m_model, &ScreensModel::widgetsChanged, this, &ModelSnapshotBuilder::onWidgetsChanged);
+    connect(m_model, &ScreensModel::rowsInserted, this, &ModelSnapshotBuilder::onRowsInserted);
+    connect(m_model,
+            &ScreensModel::rowsAboutToBeRemoved,
+            this,
+            &ModelSnapshotBuilder::onRowsAboutToBeRemoved);
+    connect(m_model, &ScreensModel::rowsMoved, this, &ModelSnapshotBuilder::onRowsMoved);
+    connect(m_model, &ScreensModel::modelReset, this, &ModelSnapshotBuilder::onModelReset);
+
+    const auto& colors = m_model->colors();
+    auto colorsChanged = [this] {
+        m_colorsDirty = true;
+        ++m_generation;
+    };
+    connect(&colors, &ColorsModel::valueChanged, this, colorsChanged);
+    connect(&colors, &ColorsModel::rowsMoved, this, colorsChanged);
+    connect(&colors, &ColorsModel::modelReset, this, colorsChanged);
+
+    const auto& fonts = m_model->fonts();
+    auto fontsChanged = [this] {
+        m_fontsDirty = true;
+        ++m_generation;
+    };
+    connect(&fonts, &FontsModel::valueChanged, this, fontsChanged);
+    connect(&fonts, &FontsModel::rowsMoved, this, fontsChanged);
+    connect(&fonts, &FontsModel::modelReset, this, fontsChanged);
+
+    if (m_styles) {
+        connect(m_styles, &WindowStylesList::styleChanged, this, [this] {
+            m_stylesDirty = true;
+            ++m_generation;
+        });
+    }
+}
+
+ModelSnapshot::Ptr ModelSnapshotBuilder::take()
+{
+    if (m_last && m_last->generation == m_generation)
+        return m_last;
+
+    TRACE_ZONE("model", "ModelSnapshotBuilder::take");
+    auto* snapshot = new ModelSnapshot();
+    snapshot->generation = m_generation;
+    snapshot->outputSize = m_model->outputSize();
+
+    const int count = m_model->rowCount();
+    snapshot->screens.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        snapshot->screens.append(build(m_model->widget(m_model->index(i, 0))));
+    }
+    m_dirty.clear();
+
+    if (m_colorsDirty) {
+        m_colors.clear();
+        for (const auto& color : m_model->colors()) {
+            m_colors.append(color);
+        }
+        m_colorsDirty = false;
+    }
+    if (m_fontsDirty) {
+        m_fonts.clear();
+        for (const auto& font : m_model->fonts()) {
+            m_fonts.append(font);
+        }
+        m_fontsDirty = false;
+    }
+    if (m_stylesDirty && m_styles) {
+        m_styleList.clear();
+        for (const auto& style : *m_styles) {
+            m_styleList.append(style);
+        }
+        m_stylesDirty = false;
+    }
+    // Implicitly shared with the previous snapshot while unchanged
+    snapshot->colors = m_colors;
+    snapshot->fonts = m_fonts;
+    snapshot->styles = m_styleList;
+
+    m_last = ModelSnapshot::Ptr(snapshot);
+    return m_last;
+}
+
+void ModelSnapshotBuilder::onWidgetChanged(uint id, int key)
+{
+    Q_UNUSED(key)
+    markPath(id);
+}
+
+void ModelSnapshotBuilder::onWidgetsChanged(const QVector<QPair<uint, int>>& changes)
+{
+    for (const auto& change : changes) {
+        markPath(change.first);
+    }
+}
+
+void ModelSnapshotBuilder::onRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(first)
+    Q_UNUSED(last)
+    markPath(m_model->idFromIndex(parent));
+}
+
+void ModelSnapshotBuilder::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    for (int i = first; i <= last; ++i) {
+        const uint id = m_model->idFromIndex(m_model->index(i, 0, parent));
+        if (const WidgetData* w = m_model->widgetById(id)) {
+            forgetTree(*w);
+        }
+    }
+    markPath(m_model->idFromIndex(parent));
+}
+
+void ModelSnapshotBuilder::onRowsMoved(const QModelIndex& sourceParent,
+                                       int sourceStart,
+                                       int sourceEnd,
+                                       const QModelIndex& destinationParent,
+                                       int destinationRow)
+{
+    Q_UNUSED(sourceStart)
+    Q_UNUSED(sourceEnd)
+    Q_UNUSED(destinationRow)
+    markPath(m_model->idFromIndex(sourceParent));
+    markPath(m_model->idFromIndex(destinationParent));
+}
+
+void ModelSnapshotBuilder::onModelReset()
+{
+    m_nodes.clear();
+    m_dirty.clear();
+    ++m_generation;
+}
+
+void ModelSnapshotBuilder::markPath(uint id)
+{
+    // The top level list is rebuilt for every new snapshot
+    ++m_generation;
+    const WidgetData* w = m_model->widgetById(id);
+    // Ancestors of a dirty widget are dirty too
+    while (w && !m_dirty.contains(w->id())) {
+        m_dirty.insert(w->id());
+        w = w->isChild() ? w->parent()->self() : nullptr;
+    }
+}
+
+void ModelSnapshotBuilder::forgetTree(const WidgetData& widget)
+{
+    m_nodes.remove(widget.id());
+    m_dirty.remove(widget.id());
+    for (int i = 0; i < widget.childCount(); ++i) {
+        forgetTree(*widget.child(i));
+    }
+}
+
+WidgetSnapshot::Ptr ModelSnapshotBuilder::build(const WidgetData& widget)
+{
+    const uint id = widget.id();
+    auto it = m_nodes.constFind(id);
+    if (it != m_nodes.cend() && !m_dirty.contains(id))
+        return *it;
+
+    auto* node = new WidgetSnapshot();
+    node->id = id;
+    node->type = widget.type();
+    node->rect = QRect(widget.absolutePosition(), widget.selfSize());
+    for (int key : WidgetData::attrKeys()) {
+        node->attributes.insert(key, widget.getAttr(key));
+    }
+    node->children.reserve(widget.childCount());
+    for (int i = 0; i < widget.childCount(); ++i) {
+        node->children.append(build(*widget.child(i)));
+    }
+
+    WidgetSnapshot::Ptr ptr(node);
+    m_nodes.insert(id, ptr);
+    return ptr;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "skin/widgetdata.hpp"
+#include "model/colorsmodel.hpp"
+#include "model/fontsmodel.hpp"
+#include "model/windowstyle.hpp"
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+
+class ScreensModel;
+
+/**
+ * @brief immutable copy of a widget and its subtree
+ * Nodes are shared between snapshots until the widget or one of its
+ * descendants changes.
+ */
+struct WidgetSnapshot
+{
+    using Ptr = QSharedPointer<const WidgetSnapshot>;
+
+    uint id = 0;
+    WidgetData::WidgetType type = WidgetData::WidgetType::Widget;
+    // Resolved geometry relative to the parent
+    QRect rect;
+    // Values by Property key
+    QHash<int, QVariant> attributes;
+    QVector<Ptr> children;
+
+    QVariant attr(int key) const { return attributes.value(key); }
+    QString name() const { return attr(Property::name).toString(); }
+};
+
+/**
+ * @brief state of the whole document at one model generation
+ * Safe to read from any thread while editing continues.
+ */
+struct ModelSnapshot
+{
+    using Ptr = QSharedPointer<const ModelSnapshot>;
+
+    quint64 generation = 0;
+    QSize outputSize;
+    // Screens and includes in model order
+    QVector<WidgetSnapshot::Ptr> screens;
+    QVector<Color> colors;
+    QVector<Font> fonts;
+    QVector<WindowStyle> styles;
+
+    // Depth first search
+    const WidgetSnapshot* find(uint id) const;
+};
+
+/**
+ * @brief takes snapshots of the model in the GUI thread
+ * Follows change notifications, only widgets on the path from the root
+ * to a changed widget are copied again, other subtrees are shared with
+ * the previous snapshot.
+ */
+class ModelSnapshotBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Styles are optional, they live in the repository
+    explicit ModelSnapshotBuilder(ScreensModel* model,
+                                  const WindowStylesList* styles = nullptr,
+                                  QObject* parent = nullptr);
+
+    // Increased by every change of the model
+    quint64 generation() const { return m_generation; }
+    // The previous snapshot is returned while nothing has changed
+    ModelSnapshot::Ptr take();
+
+private slots:
+    void onWidgetChanged(uint id, int key);
+    void onWidgetsChanged(const QVector<QPair<uint, int>>& changes);
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onRowsMoved(const QModelIndex& sourceParent,
+                     int sourceStart,
+                     int sourceEnd,
+                     const QModelIndex& destinationParent,
+                     int destinationRow);
+    void onModelReset();
+
+private:
+    // Widget and all its ancestors must be copied again
+    void markPath(uint id);
+    void forgetTree(const WidgetData& widget);
+    WidgetSnapshot::Ptr build(const WidgetData& widget);
+
+    ScreensModel* m_model;
+    const WindowStylesList* m_styles;
+    quint64 m_generation;
+    ModelSnapshot::Ptr m_last;
+
+    // Latest copy of every widget, by id
+    QHash<uint, WidgetSnapshot::Ptr> m_nodes;
+    // Widgets changed since the last snapshot, with all their ancestors
+    QSet<uint> m_dirty;
+
+    // Lists are copied again only after they change
+    bool m_colorsDirty;
+    bool m_fontsDirty;
+    bool m_stylesDirty;
+    QVector<Color> m_colors;
+    QVector<Font> m_fonts;
+    QVector<WindowStyle> m_styleList;
+};
@@ -22,6 +22,7 @@ protected:
     bool isValidIndex(int i) const { return 0 <= i && i < m_items.size(); }
     bool setItemName(int i, const QString& name);
     bool setItemValue(int i, const typename T::Value& value);
+    bool setItem(int i, const T& item);
 
     bool canInsertItem(const T& item);
     bool insertItem(int i, const T& item);
@@ -80,6 +81,17 @@ bool NamedList<T>::setItemValue(int i, const typename T::Value& value)
     return true;
 }
 
+template<typename T>
+bool NamedList<T>::setItem(int i, const T& item)
+{
+    if (!isValidIndex(i) || item.name() != m_items[i].name()) {
+        return false;
+    }
+    m_items[i] = item;
+    emitValueChanged(item.name(), m_items[i]);
+    return true;
+}
+
 template<typename T>
 bool NamedList<T>::canInsertItem(const T& item)
 {
@@ -200,3 +212,13 @@ QString NamedList<T>::getName(const typename T::Value value) const
     }
     return QString();
 }
+
+template<typename T>
+int NamedList<T>::getIndex(const QString& name) const
+{
+    for (int i = 0; i < m_items.size(); ++i) {
+        if (m_items[i].name() == name)
+            return i;
+    }
+    return -1;
+}
@@ -1,5 +1,6 @@
 #include "outputsmodel.hpp"
 #include <QDebug>
+#include <QDataStream>
 
 VideoOutputRepository::VideoOutputRepository() = default;
 
@@ -10,6 +11,15 @@ void VideoOutputRepository::toXml(QXmlStreamWriter& xml) const
     }
 }
 
+void VideoOutputRepository::toStream(QDataStream& stream) const
+{
+    stream << qint32(itemsCount());
+    for (const VideoOutput& output : *this) {
+        stream << qint32(output.id()) << qint32(output.xres()) << qint32(output.yres())
+               << qint32(output.bpp());
+    }
+}
+
 VideoOutput::VideoOutput(const QString& id, const VideoOutputData& data)
     : m_xres(data.resolution.width())
     , m_yres(data.resolution.height())
@@ -146,6 +156,17 @@ bool OutputsModel::setData(const QModelIndex& index, const QVariant& value, int
     return changed;
 }
 
+bool OutputsModel::setResolution(int row, const QSize& resolution)
+{
+    if (!isValidIndex(row) || itemAt(row).size() == resolution)
+        return false;
+    auto data = itemAt(row).value();
+    data.resolution = resolution;
+    setItemValue(row, data);
+    emit dataChanged(index(row, ColumnXRes), index(row, ColumnYRes));
+    return true;
+}
+
 Qt::ItemFlags OutputsModel::flags(const QModelIndex& index) const
 {
     Qt::ItemFlags flags = MovableListModel::flags(index);
@@ -208,6 +229,18 @@ void OutputsModel::appendFromXml(QXmlStreamReader& xml)
     append(out);
 }
 
+void OutputsModel::fromStream(QDataStream& stream)
+{
+    clear();
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 id, xres, yres, bpp;
+        stream >> id >> xres >> yres >> bpp;
+        append(VideoOutput(QString::number(id), VideoOutputData{ QSize(xres, yres), bpp }));
+    }
+}
+
 void OutputsModel::emitValueChanged(const QString& name, const VideoOutput& value) const
 {
     Q_UNUSED(name);
@@ -8,6 +8,7 @@
 
 class QXmlStreamReader;
 class QXmlStreamWriter;
+class QDataStream;
 
 struct VideoOutputData
 {
@@ -54,6 +55,7 @@ public:
     VideoOutputRepository();
 
     void toXml(QXmlStreamWriter& xml) const;
+    void toStream(QDataStream& stream) const;
 
     inline VideoOutput getOutput(int id = 0) const { return getValue(QString::number(id)); }
 };
@@ -95,6 +97,9 @@ public:
     bool append(const VideoOutput& output) { return insert(itemsCount(), output); }
     // bool insertRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
 
+    // Change both dimensions with one notification
+    bool setResolution(int row, const QSize& resolution);
+
     // Remove data:
     bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
     void clear() { removeItems(0, itemsCount()); }
@@ -107,6 +112,8 @@ public:
 
     // Xml:
     void appendFromXml(QXmlStreamReader& xml);
+    // Binary cache:
+    void fromStream(QDataStream& stream);
 
 signals:
     void valueChanged(int id, const VideoOutput& output) const;
@@ -4,12 +4,15 @@
 PropertiesModel::PropertiesModel(ScreensModel* model, QObject* parent)
     : QAbstractItemModel(parent)
     , m_dummyRoot(Property::invalid)
+    , m_tree(std::make_unique<PropertyTree>())
     , m_root(&m_dummyRoot)
     , m_model(model)
-    , m_observer(new WidgetObserverRegistrator(model, QModelIndex()))
+    , m_id(UniqueId::invalid)
+    , m_observer(new WidgetObserverRegistrator(model, UniqueId::invalid))
 {
     Q_CHECK_PTR(m_model);
     connect(m_model, &ScreensModel::widgetChanged, this, &PropertiesModel::onAttributeChanged);
+    connect(m_model, &ScreensModel::widgetsChanged, this, &PropertiesModel::onAttributesChanged);
 
     connect(m_model,
             &ScreensModel::modelAboutToBeReset,
@@ -21,35 +24,23 @@ PropertiesModel::~PropertiesModel() = default;
 
 void PropertiesModel::setWidget(const QModelIndex& index)
 {
-    beginResetModel();
-    m_index = index;
-    if (m_index.isValid()) {
-        m_tree = std::make_unique<PropertyTree>(&m_model->widget(m_index));
-        m_root = m_tree->root();
-    } else {
-        m_tree.reset();
-        m_root = &m_dummyRoot;
+    const uint id = m_model->idFromIndex(index);
+    const bool hadWidget = m_root != &m_dummyRoot;
+    const bool hasWidget = id != UniqueId::invalid;
+    if (hadWidget != hasWidget) {
+        beginResetModel();
     }
-    m_observer->setIndex(index);
-
-    //    if (mData != nullptr) {
-    //        disconnect(mData, &WidgetData::attrChanged,
-    //                   this, &PropertiesModel::onAttributeChanged);
-    //        disconnect(mData, &QObject::destroyed,
-    //                   this, &PropertiesModel::onWidgetDestroyed);
-    //    }
-
-    //    mData = widget;
-
-    //    if (mData != nullptr) {
-    //        mRoot = mData->adaptersRoot();
-    //        connect(mData, &WidgetData::attrChanged, this, &PropertiesModel::onAttributeChanged);
-    //        connect(mData, &QObject::destroyed, this, &PropertiesModel::onWidgetDestroyed);
-    //    } else {
-    //        mRoot = &dummyItem;
-    //    }
+    m_id = id;
+    m_tree->setWidget(m_model->widgetById(id));
+    m_root = hasWidget ? m_tree->root() : &m_dummyRoot;
+    m_observer->setId(m_id);
 
-    endResetModel();
+    if (hadWidget != hasWidget) {
+        endResetModel();
+    } else if (hasWidget) {
+        // Same rows, only values and group states differ
+        valuesChanged(m_root);
+    }
 }
 
 QVariant PropertiesModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -127,7 +118,22 @@ QVariant PropertiesModel::data(const QModelIndex& index, int role) const
     case ColumnKey:
         return attr->keyData(role);
     case ColumnValue:
-        return attr->data(role);
+        switch (role) {
+        case MixedValuesRole:
+            return isMultiEdit() && !m_tree->isShared(*attr, targetWidgets());
+        case Qt::ToolTipRole:
+            if (data(index, MixedValuesRole).toBool())
+                return tr("Values differ between the selected widgets");
+            return attr->data(role);
+        case Qt::DisplayRole:
+        case Qt::DecorationRole:
+            // Shown empty, the editor still starts from the current widget
+            if (data(index, MixedValuesRole).toBool())
+                return QVariant();
+            return attr->data(role);
+        default:
+            return attr->data(role);
+        }
     default:
         return QVariant();
     }
@@ -143,8 +149,18 @@ bool PropertiesModel::setData(const QModelIndex& index, const QVariant& value, i
     switch (index.column()) {
     case ColumnValue: {
         const QVariant& newValue = item.convert(value, role);
-        if (newValue.isValid()) {
-            m_model->setWidgetAttr(m_index, item.key(), newValue);
+        QModelIndex widget = m_model->indexFromId(m_id);
+        if (!newValue.isValid() || !widget.isValid()) {
+            return true;
+        }
+        if (m_targets.size() > 1 && m_targets.contains(m_id)) {
+            QModelIndexList indexes;
+            for (uint id : qAsConst(m_targets)) {
+                indexes.append(m_model->indexFromId(id));
+            }
+            m_model->setWidgetsAttr(indexes, item.key(), newValue);
+        } else {
+            m_model->setWidgetAttr(widget, item.key(), newValue);
         }
         return true;
     }
@@ -167,9 +183,11 @@ Qt::ItemFlags PropertiesModel::flags(const QModelIndex& index) const
     }
 }
 
-void PropertiesModel::onAttributeChanged(const QModelIndex& index, int key)
+void PropertiesModel::onAttributeChanged(uint id, int key)
 {
-    if (index != m_index)
+    if (id != m_id && !(isMultiEdit() && m_targets.contains(id)))
+        return;
+    if (m_root == &m_dummyRoot)
         return;
     AttrItem* item = m_tree->getItemPtr(key);
     if (item) {
@@ -179,9 +197,57 @@ void PropertiesModel::onAttributeChanged(const QModelIndex& index, int key)
     }
 }
 
+void PropertiesModel::setTargets(const QModelIndexList& indexes)
+{
+    const bool wasMultiEdit = isMultiEdit();
+    m_targets.clear();
+    for (const auto& index : indexes) {
+        uint id = m_model->idFromIndex(index);
+        if (id != UniqueId::invalid && !m_targets.contains(id)) {
+            m_targets.append(id);
+        }
+    }
+    if ((wasMultiEdit || isMultiEdit()) && m_root != &m_dummyRoot) {
+        valuesChanged(m_root);
+    }
+}
+
+QVector<const WidgetData*> PropertiesModel::targetWidgets() const
+{
+    QVector<const WidgetData*> widgets;
+    widgets.reserve(m_targets.size());
+    for (uint id : m_targets) {
+        if (const WidgetData* w = m_model->widgetById(id)) {
+            widgets.append(w);
+        }
+    }
+    return widgets;
+}
+
+void PropertiesModel::valuesChanged(AttrItem* parent)
+{
+    const int count = parent->childCount();
+    if (count == 0)
+        return;
+    const QModelIndex parentIndex =
+      parent == m_root ? QModelIndex() : createIndex(parent->myIndex(), ColumnKey, parent);
+    emit dataChanged(index(0, ColumnKey, parentIndex), index(count - 1, ColumnValue, parentIndex));
+    for (int i = 0; i < count; ++i) {
+        valuesChanged(parent->child(i));
+    }
+}
+
+void PropertiesModel::onAttributesChanged(const QVector<QPair<uint, int>>& changes)
+{
+    for (const auto& change : changes) {
+        onAttributeChanged(change.first, change.second);
+    }
+}
+
 void PropertiesModel::onModelAboutToBeReset()
 {
     // Our widget becomes invalid
+    m_targets.clear();
     setWidget(QModelIndex());
 }
 
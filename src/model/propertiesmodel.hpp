@@ -24,7 +24,11 @@ public:
         ColumnsCount
     };
 
+    // Rebinds the tree, only a switch to or from no widget resets the model
     void setWidget(const QModelIndex& index);
+    // Edits are applied to all targets when the current widget is one of them,
+    // values that differ between the targets are not shown then
+    void setTargets(const QModelIndexList& indexes);
 
     // Header:
     QVariant headerData(int section,
@@ -48,15 +52,22 @@ public:
     Qt::ItemFlags flags(const QModelIndex& index) const override;
 
 private slots:
-    void onAttributeChanged(const QModelIndex& index, int key);
+    void onAttributeChanged(uint id, int key);
+    void onAttributesChanged(const QVector<QPair<uint, int>>& changes);
     void onModelAboutToBeReset();
 
 private:
     static Item* castItem(QModelIndex index);
+    bool isMultiEdit() const { return m_targets.size() > 1 && m_targets.contains(m_id); }
+    QVector<const WidgetData*> targetWidgets() const;
+    // Report all values below the item as changed
+    void valuesChanged(AttrItem* parent);
+
     AttrItem m_dummyRoot;
     std::unique_ptr<PropertyTree> m_tree;
     AttrItem* m_root;
     ScreensModel* m_model;
-    QPersistentModelIndex m_index;
+    uint m_id;
+    QVector<uint> m_targets;
     QScopedPointer<WidgetObserverRegistrator> m_observer;
 };
@@ -7,8 +7,6 @@ PropertyTree::PropertyTree(const WidgetData* widget)
     : m_widget(widget)
     , m_root(new AttrItem())
 {
-    Q_CHECK_PTR(m_widget);
-
     using R = Property::Render;
     auto global = addGroup("General", R::Widget);
     add<TextItem>(Property::name, global);
@@ -88,6 +86,24 @@ void PropertyTree::setWidget(const WidgetData* widget)
     m_widget = widget;
 }
 
+bool PropertyTree::isShared(const AttrItem& item, const QVector<const WidgetData*>& widgets)
+{
+    if (item.key() == Property::invalid || widgets.isEmpty())
+        return true;
+
+    // Items read the bound widget, walk the others through the same item
+    const WidgetData* current = m_widget;
+    m_widget = widgets.first();
+    const QVariant value = item.data(Qt::DisplayRole);
+    bool shared = true;
+    for (int i = 1; i < widgets.size() && shared; ++i) {
+        m_widget = widgets[i];
+        shared = item.data(Qt::DisplayRole) == value;
+    }
+    m_widget = current;
+    return shared;
+}
+
 AttrGroupItem* PropertyTree::addGroup(const QString& title, Property::Render render)
 {
     auto group = new AttrGroupItem(title, render);
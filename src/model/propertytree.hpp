@@ -8,10 +8,15 @@
 class AttrItem;
 class AttrGroupItem;
 
+/**
+ * @brief Items for all attributes, built once and bound to one widget at a time
+ * Layout is the same for every render type, so the tree is rebound on
+ * selection change instead of being rebuilt.
+ */
 class PropertyTree
 {
 public:
-    PropertyTree(const WidgetData* widget);
+    explicit PropertyTree(const WidgetData* widget = nullptr);
     AttrItem* root() const { return m_root; }
     AttrItem* getItemPtr(const int key) const;
     ~PropertyTree();
@@ -19,6 +24,9 @@ public:
     const WidgetData& widget();
     void setWidget(const WidgetData* widget);
 
+    // The item displays the same value for all the widgets
+    bool isShared(const AttrItem& item, const QVector<const WidgetData*>& widgets);
+
 private:
     AttrGroupItem* addGroup(const QString& title, Property::Render render);
 
@@ -60,7 +68,9 @@ private:
 
 enum
 {
-    ShallExpandRole = Qt::UserRole + 1
+    ShallExpandRole = Qt::UserRole + 1,
+    // Values differ between the edited widgets
+    MixedValuesRole
 };
 
 class AttrGroupItem : public AttrItem
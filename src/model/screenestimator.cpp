@@ -0,0 +1,422 @@
+#include "screenestimator.hpp"
+#include "model/screensmodel.hpp"
+#include "repository/skinrepository.hpp"
+#include "repository/pixmapstorage.hpp"
+#include "base/trace.hpp"
+#include <QImageReader>
+#include <QRegion>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Delay to collect a burst of changes, e.g. while dragging
+const int estimateDelay = 300;
+
+const int pixmapKeys[] = {
+    Property::pixmap,           Property::selectionPixmap, Property::sliderPixmap,
+    Property::backgroundPixmap, Property::pointer,         Property::seek_pointer,
+};
+
+struct Layer
+{
+    QRect rect;
+    // Hides the layers below
+    bool opaque;
+    bool blended;
+};
+
+// Draws text or a converter value over its background
+bool hasContent(const WidgetSnapshot& widget)
+{
+    return !widget.attr(Property::text).toString().isEmpty()
+           || !widget.attr(Property::source).toString().isEmpty();
+}
+
+// Layers of the widget and its children in paint order,
+// @p origin is the top left of the parent in screen coordinates
+void collectLayers(const WidgetSnapshot& widget,
+                   const QPoint& origin,
+                   const QRect& clip,
+                   QVector<Layer>& layers,
+                   QSet<QString>& pixmaps)
+{
+    const QRect full(origin + widget.rect.topLeft(), widget.rect.size());
+    const QRect rect = full.intersected(clip);
+    for (int key : pixmapKeys) {
+        const QString name = widget.attr(key).toString();
+        if (!name.isEmpty()) {
+            pixmaps.insert(name);
+        }
+    }
+
+    const bool transparent = widget.attr(Property::transparent).toBool();
+    if (!rect.isEmpty()) {
+        if (!transparent) {
+            layers.append({ rect, true, false });
+        }
+        if (!widget.attr(Property::pixmap).toString().isEmpty()) {
+            const auto alphatest = widget.attr(Property::alphatest).value<Property::Alphatest>();
+            layers.append({ rect, alphatest == Property::off, alphatest == Property::blend });
+        } else if (transparent && hasContent(widget)) {
+            // Antialiased text over the parent
+            layers.append({ rect, false, true });
+        }
+    }
+
+    // Higher zPosition is painted later, siblings keep their order otherwise
+    QVector<const WidgetSnapshot*> children;
+    children.reserve(widget.children.size());
+    for (const auto& child : widget.children) {
+        children.append(child.data());
+    }
+    std::stable_sort(children.begin(),
+                     children.end(),
+                     [](const WidgetSnapshot* a, const WidgetSnapshot* b) {
+                         return a->attr(Property::zPosition).toInt()
+                                < b->attr(Property::zPosition).toInt();
+                     });
+    for (const auto* child : qAsConst(children)) {
+        collectLayers(*child, full.topLeft(), rect, layers, pixmaps);
+    }
+}
+
+qint64 area(const QRegion& region)
+{
+    qint64 result = 0;
+    for (const QRect& rect : region) {
+        result += qint64(rect.width()) * rect.height();
+    }
+    return result;
+}
+
+// Top level screens and screens of includes
+QVector<const WidgetSnapshot*> screensOf(const ModelSnapshot& snapshot)
+{
+    QVector<const WidgetSnapshot*> screens;
+    for (const auto& node : snapshot.screens) {
+        if (node->type == WidgetData::WidgetType::Screen) {
+            screens.append(node.data());
+            continue;
+        }
+        for (const auto& child : node->children) {
+            screens.append(child.data());
+        }
+    }
+    return screens;
+}
+
+} // namespace
+
+ScreenEstimator::ScreenEstimator(ScreensModel* model, QObject* parent)
+    : QAbstractTableModel(parent)
+    , m_model(model)
+    , m_snapshots(model)
+    , m_bpp(0)
+    , m_epoch(0)
+    , m_resultPending(false)
+    , m_sizesGeneration(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(estimateDelay);
+    connect(&m_timer, &QTimer::timeout, this, &ScreenEstimator::startNext);
+    connect(&m_watcher,
+            &QFutureWatcher<Result>::finished,
+            this,
+            &ScreenEstimator::onEstimateFinished);
+
+    connect(m_model, &ScreensModel::widgetChanged, this, &ScreenEstimator::schedule);
+    connect(m_model, &ScreensModel::widgetsChanged, this, &ScreenEstimator::schedule);
+    connect(m_model, &ScreensModel::rowsInserted, this, &ScreenEstimator::schedule);
+    connect(m_model, &ScreensModel::rowsRemoved, this, &ScreenEstimator::schedule);
+    connect(m_model, &ScreensModel::rowsMoved, this, &ScreenEstimator::schedule);
+    connect(m_model, &ScreensModel::modelReset, this, &ScreenEstimator::schedule);
+
+    auto& storage = PixmapStorage::instance();
+    connect(
+      &storage, &PixmapStorage::pixmapsChanged, this, &ScreenEstimator::onPixmapsChanged);
+    connect(
+      &storage, &PixmapStorage::directoryChanged, this, &ScreenEstimator::onDirectoryChanged);
+
+    schedule();
+}
+
+ScreenEstimator::~ScreenEstimator()
+{
+    m_watcher.waitForFinished();
+}
+
+void ScreenEstimator::setBpp(int bpp)
+{
+    if (bpp == m_bpp)
+        return;
+    m_bpp = bpp;
+    invalidate();
+}
+
+void ScreenEstimator::estimateNow()
+{
+    m_timer.stop();
+    m_watcher.waitForFinished();
+    m_resultPending = false;
+    applyResult(run(m_snapshots.take(), m_cache, m_bpp, m_epoch));
+}
+
+ScreenEstimate ScreenEstimator::estimate(const WidgetSnapshot& screen,
+                                         int bpp,
+                                         const PixmapSize& pixmapSize)
+{
+    ScreenEstimate result;
+    result.screenId = screen.id;
+    result.screen = screen.name();
+    const QRect bounds(QPoint(0, 0), screen.rect.size());
+    result.screenArea = qint64(bounds.width()) * bounds.height();
+
+    QVector<Layer> layers;
+    QSet<QString> pixmaps;
+    collectLayers(screen, -screen.rect.topLeft(), bounds, layers, pixmaps);
+
+    // Top down, opaque layers hide what is below them
+    QRegion covered;
+    for (auto it = layers.crbegin(); it != layers.crend(); ++it) {
+        const qint64 visible = area(QRegion(it->rect).subtracted(covered));
+        result.paintedArea += visible;
+        if (it->blended && visible > 0) {
+            ++result.blendedLayers;
+        }
+        if (it->opaque) {
+            covered += it->rect;
+        }
+    }
+
+    const int bytesPerPixel = bpp > 0 ? (bpp + 7) / 8 : 4;
+    for (const auto& name : qAsConst(pixmaps)) {
+        const QSize size = pixmapSize(name);
+        if (size.isValid()) {
+            ++result.pixmapCount;
+            result.pixmapBytes += qint64(size.width()) * size.height() * bytesPerPixel;
+        }
+    }
+    return result;
+}
+
+QVariant ScreenEstimator::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case ColumnScreen:
+        return tr("Screen");
+    case ColumnPixmapBytes:
+        return tr("Pixmaps");
+    case ColumnOverdraw:
+        return tr("Overdraw");
+    case ColumnBlendedLayers:
+        return tr("Blended");
+    default:
+        return QVariant();
+    }
+}
+
+int ScreenEstimator::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int ScreenEstimator::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnsCount;
+}
+
+QVariant ScreenEstimator::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    const ScreenEstimate& e = m_rows[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case ColumnScreen:
+            return e.screen;
+        case ColumnPixmapBytes:
+            return tr("%1 KiB").arg(e.pixmapBytes / 1024.0, 0, 'f', 1);
+        case ColumnOverdraw:
+            return QString::number(e.overdraw(), 'f', 2);
+        case ColumnBlendedLayers:
+            return e.blendedLayers;
+        default:
+            return QVariant();
+        }
+    case SortRole:
+        switch (index.column()) {
+        case ColumnScreen:
+            return e.screen;
+        case ColumnPixmapBytes:
+            return e.pixmapBytes;
+        case ColumnOverdraw:
+            return e.overdraw();
+        case ColumnBlendedLayers:
+            return e.blendedLayers;
+        default:
+            return QVariant();
+        }
+    case Qt::ToolTipRole:
+        return tr("%1 pixmaps, %2 of %3 pixels painted")
+          .arg(e.pixmapCount)
+          .arg(e.paintedArea)
+          .arg(e.screenArea);
+    case Qt::TextAlignmentRole:
+        if (index.column() != ColumnScreen)
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        return QVariant();
+    case WidgetIdRole:
+        return e.screenId;
+    default:
+        return QVariant();
+    }
+}
+
+void ScreenEstimator::schedule()
+{
+    m_timer.start();
+}
+
+void ScreenEstimator::startNext()
+{
+    if (m_resultPending)
+        return;
+    const ModelSnapshot::Ptr snapshot = m_snapshots.take();
+    // Nothing has changed since the last run
+    if (snapshot == m_snapshot)
+        return;
+    m_resultPending = true;
+    const Cache cache = m_cache;
+    const int bpp = m_bpp;
+    const int epoch = m_epoch;
+    m_watcher.setFuture(QtConcurrent::run(
+      [this, snapshot, cache, bpp, epoch] { return run(snapshot, cache, bpp, epoch); }));
+    emit started();
+}
+
+void ScreenEstimator::onEstimateFinished()
+{
+    // Already taken by estimateNow()
+    if (!m_resultPending)
+        return;
+    m_resultPending = false;
+    // A stale result is shown but not cached, the next run is already scheduled
+    if (!applyResult(m_watcher.result()))
+        return;
+    if (m_snapshots.generation() != m_snapshot->generation) {
+        schedule();
+    } else {
+        emit finished();
+    }
+}
+
+void ScreenEstimator::onPixmapsChanged(const QStringList& paths)
+{
+    {
+        QMutexLocker locker(&m_sizesMutex);
+        for (const auto& path : paths) {
+            m_sizes.remove(path);
+        }
+        ++m_sizesGeneration;
+    }
+    invalidate();
+}
+
+void ScreenEstimator::onDirectoryChanged()
+{
+    {
+        QMutexLocker locker(&m_sizesMutex);
+        m_sizes.clear();
+        ++m_sizesGeneration;
+    }
+    invalidate();
+}
+
+ScreenEstimator::Result ScreenEstimator::run(const ModelSnapshot::Ptr& snapshot,
+                                             const Cache& cache,
+                                             int bpp,
+                                             int epoch)
+{
+    TRACE_ZONE("estimate", "ScreenEstimator::run");
+    const QVector<const WidgetSnapshot*> screens = screensOf(*snapshot);
+    QVector<const WidgetSnapshot*> pending;
+    for (const auto* screen : screens) {
+        if (!cache.contains(screen)) {
+            pending.append(screen);
+        }
+    }
+
+    auto estimateOne = [this, bpp](const WidgetSnapshot* screen) {
+        return estimate(*screen, bpp, [this](const QString& name) { return pixmapSize(name); });
+    };
+    const QList<ScreenEstimate> estimates =
+      QtConcurrent::blockingMapped<QList<ScreenEstimate>>(pending, estimateOne);
+
+    Result result;
+    result.epoch = epoch;
+    result.snapshot = snapshot;
+    for (int i = 0; i < pending.size(); ++i) {
+        result.cache.insert(pending[i], estimates[i]);
+    }
+    for (const auto* screen : screens) {
+        auto it = cache.constFind(screen);
+        if (it != cache.cend()) {
+            result.cache.insert(screen, *it);
+        }
+        result.estimates.append(result.cache.value(screen));
+    }
+    return result;
+}
+
+bool ScreenEstimator::applyResult(const Result& result)
+{
+    const bool current = result.epoch == m_epoch;
+    if (current) {
+        m_snapshot = result.snapshot;
+        m_cache = result.cache;
+    } else {
+        // Sizes or depth changed while estimating
+        schedule();
+    }
+    beginResetModel();
+    m_rows = result.estimates;
+    endResetModel();
+    return current;
+}
+
+void ScreenEstimator::invalidate()
+{
+    ++m_epoch;
+    m_cache.clear();
+    m_snapshot.reset();
+    schedule();
+}
+
+QSize ScreenEstimator::pixmapSize(const QString& name)
+{
+    const QString path = m_model->repository().resolveFilename(name);
+    if (path.isEmpty())
+        return QSize();
+
+    QMutexLocker locker(&m_sizesMutex);
+    auto it = m_sizes.constFind(path);
+    if (it != m_sizes.cend())
+        return *it;
+    const quint64 generation = m_sizesGeneration;
+    locker.unlock();
+
+    // Only the header is read
+    const QSize size = QImageReader(path).size();
+    locker.relock();
+    // The file may have changed while it was read
+    if (generation == m_sizesGeneration) {
+        m_sizes.insert(path, size);
+    }
+    return size;
+}
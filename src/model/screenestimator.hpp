@@ -0,0 +1,137 @@
+#pragma once
+
+#include "model/modelsnapshot.hpp"
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+
+class ScreensModel;
+
+/**
+ * @brief cost of showing one screen on the box
+ */
+struct ScreenEstimate
+{
+    uint screenId = 0;
+    QString screen;
+    // Distinct pixmaps decoded at the output depth
+    int pixmapCount = 0;
+    qint64 pixmapBytes = 0;
+    // Pixels written when the whole screen is painted, parts hidden by
+    // opaque widgets above are not painted
+    qint64 paintedArea = 0;
+    qint64 screenArea = 0;
+    // Visible layers drawn with alpha blending
+    int blendedLayers = 0;
+
+    double overdraw() const { return screenArea ? double(paintedArea) / screenArea : 0.0; }
+};
+
+/**
+ * @brief estimates memory use and fill rate of the screens on the box
+ * Works on model snapshots, screens are estimated concurrently and only
+ * screens whose snapshot changed are estimated again. Sizes of pixmap
+ * files are read from their headers and cached. Exposes the estimates
+ * as a table.
+ */
+class ScreenEstimator : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum
+    {
+        ColumnScreen,
+        ColumnPixmapBytes,
+        ColumnOverdraw,
+        ColumnBlendedLayers,
+        ColumnsCount,
+    };
+
+    enum Roles
+    {
+        WidgetIdRole = Qt::UserRole + 1,
+        // Numbers for sorting
+        SortRole,
+    };
+
+    explicit ScreenEstimator(ScreensModel* model, QObject* parent = nullptr);
+    ~ScreenEstimator() override;
+
+    // Depth of decoded pixmaps, 32 bpp when not set
+    void setBpp(int bpp);
+    // Estimate all screens without a worker thread
+    void estimateNow();
+
+    QVector<ScreenEstimate> estimates() const { return m_rows; }
+
+    // Pixmap sizes by name as written in the skin
+    using PixmapSize = std::function<QSize(const QString&)>;
+    // Runs the estimate of one screen, thread safe
+    static ScreenEstimate estimate(const WidgetSnapshot& screen,
+                                   int bpp,
+                                   const PixmapSize& pixmapSize);
+
+    // QAbstractItemModel interface
+    QVariant headerData(int section,
+                        Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+signals:
+    // Background estimate has started or finished
+    void started();
+    void finished();
+
+private slots:
+    void schedule();
+    void startNext();
+    void onEstimateFinished();
+    void onPixmapsChanged(const QStringList& paths);
+    void onDirectoryChanged();
+
+private:
+    // Screens by snapshot node, unchanged nodes keep their estimate
+    using Cache = QHash<const WidgetSnapshot*, ScreenEstimate>;
+    struct Result
+    {
+        // Estimates made before the last invalidate() are not cached
+        int epoch = 0;
+        ModelSnapshot::Ptr snapshot;
+        QVector<ScreenEstimate> estimates;
+        Cache cache;
+    };
+    Result run(const ModelSnapshot::Ptr& snapshot, const Cache& cache, int bpp, int epoch);
+    // Returns false when the result was computed before invalidate()
+    bool applyResult(const Result& result);
+    void invalidate();
+    // Thread safe
+    QSize pixmapSize(const QString& name);
+
+    ScreensModel* m_model;
+    ModelSnapshotBuilder m_snapshots;
+    int m_bpp;
+    int m_epoch;
+    QVector<ScreenEstimate> m_rows;
+
+    // Snapshot of the cached estimates keeps their nodes alive
+    ModelSnapshot::Ptr m_snapshot;
+    Cache m_cache;
+    bool m_resultPending;
+
+    QMutex m_sizesMutex;
+    // Image size by resolved path, invalid when the file can not be read
+    QHash<QString, QSize> m_sizes;
+    // Bumped when sizes are dropped, reads started before are not cached
+    quint64 m_sizesGeneration;
+
+    // Coalesces bursts of notifications into one run
+    QTimer m_timer;
+    QFutureWatcher<Result> m_watcher;
+};
@@ -1,12 +1,25 @@
 #include "screensmodel.hpp"
 #include "commands/attrcommand.hpp"
+#include "commands/retargetcommand.hpp"
+#include "model/outputsmodel.hpp"
 #include "repository/skinrepository.hpp"
 #include "model/windowstyle.hpp"
 #include "skin/includefile.hpp"
+#include "base/trace.hpp"
+#include "base/xmlstreamwriter.hpp"
+#include <QBuffer>
+#include <QCoreApplication>
 #include <QUndoStack>
 #include <QMimeData>
 #include <QByteArray>
 #include <QDataStream>
+#include <algorithm>
+#include <functional>
+
+// Drag and drop and clipboard formats
+const char rowsMimeType[] = "application/x-e2designer-rows";
+const char widgetsMimeType[] = "application/x-e2designer-widgets";
+const quint32 widgetsFormatVersion = 1;
 
 // ScreensTree
 
@@ -115,6 +128,38 @@ Preview ScreensTree::getPreview(const QString& screen, const QString& widget) co
     return widget_it.value();
 }
 
+void ScreensTree::readPreviews(QDataStream& stream)
+{
+    m_previews.clear();
+    qint32 screens;
+    stream >> screens;
+    for (int i = 0; i < screens && stream.status() == QDataStream::Ok; ++i) {
+        QString screen;
+        qint32 count;
+        stream >> screen >> count;
+        QMap<QString, Preview> map;
+        for (int j = 0; j < count && stream.status() == QDataStream::Ok; ++j) {
+            QString widget;
+            QVariant value;
+            qint32 render;
+            stream >> widget >> value >> render;
+            map.insert(widget, Preview(value, static_cast<Property::Render>(render)));
+        }
+        m_previews.insert(screen, map);
+    }
+}
+
+void ScreensTree::writePreviews(QDataStream& stream) const
+{
+    stream << qint32(m_previews.size());
+    for (auto s = m_previews.cbegin(); s != m_previews.cend(); ++s) {
+        stream << s.key() << qint32(s.value().size());
+        for (auto w = s.value().cbegin(); w != s.value().cend(); ++w) {
+            stream << w.key() << w.value().value << qint32(w.value().render);
+        }
+    }
+}
+
 // ScreensModel
 
 ScreensModel::ScreensModel(ColorsModel& colors,
@@ -122,11 +167,14 @@ ScreensModel::ScreensModel(ColorsModel& colors,
                            FontsModel& fonts,
                            QObject* parent)
     : QAbstractItemModel(parent)
+    , m_batchDepth(0)
     , m_colorsModel(colors)
     , m_colorRolesModel(roles)
     , m_fontsModel(fonts)
     , m_root(new WidgetData())
     , m_commander(new QUndoStack(this))
+    , m_repository(nullptr)
+    , m_bulkLoading(false)
 {
     m_commander->setUndoLimit(100);
     m_root->setModel(this);
@@ -137,8 +185,32 @@ ScreensModel::ScreensModel(ColorsModel& colors,
 
 ScreensModel::~ScreensModel()
 {
+    qDeleteAll(m_bulkItems);
     delete m_root;
 }
+
+SkinRepository& ScreensModel::repository() const
+{
+    return m_repository ? *m_repository : SkinRepository::current();
+}
+
+QSize ScreensModel::outputSize() const
+{
+    return m_outputSize.isValid() ? m_outputSize : repository().outputSize();
+}
+
+void ScreensModel::setOutputSize(const QSize& size)
+{
+    if (size == m_outputSize)
+        return;
+    m_outputSize = size;
+    // Relative screens are resized, notify them in one go
+    beginChangesBatch();
+    for (int i = 0; i < m_root->childCount(); ++i) {
+        m_root->child(i)->parentSizeChanged();
+    }
+    endChangesBatch();
+}
 QVariant ScreensModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
@@ -333,6 +405,7 @@ QVector<WidgetData*> ScreensModel::takeChildren(int row, int count, WidgetData&
     if (&parent != m_root) {
         parentIndex = createIndex(parent.myIndex(), ColumnElement, &parent);
     }
+    TRACE_ZONE("model", "ScreensModel::rowsRemoved");
     beginRemoveRows(parentIndex, row, row + count - 1);
     auto items = parent.takeChildren(row, count);
     endRemoveRows();
@@ -348,18 +421,65 @@ void ScreensModel::insertChildren(int row, const QVector<WidgetData*>& childs, W
     if (&parent != m_root) {
         parentIndex = createIndex(parent.myIndex(), ColumnElement, &parent);
     }
+    TRACE_ZONE("model", "ScreensModel::rowsInserted");
     beginInsertRows(parentIndex, row, row + childs.count() - 1);
     parent.insertChildren(row, childs);
     endInsertRows();
 }
 
+void ScreensModel::moveChild(int from, int to, WidgetData& parent)
+{
+    Q_ASSERT(0 <= from && from < parent.childCount() && 0 <= to && to < parent.childCount());
+    if (from == to)
+        return;
+    QModelIndex parentIndex;
+    // createIndex doesn't work for root node
+    if (&parent != m_root) {
+        parentIndex = createIndex(parent.myIndex(), ColumnElement, &parent);
+    }
+    TRACE_ZONE("model", "ScreensModel::rowsMoved");
+    // Destination is counted before the move
+    beginMoveRows(parentIndex, from, from, parentIndex, to > from ? to + 1 : to);
+    parent.insertChildren(to, parent.takeChildren(from, 1));
+    endMoveRows();
+}
+
 void ScreensModel::clear()
 {
+    if (m_bulkLoading) {
+        // Screens are already gone, drop what was loaded so far
+        qDeleteAll(m_bulkItems);
+        m_bulkItems.clear();
+        return;
+    }
+    TRACE_ZONE("model", "ScreensModel::clear");
     beginResetModel();
-    QModelIndex rootIndex;
-    removeRows(0, rowCount(rootIndex), rootIndex);
+    // Commands may refer to the widgets, drop them first
+    m_commander->clear();
+    m_root->clear();
     endResetModel();
+}
+
+void ScreensModel::beginBulkLoad()
+{
+    Q_ASSERT(!m_bulkLoading);
+    beginResetModel();
     m_commander->clear();
+    m_root->clear();
+    m_bulkLoading = true;
+}
+
+void ScreensModel::endBulkLoad()
+{
+    Q_ASSERT(m_bulkLoading);
+    TRACE_ZONE("model", "ScreensModel::endBulkLoad");
+    m_bulkLoading = false;
+    m_root->insertChildren(0, m_bulkItems);
+    for (auto* item : qAsConst(m_bulkItems)) {
+        item->loadPreview(); // After it is attached to the model
+    }
+    m_bulkItems.clear();
+    endResetModel();
 }
 
 bool ScreensModel::moveRows(const QModelIndex& sourceParent,
@@ -388,21 +508,22 @@ bool ScreensModel::moveRows(const QModelIndex& sourceParent,
     return false;
 }
 
+QStringList ScreensModel::mimeTypes() const
+{
+    return QStringList{ rowsMimeType, widgetsMimeType };
+}
+
 QMimeData* ScreensModel::mimeData(const QModelIndexList& indexes) const
 {
     if (indexes.count() <= 0)
         return nullptr;
 
-    auto types = mimeTypes();
-    Q_ASSERT(types.count() > 0);
-    QString format = types.at(0);
-
-    // Store list of row indexes in the QMimeData
-    QMimeData* data = new QMimeData();
+    // Subtrees to copy anywhere and rows to move within this model
+    QMimeData* data = copyWidgets(indexes);
     QByteArray encoded;
     QDataStream stream(&encoded, QIODevice::WriteOnly);
     encodeRows(indexes, stream);
-    data->setData(format, encoded);
+    data->setData(rowsMimeType, encoded);
     return data;
 }
 
@@ -414,25 +535,32 @@ bool ScreensModel::dropMimeData(const QMimeData* data,
 {
     if (action == Qt::IgnoreAction)
         return true;
-    if (action != Qt::MoveAction)
+    if (action != Qt::MoveAction && action != Qt::CopyAction)
         return false;
 
-    auto types = mimeTypes();
-    Q_ASSERT(types.count() > 0);
-    QString format = types.at(0);
-
-    // Decode list of row indexes to move within the model
     Q_UNUSED(column);
-    QByteArray encoded = data->data(format);
-    QDataStream stream(&encoded, QIODevice::ReadOnly);
-    QVector<QModelIndex> rows = decodeRows(stream);
-
-    bool ok = true;
-    for (auto index : qAsConst(rows)) {
-        ok |= moveRow(index.parent(), index.row(), parent, row);
+    if (action == Qt::MoveAction && data->hasFormat(rowsMimeType)) {
+        // Move rows within the model
+        QByteArray encoded = data->data(rowsMimeType);
+        QDataStream stream(&encoded, QIODevice::ReadOnly);
+        const QVector<uint> rows = decodeRows(stream);
+        if (!rows.isEmpty()) {
+            for (uint id : rows) {
+                QModelIndex index = indexFromId(id);
+                if (index.isValid()) {
+                    moveRow(index.parent(), index.row(), parent, row);
+                }
+            }
+            // Default implementation removes successfully moved out rows,
+            // return false to disable it.
+            return false;
+        }
     }
-    // Default implementation removes successfully moved out rows, return false to disable it.
-    return false;
+    // Copy, or a drop from another instance
+    if (row < 0) {
+        row = rowCount(parent);
+    }
+    return pasteWidgets(data, parent, row);
 }
 
 Qt::DropActions ScreensModel::supportedDropActions() const
@@ -440,41 +568,301 @@ Qt::DropActions ScreensModel::supportedDropActions() const
     return Qt::MoveAction | Qt::CopyAction;
 }
 
+QMimeData* ScreensModel::copyWidgets(const QModelIndexList& indexes) const
+{
+    auto* data = new QMimeData();
+    auto items = outermostItems(indexes);
+    if (items.isEmpty())
+        return data;
+
+    QByteArray encoded;
+    QDataStream stream(&encoded, QIODevice::WriteOnly);
+    encodeWidgets(items, stream);
+    data->setData(widgetsMimeType, encoded);
+
+    // Plain XML for text editors and other applications, previews are lost
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    XmlStreamWriter xml(&buffer);
+    xml.setAutoFormatting(true);
+    xml.setAutoFormattingIndent(2);
+    xml.writeStartElement("skin");
+    for (auto* item : qAsConst(items)) {
+        item->toXml(xml);
+    }
+    xml.writeEndElement();
+    data->setText(QString::fromUtf8(buffer.data()));
+    return data;
+}
+
+bool ScreensModel::pasteWidgets(const QMimeData* data, const QModelIndex& parent, int row)
+{
+    Item* parentItem = indexToItem(parent);
+    if (!data || row < 0 || row > parentItem->childCount())
+        return false;
+
+    QVector<Item*> decoded;
+    bool fromXml = false;
+    if (data->hasFormat(widgetsMimeType)) {
+        QByteArray encoded = data->data(widgetsMimeType);
+        QDataStream stream(&encoded, QIODevice::ReadOnly);
+        decoded = decodeWidgets(stream);
+    }
+    if (decoded.isEmpty() && data->hasText()) {
+        decoded = widgetsFromXml(data->text());
+        fromXml = true;
+    }
+
+    QVector<Item*> items;
+    for (auto* item : qAsConst(decoded)) {
+        if (acceptsChild(parentItem, item)) {
+            items.append(item);
+        } else {
+            delete item;
+        }
+    }
+    if (items.isEmpty())
+        return false;
+
+    if (parentItem == m_root) {
+        makeScreenNamesUnique(items);
+    }
+    // All subtrees are inserted at once
+    m_commander->push(new InsertRowsCommand(*parentItem, row, items));
+    if (fromXml) {
+        // XML has no previews, take them from the preview map
+        for (auto* item : qAsConst(items)) {
+            item->loadPreview();
+        }
+    }
+    return true;
+}
+
+void ScreensModel::duplicateWidgets(const QModelIndexList& indexes)
+{
+    auto items = outermostItems(indexes);
+    if (items.isEmpty())
+        return;
+
+    QHash<Item*, QVector<Item*>> groups;
+    for (auto* item : qAsConst(items)) {
+        groups[item->parent()->self()].append(item);
+    }
+
+    // Copies of each parent's widgets go after the last of them
+    auto* command = new QUndoCommand(QString("duplicate %1 widgets").arg(items.size()));
+    for (auto it = groups.begin(); it != groups.end(); ++it) {
+        auto& siblings = it.value();
+        std::sort(siblings.begin(), siblings.end(), [](const Item* a, const Item* b) {
+            return a->myIndex() < b->myIndex();
+        });
+        QByteArray encoded;
+        QDataStream out(&encoded, QIODevice::WriteOnly);
+        encodeWidgets(siblings, out);
+        QDataStream in(&encoded, QIODevice::ReadOnly);
+        auto copies = decodeWidgets(in);
+        if (it.key() == m_root) {
+            makeScreenNamesUnique(copies);
+        }
+        new InsertRowsCommand(*it.key(), siblings.last()->myIndex() + 1, copies, command);
+    }
+    m_commander->push(command);
+}
+
+void ScreensModel::encodeWidgets(const QVector<Item*>& items, QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_11);
+    stream << widgetsFormatVersion << qint32(items.size());
+    for (auto* item : items) {
+        stream << bool(dynamic_cast<IncludeFile*>(item));
+        item->toStream(stream);
+    }
+}
+
+QVector<ScreensModel::Item*> ScreensModel::decodeWidgets(QDataStream& stream)
+{
+    QVector<Item*> items;
+    stream.setVersion(QDataStream::Qt_5_11);
+    quint32 version;
+    qint32 count;
+    stream >> version >> count;
+    if (version != widgetsFormatVersion)
+        return items;
+
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        bool include;
+        stream >> include;
+        Item* item = include ? new IncludeFile() : new WidgetData();
+        if (item->fromStream(stream)) {
+            items.append(item);
+        } else {
+            delete item;
+        }
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qDeleteAll(items);
+        items.clear();
+    }
+    return items;
+}
+
+QVector<ScreensModel::Item*> ScreensModel::widgetsFromXml(const QString& text)
+{
+    QVector<Item*> items;
+    QXmlStreamReader xml(text);
+    if (!xml.readNextStartElement())
+        return items;
+
+    auto readElement = [&]() {
+        bool ok = xml.name() == IncludeFile::tag;
+        Item* item = nullptr;
+        if (ok) {
+            item = new IncludeFile();
+        } else {
+            WidgetData::strToType(xml.name(), ok);
+            item = ok ? new WidgetData() : nullptr;
+        }
+        if (!item) {
+            xml.skipCurrentElement(); // colors, fonts and such
+        } else if (item->fromXml(xml)) {
+            items.append(item);
+        } else {
+            delete item;
+        }
+    };
+    // Several elements wrapped in <skin> or a single one
+    if (xml.name() == "skin") {
+        while (xml.readNextStartElement()) {
+            readElement();
+        }
+    } else {
+        readElement();
+    }
+
+    if (xml.hasError()) {
+        qWarning() << "failed to paste xml:" << xml.errorString();
+        qDeleteAll(items);
+        items.clear();
+    }
+    return items;
+}
+
+bool ScreensModel::acceptsChild(const Item* parent, const Item* child) const
+{
+    // Screens and includes are top level, widgets live in screens
+    const bool topLevel = child->type() == WidgetData::WidgetType::Screen
+                          || dynamic_cast<const IncludeFile*>(child);
+    if (parent == m_root) {
+        return topLevel;
+    }
+    return !topLevel && parent->type() == WidgetData::WidgetType::Screen;
+}
+
+void ScreensModel::makeScreenNamesUnique(const QVector<Item*>& items) const
+{
+    QSet<QString> names;
+    for (int i = 0; i < m_root->childCount(); ++i) {
+        names.insert(m_root->child(i)->name());
+    }
+    for (auto* item : items) {
+        const QString base = item->name();
+        if (item->type() != WidgetData::WidgetType::Screen || base.isEmpty())
+            continue;
+        QString name = base;
+        for (int n = 1; names.contains(name); ++n) {
+            name = n == 1 ? base + "_copy" : QString("%1_copy%2").arg(base).arg(n);
+        }
+        if (name != base) {
+            item->setName(name);
+        }
+        names.insert(name);
+    }
+}
+
 void ScreensModel::appendFromXml(QXmlStreamReader& xml)
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == "screen");
 
-    beginInsertRows(QModelIndex(), m_root->childCount(), m_root->childCount());
-
     auto* w = new WidgetData();
     w->fromXml(xml);
-    m_root->appendChild(w);
-    w->loadPreview(); // After widget is attached to the model
-
-    endInsertRows();
+    appendTopLevel(w);
 }
 
 void ScreensModel::appendIncludeFromXml(QXmlStreamReader& xml)
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == "include");
 
-    beginInsertRows(QModelIndex(), m_root->childCount(), m_root->childCount());
-
     auto* element = new IncludeFile();
     element->fromXml(xml);
-    m_root->appendChild(element);
-    element->loadPreview(); // After it is attached to the model
+    appendTopLevel(element);
+}
 
+void ScreensModel::appendTopLevel(WidgetData* item)
+{
+    if (m_bulkLoading) {
+        m_bulkItems.append(item);
+        return;
+    }
+    const int row = m_root->childCount();
+    beginInsertRows(QModelIndex(), row, row);
+    m_root->appendChild(item);
+    item->loadPreview(); // After it is attached to the model
     endInsertRows();
 }
 
 void ScreensModel::toXml(XmlStreamWriter& xml)
 {
     for (int i = 0; i < m_root->childCount(); ++i) {
-        m_root->child(i)->toXml(xml);
+        const Item* item = m_root->child(i);
+        item->toXml(xml);
+        // Saving the skin saves its include files too
+        if (auto* include = dynamic_cast<const IncludeFile*>(item)) {
+            include->save();
+        }
+    }
+}
+
+bool ScreensModel::fromStream(QDataStream& stream)
+{
+    beginResetModel();
+    m_root->clear();
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        bool include;
+        stream >> include;
+        WidgetData* w = include ? new IncludeFile() : new WidgetData();
+        if (w->fromStream(stream)) {
+            m_root->appendChild(w);
+        } else {
+            delete w;
+        }
+    }
+    endResetModel();
+    return stream.status() == QDataStream::Ok;
+}
+
+void ScreensModel::toStream(QDataStream& stream) const
+{
+    stream << qint32(m_root->childCount());
+    for (int i = 0; i < m_root->childCount(); ++i) {
+        auto* w = m_root->child(i);
+        stream << bool(dynamic_cast<IncludeFile*>(w));
+        w->toStream(stream);
     }
 }
 
+QStringList ScreensModel::includeFiles() const
+{
+    QStringList files;
+    for (int i = 0; i < m_root->childCount(); ++i) {
+        if (auto* include = dynamic_cast<IncludeFile*>(m_root->child(i))) {
+            files.append(include->fileName());
+        }
+    }
+    return files;
+}
+
 const WidgetData& ScreensModel::widget(const QModelIndex& index) const
 {
     if (!index.isValid())
@@ -482,6 +870,21 @@ const WidgetData& ScreensModel::widget(const QModelIndex& index) const
     return *indexToItem(index);
 }
 
+uint ScreensModel::idFromIndex(const QModelIndex& index) const
+{
+    if (!index.isValid())
+        return UniqueId::invalid;
+    return castItem(index)->id();
+}
+
+QModelIndex ScreensModel::indexFromId(uint id, int column) const
+{
+    auto* widget = m_widgetIds.value(id);
+    if (!widget || widget == m_root)
+        return QModelIndex();
+    return createIndex(widget->myIndex(), column, widget);
+}
+
 QVariant ScreensModel::widgetAttr(const QModelIndex& index, int key) const
 {
     if (!index.isValid())
@@ -527,6 +930,139 @@ bool ScreensModel::setWidgetDataFromXml(const QModelIndex& index, QXmlStreamRead
     return true;
 }
 
+bool ScreensModel::mergeChildren(const QModelIndex& parent,
+                                 const QVector<WidgetData*>& items,
+                                 const QString& text)
+{
+    TRACE_ZONE("model", "ScreensModel::mergeChildren");
+    // Owns the new version until its widgets are inserted
+    WidgetData fresh;
+    fresh.insertChildren(0, items);
+
+    auto* command = new QUndoCommand(text);
+    QVector<Item*> inserted;
+    diffChildren(*indexToItem(parent), fresh, command, inserted);
+    if (command->childCount() == 0) {
+        delete command;
+        return false;
+    }
+    // Inserted widgets belong to the commands now
+    for (auto* item : qAsConst(inserted)) {
+        item->parent()->takeChildren(item->myIndex(), 1);
+    }
+
+    beginChangesBatch();
+    m_commander->push(command);
+    endChangesBatch();
+    // recover preview data
+    for (auto* item : qAsConst(inserted)) {
+        item->loadPreview();
+    }
+    return true;
+}
+
+QStringList ScreensModel::matchKeys(const Item& parent)
+{
+    QStringList keys;
+    QHash<QString, int> seen;
+    for (int i = 0; i < parent.childCount(); ++i) {
+        const Item* item = parent.child(i);
+        QString key;
+        if (auto* include = dynamic_cast<const IncludeFile*>(item)) {
+            key = "include:" + include->fileName();
+        } else if (!item->name().isEmpty()) {
+            key = "name:" + item->name();
+        } else {
+            key = QString("type:%1:%2").arg(int(item->type())).arg(item->source());
+        }
+        // Siblings with the same key are matched in order
+        keys.append(QString("%1#%2").arg(key).arg(seen[key]++));
+    }
+    return keys;
+}
+
+void ScreensModel::diffChildren(Item& live,
+                                Item& fresh,
+                                QUndoCommand* command,
+                                QVector<Item*>& inserted)
+{
+    const QStringList freshKeys = matchKeys(fresh);
+    QHash<QString, int> freshRows;
+    for (int row = 0; row < freshKeys.size(); ++row) {
+        freshRows.insert(freshKeys[row], row);
+    }
+
+    // Live widgets by row of the new version
+    QVector<Item*> kept(fresh.childCount(), nullptr);
+    QVector<int> removed;
+    QVector<Item*> order;
+    const QStringList liveKeys = matchKeys(live);
+    for (int i = 0; i < live.childCount(); ++i) {
+        const int row = freshRows.value(liveKeys[i], -1);
+        Item* item = live.child(i);
+        if (row >= 0 && item->isPatchableFrom(*fresh.child(row))) {
+            kept[row] = item;
+            order.append(item);
+        } else {
+            removed.append(i);
+        }
+    }
+
+    // Back to front, so rows of the next ranges stay valid
+    for (int end = removed.size(); end > 0;) {
+        int begin = end - 1;
+        while (begin > 0 && removed[begin - 1] == removed[begin] - 1) {
+            --begin;
+        }
+        new RemoveRowsCommand(live, removed[begin], end - begin, command);
+        end = begin;
+    }
+
+    // Reordered siblings are moved, so they keep their ids
+    int target = 0;
+    for (Item* item : qAsConst(kept)) {
+        if (!item)
+            continue;
+        const int from = order.indexOf(item, target);
+        if (from != target) {
+            new MoveRowsCommand(live, from, target, command);
+            order.move(from, target);
+        }
+        ++target;
+    }
+
+    for (int row = 0; row < fresh.childCount();) {
+        if (Item* item = kept[row]) {
+            diffAttributes(*item, *fresh.child(row), command);
+            // Screens of an include are merged when its own file changes
+            if (!dynamic_cast<IncludeFile*>(item)) {
+                diffChildren(*item, *fresh.child(row), command, inserted);
+            }
+            ++row;
+            continue;
+        }
+        const int first = row;
+        QVector<Item*> items;
+        for (; row < fresh.childCount() && !kept[row]; ++row) {
+            items.append(fresh.child(row));
+        }
+        new InsertRowsCommand(live, first, items, command);
+        inserted += items;
+    }
+}
+
+void ScreensModel::diffAttributes(Item& live, const Item& fresh, QUndoCommand* command)
+{
+    for (int key : WidgetData::attrKeys()) {
+        // Preview values are not stored in the skin
+        if (key >= Property::preview)
+            continue;
+        if (live.attrString(key) != fresh.attrString(key)) {
+            new AttrCommand(&live, key, fresh.getAttr(key), command);
+        }
+    }
+}
+
 void ScreensModel::resizeWidget(const QModelIndex& index, const QSize& size)
 {
     auto* widget = indexToItem(index);
@@ -551,20 +1087,206 @@ void ScreensModel::changeWidgetRect(const QModelIndex& index, const QRect& rect)
     }
 }
 
-void ScreensModel::registerObserver(const QModelIndex& index)
+bool ScreensModel::setWidgetsAttr(const QModelIndexList& indexes, int key, const QVariant& value)
 {
-    if (!index.isValid())
+    auto widgets = indexesToItems(indexes);
+    if (widgets.isEmpty())
+        return false;
+    m_commander->push(new BatchAttrCommand(widgets, key, value));
+    return true;
+}
+
+bool ScreensModel::retarget(const QSize& resolution,
+                            OutputsModel& outputs,
+                            WindowStylesList& styles)
+{
+    const QSize current = outputs.getOutput(0).size();
+    if (current.isEmpty() || resolution.isEmpty() || resolution == current)
+        return false;
+    TraceZone zone("command", "ScreensModel::retarget");
+    zone.setDetail(QString("%1 widgets").arg(m_widgetIds.size()));
+    m_commander->push(new RetargetCommand(*m_root, outputs, styles, resolution));
+    return true;
+}
+
+void ScreensModel::moveWidgets(const QModelIndexList& indexes, const QVector<QPoint>& points)
+{
+    QVector<Item*> widgets;
+    QVector<QPoint> targets;
+    for (int i = 0; i < indexes.size() && i < points.size(); ++i) {
+        if (indexes[i].isValid()) {
+            widgets.append(castItem(indexes[i]));
+            targets.append(points[i]);
+        }
+    }
+    if (!widgets.isEmpty()) {
+        m_commander->push(new MoveWidgetsCommand(widgets, targets));
+    }
+}
+
+void ScreensModel::nudgeWidgets(const QModelIndexList& indexes, const QPoint& delta)
+{
+    auto widgets = indexesToItems(indexes);
+    if (widgets.isEmpty())
         return;
-    if (m_observers[index]++ == 0) {
-        indexToItem(index)->updateCache();
+    QVector<QPoint> points;
+    for (auto* w : qAsConst(widgets)) {
+        points.append(w->absolutePosition() + delta);
     }
+    // Holding an arrow key gives one undo step
+    m_commander->push(new MoveWidgetsCommand(widgets, points, true));
 }
 
-void ScreensModel::unregisterObserver(const QModelIndex& index)
+void ScreensModel::alignWidgets(const QModelIndexList& indexes, Qt::Alignment alignment)
 {
-    if (!index.isValid())
+    auto widgets = indexesToItems(indexes);
+    if (widgets.size() < 2)
+        return;
+
+    // Align to the bounding rect of the selection
+    QRect bounds;
+    for (auto* w : qAsConst(widgets)) {
+        bounds |= QRect(w->absolutePosition(), w->selfSize());
+    }
+    QVector<QPoint> points;
+    for (auto* w : qAsConst(widgets)) {
+        QRect r(w->absolutePosition(), w->selfSize());
+        if (alignment & Qt::AlignLeft) {
+            r.moveLeft(bounds.left());
+        } else if (alignment & Qt::AlignRight) {
+            r.moveRight(bounds.right());
+        } else if (alignment & Qt::AlignHCenter) {
+            r.moveCenter(QPoint(bounds.center().x(), r.center().y()));
+        }
+        if (alignment & Qt::AlignTop) {
+            r.moveTop(bounds.top());
+        } else if (alignment & Qt::AlignBottom) {
+            r.moveBottom(bounds.bottom());
+        } else if (alignment & Qt::AlignVCenter) {
+            r.moveCenter(QPoint(r.center().x(), bounds.center().y()));
+        }
+        points.append(r.topLeft());
+    }
+    m_commander->push(new MoveWidgetsCommand(widgets, points));
+}
+
+void ScreensModel::distributeWidgets(const QModelIndexList& indexes, Qt::Orientation orientation)
+{
+    auto widgets = indexesToItems(indexes);
+    if (widgets.size() < 3)
+        return;
+
+    const bool horizontal = orientation == Qt::Horizontal;
+    auto start = [horizontal](const Item* w) {
+        QPoint p = w->absolutePosition();
+        return horizontal ? p.x() : p.y();
+    };
+    auto length = [horizontal](const Item* w) {
+        QSize s = w->selfSize();
+        return horizontal ? s.width() : s.height();
+    };
+    std::sort(widgets.begin(), widgets.end(), [&](const Item* a, const Item* b) {
+        return start(a) < start(b);
+    });
+
+    // Keep the outer widgets in place and make the gaps between all widgets equal
+    int total = 0;
+    for (auto* w : qAsConst(widgets)) {
+        total += length(w);
+    }
+    const int first = start(widgets.first());
+    const int last = start(widgets.last()) + length(widgets.last());
+    const qreal gap = qreal(last - first - total) / (widgets.size() - 1);
+
+    QVector<QPoint> points;
+    qreal pos = first;
+    for (auto* w : qAsConst(widgets)) {
+        QPoint p = w->absolutePosition();
+        if (horizontal) {
+            p.setX(qRound(pos));
+        } else {
+            p.setY(qRound(pos));
+        }
+        points.append(p);
+        pos += length(w) + gap;
+    }
+    m_commander->push(new MoveWidgetsCommand(widgets, points));
+}
+
+void ScreensModel::removeWidgets(const QModelIndexList& indexes)
+{
+    // Widgets removed with their ancestor are skipped
+    auto widgets = outermostItems(indexes);
+    if (widgets.isEmpty())
+        return;
+
+    // Rows to remove grouped by parent
+    QHash<Item*, QVector<int>> rows;
+    for (auto* w : qAsConst(widgets)) {
+        rows[w->parent()->self()].append(w->myIndex());
+    }
+
+    // One compound command, contiguous rows are removed at once
+    auto* command = new QUndoCommand(QString("rm %1 widgets").arg(widgets.size()));
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        auto& list = it.value();
+        std::sort(list.begin(), list.end(), std::greater<int>());
+        // Remove from the bottom, so remaining row numbers stay valid
+        int i = 0;
+        while (i < list.size()) {
+            int j = i + 1;
+            while (j < list.size() && list[j] == list[j - 1] - 1) {
+                ++j;
+            }
+            new RemoveRowsCommand(*it.key(), list[j - 1], j - i, command);
+            i = j;
+        }
+    }
+    m_commander->push(command);
+}
+
+void ScreensModel::beginChangesBatch()
+{
+    ++m_batchDepth;
+}
+
+void ScreensModel::endChangesBatch()
+{
+    Q_ASSERT(m_batchDepth > 0);
+    if (--m_batchDepth > 0)
+        return;
+
+    auto changes = m_batchChanges;
+    m_batchChanges.clear();
+    m_batchSeen.clear();
+    if (changes.isEmpty())
+        return;
+
+    TRACE_ZONE("model", "ScreensModel::widgetsChanged");
+    for (const auto& change : qAsConst(changes)) {
+        if (auto* w = m_widgetIds.value(change.first)) {
+            emitNameChanged(w, change.second);
+        }
+    }
+    emit widgetsChanged(changes);
+}
+
+void ScreensModel::registerObserver(uint id)
+{
+    if (id == UniqueId::invalid)
         return;
-    auto it = m_observers.find(index);
+    if (m_observers[id]++ == 0) {
+        if (auto* w = m_widgetIds.value(id)) {
+            w->updateCache();
+        }
+    }
+}
+
+void ScreensModel::unregisterObserver(uint id)
+{
+    if (id == UniqueId::invalid)
+        return;
+    auto it = m_observers.find(id);
     if (it != m_observers.end()) {
         it.value()--;
         if (it.value() == 0) {
@@ -575,12 +1297,35 @@ void ScreensModel::unregisterObserver(const QModelIndex& index)
     }
 }
 
+void ScreensModel::widgetAttached(WidgetData* widget)
+{
+    Q_ASSERT(!m_widgetIds.contains(widget->id()));
+    m_widgetIds.insert(widget->id(), widget);
+}
+
+void ScreensModel::widgetDetached(WidgetData* widget)
+{
+    m_widgetIds.remove(widget->id());
+}
+
 void ScreensModel::widgetAttrHasChanged(const WidgetData* widget, int attrKey)
 {
-    QModelIndex index =
-      createIndex(widget->myIndex(), ColumnElement, const_cast<WidgetData*>(widget));
-    emit widgetChanged(index, attrKey);
+    if (m_batchDepth > 0) {
+        auto change = qMakePair(widget->id(), attrKey);
+        if (!m_batchSeen.contains(change)) {
+            m_batchSeen.insert(change);
+            m_batchChanges.append(change);
+        }
+        return;
+    }
 
+    TRACE_ZONE("model", "ScreensModel::widgetChanged");
+    emit widgetChanged(widget->id(), attrKey);
+    emitNameChanged(widget, attrKey);
+}
+
+void ScreensModel::emitNameChanged(const WidgetData* widget, int attrKey)
+{
     //    switch (widget->type()) {
     //    case WidgetData::Label:
     //        if (attrKey != Property::text)
@@ -601,7 +1346,8 @@ void ScreensModel::widgetAttrHasChanged(const WidgetData* widget, int attrKey)
     case Property::name:
     case Property::source:
     case Property::pixmap:
-        auto nameIndex = index.sibling(index.row(), ColumnName);
+        auto nameIndex =
+          createIndex(widget->myIndex(), ColumnName, const_cast<WidgetData*>(widget));
         emit dataChanged(nameIndex, nameIndex);
     }
 }
@@ -609,24 +1355,27 @@ void ScreensModel::widgetAttrHasChanged(const WidgetData* widget, int attrKey)
 void ScreensModel::onColorChanged(const QString& name, QRgb value)
 {
     for (auto it = m_observers.begin(); it != m_observers.end(); ++it) {
-        auto* w = indexToItem(it.key());
-        w->onColorChanged(name, value);
+        if (auto* w = m_widgetIds.value(it.key())) {
+            w->onColorChanged(name, value);
+        }
     }
 }
 
 void ScreensModel::onStyledColorChanged(WindowStyleColor::ColorRole role, QRgb value)
 {
     for (auto it = m_observers.begin(); it != m_observers.end(); ++it) {
-        auto* w = indexToItem(it.key());
-        w->onStyledColorChanged(role, value);
+        if (auto* w = m_widgetIds.value(it.key())) {
+            w->onStyledColorChanged(role, value);
+        }
     }
 }
 
 void ScreensModel::onFontChanged(const QString& name, const Font& value)
 {
     for (auto it = m_observers.begin(); it != m_observers.end(); ++it) {
-        auto* w = indexToItem(it.key());
-        w->onFontChanged(name, value);
+        if (auto* w = m_widgetIds.value(it.key())) {
+            w->onFontChanged(name, value);
+        }
     }
 }
 
@@ -646,6 +1395,44 @@ ScreensModel::Item* ScreensModel::castItem(const QModelIndex& index)
     return static_cast<Item*>(index.internalPointer());
 }
 
+QVector<ScreensModel::Item*> ScreensModel::outermostItems(const QModelIndexList& indexes) const
+{
+    auto items = indexesToItems(indexes);
+    QSet<Item*> selected;
+    for (auto* item : qAsConst(items)) {
+        selected.insert(item);
+    }
+    QVector<Item*> result;
+    for (auto* item : qAsConst(items)) {
+        bool nested = false;
+        for (auto* p = item->parent(); p && p->isChild(); p = p->self()->parent()) {
+            if (selected.contains(p->self())) {
+                nested = true;
+                break;
+            }
+        }
+        if (!nested) {
+            result.append(item);
+        }
+    }
+    return result;
+}
+
+QVector<ScreensModel::Item*> ScreensModel::indexesToItems(const QModelIndexList& indexes) const
+{
+    QVector<Item*> items;
+    for (const auto& index : indexes) {
+        if (!index.isValid())
+            continue;
+        Q_ASSERT(index.model() == this);
+        auto* item = castItem(index);
+        if (!items.contains(item)) {
+            items.append(item);
+        }
+    }
+    return items;
+}
+
 bool ScreensModel::isValidMove(const QModelIndex& sourceParent,
                                int sourceRow,
                                int count,
@@ -663,26 +1450,31 @@ bool ScreensModel::isValidMove(const QModelIndex& sourceParent,
 
 void ScreensModel::encodeRows(const QModelIndexList& indexes, QDataStream& stream) const
 {
-    QVector<QModelIndex> rows;
+    // Widget ids are only meaningful within this process
+    stream << QCoreApplication::applicationPid();
+    QVector<uint> rows;
     for (const auto& index : indexes) {
-        auto rowIndex = index.sibling(index.row(), 0);
-        if (!rows.contains(rowIndex)) {
-            rows.append(rowIndex);
+        uint id = idFromIndex(index);
+        if (id != UniqueId::invalid && !rows.contains(id)) {
+            rows.append(id);
         }
     }
-    for (const auto& index : rows) {
-        stream << index.row() << index.internalId();
+    for (uint id : qAsConst(rows)) {
+        stream << id;
     }
 }
 
-QVector<QModelIndex> ScreensModel::decodeRows(QDataStream& stream) const
+QVector<uint> ScreensModel::decodeRows(QDataStream& stream) const
 {
-    QVector<QModelIndex> rows;
+    QVector<uint> rows;
+    qint64 pid;
+    stream >> pid;
+    if (pid != QCoreApplication::applicationPid())
+        return rows;
     while (!stream.atEnd()) {
-        int r;
-        quintptr i;
-        stream >> r >> i;
-        rows.append(createIndex(r, 0, i));
+        uint id;
+        stream >> id;
+        rows.append(id);
     }
     return rows;
 }
@@ -754,23 +1546,38 @@ void ScreensModel::savePreviewTree(const QString& path)
     xml.writeEndDocument();
 }
 
-WidgetObserverRegistrator::WidgetObserverRegistrator(ScreensModel* model, const QModelIndex& index)
+WidgetObserverRegistrator::WidgetObserverRegistrator(ScreensModel* model, uint id)
     : m_model(model)
-    , m_index(index)
+    , m_id(id)
 {
-    m_model->registerObserver(index);
+    m_model->registerObserver(m_id);
 }
 
-void WidgetObserverRegistrator::setIndex(const QModelIndex& index)
+void WidgetObserverRegistrator::setId(uint id)
 {
-    m_model->unregisterObserver(m_index);
-    m_index = index;
-    m_model->registerObserver(m_index);
+    m_model->unregisterObserver(m_id);
+    m_id = id;
+    m_model->registerObserver(m_id);
 }
 
 WidgetObserverRegistrator::~WidgetObserverRegistrator()
 {
-    m_model->unregisterObserver(m_index);
+    m_model->unregisterObserver(m_id);
+}
+
+WidgetChangesBatch::WidgetChangesBatch(ScreensModel* model)
+    : m_model(model)
+{
+    if (m_model) {
+        m_model->beginChangesBatch();
+    }
+}
+
+WidgetChangesBatch::~WidgetChangesBatch()
+{
+    if (m_model) {
+        m_model->endChangesBatch();
+    }
 }
 
 RemoveRowsCommand::RemoveRowsCommand(WidgetData& root, int row, int count, QUndoCommand* parent)
@@ -786,12 +1593,14 @@ RemoveRowsCommand::RemoveRowsCommand(WidgetData& root, int row, int count, QUndo
 
 void RemoveRowsCommand::redo()
 {
+    TRACE_ZONE("command", "RemoveRowsCommand::redo");
     // Take ownership from the model
     m_items = m_root.model()->takeChildren(m_row, m_count, m_root);
 }
 
 void RemoveRowsCommand::undo()
 {
+    TRACE_ZONE("command", "RemoveRowsCommand::undo");
     // Transfer ownership to the model
     m_root.model()->insertChildren(m_row, m_items, m_root);
     m_items.clear();
@@ -819,6 +1628,7 @@ InsertRowsCommand::InsertRowsCommand(WidgetData& root,
 
 void InsertRowsCommand::redo()
 {
+    TRACE_ZONE("command", "InsertRowsCommand::redo");
     // Transfer ownership to the model
     m_root.model()->insertChildren(m_row, m_items, m_root);
     m_items.clear();
@@ -826,6 +1636,7 @@ void InsertRowsCommand::redo()
 
 void InsertRowsCommand::undo()
 {
+    TRACE_ZONE("command", "InsertRowsCommand::undo");
     // Take ownership from the model
     m_items = m_root.model()->takeChildren(m_row, m_count, m_root);
 }
@@ -834,3 +1645,26 @@ InsertRowsCommand::~InsertRowsCommand()
 {
     qDeleteAll(m_items);
 }
+
+MoveRowsCommand::MoveRowsCommand(WidgetData& root, int from, int to, QUndoCommand* parent)
+    : QUndoCommand(parent)
+    , m_root(root)
+    , m_from(from)
+    , m_to(to)
+{
+    // Can not work without a model
+    Q_ASSERT(m_root.model() != nullptr);
+    setText(QString("move widget from %1 to %2").arg(from).arg(to));
+}
+
+void MoveRowsCommand::redo()
+{
+    TRACE_ZONE("command", "MoveRowsCommand::redo");
+    m_root.model()->moveChild(m_from, m_to, m_root);
+}
+
+void MoveRowsCommand::undo()
+{
+    TRACE_ZONE("command", "MoveRowsCommand::undo");
+    m_root.model()->moveChild(m_to, m_from, m_root);
+}
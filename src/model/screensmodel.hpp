@@ -4,6 +4,7 @@
 #include "model/windowstyle.hpp"
 #include "commands/attrcommand.hpp"
 #include <QAbstractItemModel>
+#include <QSet>
 #include <QUndoStack>
 
 struct Preview
@@ -26,6 +27,14 @@ public:
      */
     void savePreviews(const QString& path);
     Preview getPreview(const QString& screen, const QString& widget) const;
+    // Previews of all widgets of the screen by widget name
+    QMap<QString, Preview> screenPreviews(const QString& screen) const
+    {
+        return m_previews.value(screen);
+    }
+    // Binary cache
+    void readPreviews(QDataStream& stream);
+    void writePreviews(QDataStream& stream) const;
 
 protected:
     QMap<QString, QMap<QString, Preview>> m_previews;
@@ -34,6 +43,8 @@ protected:
 class ColorsModel;
 class ColorRolesModel;
 class FontsModel;
+class OutputsModel;
+class SkinRepository;
 
 class ScreensModel : public QAbstractItemModel, public ScreensTree
 {
@@ -86,6 +97,7 @@ public:
 
     // Remove data:
     bool removeRows(int row, int count, const QModelIndex& parent = QModelIndex()) override;
+    // Remove all screens with a single reset, the undo history is dropped
     void clear();
 
     bool moveRows(const QModelIndex& sourceParent,
@@ -96,6 +108,7 @@ public:
 
     // Drag and drop:
 
+    QStringList mimeTypes() const override;
     /// Returns ownership according to Qt documentation
     QMimeData* mimeData(const QModelIndexList& indexes) const override;
     bool dropMimeData(const QMimeData* data,
@@ -105,14 +118,43 @@ public:
                       const QModelIndex& parent) override;
     Qt::DropActions supportedDropActions() const override;
 
+    // Clipboard:
+
+    /// Serialized subtrees, binary with XML text fallback. Returns ownership
+    QMimeData* copyWidgets(const QModelIndexList& indexes) const;
+    /// Inserts subtrees from @p data in a single step, false if nothing fits under @p parent
+    bool pasteWidgets(const QMimeData* data, const QModelIndex& parent, int row);
+    void duplicateWidgets(const QModelIndexList& indexes);
+
+    /**
+     * @brief Load a whole document in one transaction
+     * Current screens are removed without undo commands, screens appended
+     * until endBulkLoad() are built detached and published with the same
+     * model reset.
+     */
+    void beginBulkLoad();
+    void endBulkLoad();
+    bool isBulkLoading() const { return m_bulkLoading; }
+
     // Xml:
     void appendFromXml(QXmlStreamReader& xml);
     void appendIncludeFromXml(QXmlStreamReader& xml);
     void toXml(XmlStreamWriter& xml);
 
+    // Binary cache:
+    bool fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
+    // Names of included files
+    QStringList includeFiles() const;
+
     // Read only access to widget:
     const WidgetData& widget(const QModelIndex& index) const;
 
+    // Stable widget ids, use them to refer to widgets outside of Qt views
+    const WidgetData* widgetById(uint id) const { return m_widgetIds.value(id); }
+    uint idFromIndex(const QModelIndex& index) const;
+    QModelIndex indexFromId(uint id, int column = ColumnElement) const;
+
     // Access widget attributes:
     QVariant widgetAttr(const QModelIndex& index, int key) const;
     bool setWidgetAttr(const QModelIndex& index, int key, const QVariant& value);
@@ -125,11 +167,32 @@ public:
     // Edit widget with XML editor
     bool setWidgetDataFromXml(const QModelIndex& index, QXmlStreamReader& xml);
 
+    /**
+     * @brief Apply another version of the children of @p parent
+     * Widgets are matched by name, or by type and order when unnamed.
+     * Matched widgets keep their ids and get only the attributes which
+     * differ, reordered ones are moved, the rest is removed or inserted,
+     * all in one undo step. Preview values are left as they are.
+     * Takes ownership of @p items.
+     * @return false if nothing differs
+     */
+    bool mergeChildren(const QModelIndex& parent,
+                       const QVector<WidgetData*>& items,
+                       const QString& text);
+
     // Access associated fonts and colors
     const ColorsModel& colors() const { return m_colorsModel; }
     const FontsModel& fonts() const { return m_fontsModel; }
     const ColorRolesModel& roles() const { return m_colorRolesModel; }
 
+    // Document the model belongs to, the current repository if not set
+    SkinRepository& repository() const;
+    void setRepository(SkinRepository* repository) { m_repository = repository; }
+
+    // Size of the video output, the parent size of screens
+    QSize outputSize() const;
+    void setOutputSize(const QSize& size);
+
     // Access undo model
     QUndoStack* undoStack() const { return m_commander; }
 
@@ -138,16 +201,41 @@ public:
     void moveWidget(const QModelIndex& index, const QPoint& pos);
     void changeWidgetRect(const QModelIndex& index, const QRect& rect);
 
-    // widgetChanged only emitted for widgets being observed
-    void registerObserver(const QModelIndex& index);
-    void unregisterObserver(const QModelIndex& index);
+    // Bulk operations on several widgets, each is a single undo step
+    bool setWidgetsAttr(const QModelIndexList& indexes, int key, const QVariant& value);
+    void moveWidgets(const QModelIndexList& indexes, const QVector<QPoint>& points);
+    void nudgeWidgets(const QModelIndexList& indexes, const QPoint& delta);
+    void alignWidgets(const QModelIndexList& indexes, Qt::Alignment alignment);
+    void distributeWidgets(const QModelIndexList& indexes, Qt::Orientation orientation);
+    void removeWidgets(const QModelIndexList& indexes);
+
+    /**
+     * @brief Scale the document to another resolution of the first output
+     * One undo step and one batched notification, see RetargetCommand.
+     * @return false if the resolution is the same or unknown
+     */
+    bool retarget(const QSize& resolution, OutputsModel& outputs, WindowStylesList& styles);
+
+    // Attribute changes between begin and end are reported by one widgetsChanged
+    void beginChangesBatch();
+    void endChangesBatch();
+
+    // Color and font changes are only propagated to widgets being observed
+    void registerObserver(uint id);
+    void unregisterObserver(uint id);
+
+    // to be called from WidgetData when it joins or leaves the tree
+    void widgetAttached(WidgetData* widget);
+    void widgetDetached(WidgetData* widget);
 
     // Build preview map from widget tree
     void updatePreviewMap(const QModelIndex& index);
     void savePreviewTree(const QString& path);
 
 signals:
-    void widgetChanged(const QModelIndex& index, int attr);
+    void widgetChanged(uint id, int attr);
+    // Changes collected in a batch, each (id, attr) pair once
+    void widgetsChanged(const QVector<QPair<uint, int>>& changes);
 
 public slots:
     // to be called from WidgetData
@@ -160,12 +248,32 @@ public slots:
 protected:
     QVector<WidgetData*> takeChildren(int row, int count, WidgetData& parent);
     void insertChildren(int row, const QVector<WidgetData*>& childs, WidgetData& parent);
+    // Moves one child within its parent, @p to is its row afterwards
+    void moveChild(int from, int to, WidgetData& parent);
     friend class RemoveRowsCommand;
     friend class InsertRowsCommand;
+    friend class MoveRowsCommand;
 
 private:
     Item* indexToItem(const QModelIndex& index) const;
     static Item* castItem(const QModelIndex& index);
+    // Distinct widgets of the rows, invalid indexes are skipped
+    QVector<Item*> indexesToItems(const QModelIndexList& indexes) const;
+    // Same, without widgets whose ancestor is in the list
+    QVector<Item*> outermostItems(const QModelIndexList& indexes) const;
+    // Clipboard helpers
+    static void encodeWidgets(const QVector<Item*>& items, QDataStream& stream);
+    static QVector<Item*> decodeWidgets(QDataStream& stream);
+    static QVector<Item*> widgetsFromXml(const QString& text);
+    bool acceptsChild(const Item* parent, const Item* child) const;
+    void makeScreenNamesUnique(const QVector<Item*>& items) const;
+    void emitNameChanged(const WidgetData* widget, int attrKey);
+    // Merge helpers, commands are created as children of @p command
+    static QStringList matchKeys(const Item& parent);
+    void diffChildren(Item& live, Item& fresh, QUndoCommand* command, QVector<Item*>& inserted);
+    void diffAttributes(Item& live, const Item& fresh, QUndoCommand* command);
+    // Appends a screen or an include, or keeps it detached during a bulk load
+    void appendTopLevel(WidgetData* item);
 
     bool isValidMove(const QModelIndex& sourceParent,
                      int sourceRow,
@@ -173,9 +281,17 @@ private:
                      const QModelIndex& destinationParent,
                      int destinationChild) const;
     void encodeRows(const QModelIndexList& indexes, QDataStream& stream) const;
-    QVector<QModelIndex> decodeRows(QDataStream& stream) const;
+    QVector<uint> decodeRows(QDataStream& stream) const;
 
-    QHash<QPersistentModelIndex, int> m_observers;
+    // widget id -> observers count
+    QHash<uint, int> m_observers;
+    // widget id -> widget, for every widget attached to the tree
+    QHash<uint, WidgetData*> m_widgetIds;
+
+    // Batched notifications
+    int m_batchDepth;
+    QVector<QPair<uint, int>> m_batchChanges;
+    QSet<QPair<uint, int>> m_batchSeen;
 
     // QTimer* m_timer;
     // QTime m_lastShot;
@@ -189,19 +305,42 @@ private:
     WidgetData* m_root;
     // QObject owned
     QUndoStack* m_commander;
+
+    // ref
+    SkinRepository* m_repository;
+    // Parent size of screens, the repository output is used while invalid
+    QSize m_outputSize;
+
+    // Detached top level items of the running bulk load
+    bool m_bulkLoading;
+    QVector<WidgetData*> m_bulkItems;
 };
 
 class WidgetObserverRegistrator
 {
     Q_DISABLE_COPY(WidgetObserverRegistrator)
 public:
-    WidgetObserverRegistrator(ScreensModel* model, const QModelIndex& index);
-    void setIndex(const QModelIndex& index);
+    WidgetObserverRegistrator(ScreensModel* model, uint id);
+    void setId(uint id);
     ~WidgetObserverRegistrator();
 
 private:
     ScreensModel* m_model;
-    QPersistentModelIndex m_index;
+    uint m_id;
+};
+
+/**
+ * @brief RAII helper to batch widget change notifications
+ */
+class WidgetChangesBatch
+{
+    Q_DISABLE_COPY(WidgetChangesBatch)
+public:
+    explicit WidgetChangesBatch(ScreensModel* model);
+    ~WidgetChangesBatch();
+
+private:
+    ScreensModel* m_model;
 };
 
 class RemoveRowsCommand : public QUndoCommand
@@ -242,3 +381,18 @@ private:
     // Holds ownership of items until they are passed to the model
     QVector<WidgetData*> m_items;
 };
+
+class MoveRowsCommand : public QUndoCommand
+{
+public:
+    MoveRowsCommand(WidgetData& root, int from, int to, QUndoCommand* parent = nullptr);
+    int id() const final { return getCommandId<decltype(this)>(); }
+    void redo() final;
+    void undo() final;
+
+private:
+    // Reference to the parent element
+    WidgetData& m_root;
+    int m_from;
+    int m_to;
+};
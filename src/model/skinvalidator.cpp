@@ -0,0 +1,533 @@
+#include "skinvalidator.hpp"
+#include "model/colorsmodel.hpp"
+#include "model/fontsmodel.hpp"
+#include "model/screensmodel.hpp"
+#include "repository/skinrepository.hpp"
+#include "base/trace.hpp"
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Delay to collect a burst of changes, e.g. while dragging
+const int validationDelay = 100;
+
+const int pixmapKeys[] = {
+    Property::pixmap,           Property::selectionPixmap, Property::sliderPixmap,
+    Property::backgroundPixmap, Property::pointer,         Property::seek_pointer,
+};
+
+const int colorKeys[] = {
+    Property::borderColor,     Property::shadowColor,
+    Property::backgroundColor, Property::backgroundColorSelected,
+    Property::foregroundColor, Property::foregroundColorSelected,
+};
+
+QString keyName(int key)
+{
+    return QString::fromLatin1(Property::propertyEnum().valueToKey(key));
+}
+
+QString displayName(const WidgetData& widget)
+{
+    return widget.name().isEmpty() ? widget.typeStr() : widget.name();
+}
+
+void appendTree(const WidgetData& widget, QVector<ValidationInput::Widget>& widgets)
+{
+    widgets.append(ValidationInput::fromWidget(widget));
+    for (int i = 0; i < widget.childCount(); ++i) {
+        appendTree(*widget.child(i), widgets);
+    }
+}
+
+} // namespace
+
+QString Diagnostic::severityName(Severity severity)
+{
+    switch (severity) {
+    case Info:
+        return QObject::tr("info");
+    case Warning:
+        return QObject::tr("warning");
+    case Error:
+        return QObject::tr("error");
+    }
+    return QString();
+}
+
+ValidationInput::Widget ValidationInput::fromWidget(const WidgetData& widget)
+{
+    Widget entry;
+    entry.id = widget.id();
+    entry.isPanel = widget.type() == WidgetData::WidgetType::Panel;
+    entry.name = widget.name();
+
+    // Walk up to the screen, positions are relative to the parent
+    QPoint pos = widget.absolutePosition();
+    QStringList path;
+    const WidgetData* screen = &widget;
+    while (screen->parent() && screen->parent()->isChild()) {
+        path.prepend(displayName(*screen));
+        screen = screen->parent()->self();
+        pos += screen->absolutePosition();
+    }
+    entry.screen = screen->name();
+    entry.path = path.join('/');
+    entry.rect = QRect(pos, widget.selfSize());
+
+    for (int key : pixmapKeys) {
+        QString value = widget.pixmap(key);
+        if (key == Property::pointer || key == Property::seek_pointer) {
+            // "file:x,y"
+            value = value.section(':', 0, 0);
+        }
+        if (!value.isEmpty()) {
+            entry.pixmaps.append({ key, value });
+        }
+    }
+    for (int key : colorKeys) {
+        const ColorAttr color = widget.color(key);
+        if (color.state() == ColorAttr::State::Named) {
+            entry.colors.append({ key, color.name() });
+        }
+    }
+    entry.font = widget.font().name();
+    entry.otherAttributes = widget.otherAttributes();
+    return entry;
+}
+
+SkinValidator::SkinValidator(ScreensModel* model, QObject* parent)
+    : QAbstractTableModel(parent)
+    , m_model(model)
+    , m_full(true)
+    , m_resultPending(false)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(validationDelay);
+    connect(&m_timer, &QTimer::timeout, this, &SkinValidator::startNext);
+    connect(&m_watcher,
+            &QFutureWatcher<ValidationResult>::finished,
+            this,
+            &SkinValidator::onValidationFinished);
+
+    connect(m_model, &ScreensModel::widgetChanged, this, &SkinValidator::onWidgetChanged);
+    connect(m_model, &ScreensModel::widgetsChanged, this, &SkinValidator::onWidgetsChanged);
+    connect(m_model, &ScreensModel::rowsInserted, this, &SkinValidator::onRowsInserted);
+    connect(m_model,
+            &ScreensModel::rowsAboutToBeRemoved,
+            this,
+            &SkinValidator::onRowsAboutToBeRemoved);
+    // Moves are rare, check everything again
+    connect(m_model, &ScreensModel::rowsMoved, this, &SkinValidator::validateAll);
+    connect(m_model, &ScreensModel::modelReset, this, &SkinValidator::validateAll);
+
+    connect(&m_model->colors(),
+            &ColorsModel::valueChanged,
+            this,
+            [this](const QString& name) { markUsers("color:" + name); });
+    connect(&m_model->fonts(), &FontsModel::valueChanged, this, [this](const QString& name) {
+        markUsers("font:" + name);
+    });
+
+    schedule();
+}
+
+SkinValidator::~SkinValidator()
+{
+    m_watcher.waitForFinished();
+}
+
+void SkinValidator::setOutputRect(const QRect& rect)
+{
+    if (rect == m_output)
+        return;
+    m_output = rect;
+    validateAll();
+}
+
+void SkinValidator::validateAll()
+{
+    m_full = true;
+    schedule();
+}
+
+void SkinValidator::validateNow()
+{
+    m_timer.stop();
+    m_watcher.waitForFinished();
+    if (m_resultPending) {
+        m_resultPending = false;
+        applyResult(m_watcher.result());
+    }
+    if (m_full || !m_dirty.isEmpty()) {
+        applyResult(validate(takeInput()));
+    }
+    emit finished();
+}
+
+bool SkinValidator::isBusy() const
+{
+    return m_resultPending || m_full || !m_dirty.isEmpty();
+}
+
+ValidationResult SkinValidator::validate(const ValidationInput& input)
+{
+    TraceZone zone("validator", "SkinValidator::validate");
+    if (zone.isActive()) {
+        zone.setDetail(QString::number(input.widgets.size()));
+    }
+
+    ValidationResult result;
+    result.checked.reserve(input.widgets.size());
+    // The repository does not cache missing files
+    QHash<QString, bool> found;
+
+    for (const auto& w : input.widgets) {
+        result.checked.append(w.id);
+        auto report = [&](Diagnostic::Severity severity, const QString& message) {
+            Diagnostic diagnostic;
+            diagnostic.severity = severity;
+            diagnostic.widgetId = w.id;
+            diagnostic.screen = w.screen;
+            diagnostic.widget = w.path;
+            diagnostic.message = message;
+            result.diagnostics.append(diagnostic);
+        };
+
+        for (const auto& pixmap : w.pixmaps) {
+            if (!input.repository)
+                break;
+            auto it = found.constFind(pixmap.second);
+            if (it == found.cend()) {
+                it = found.insert(pixmap.second,
+                                  !input.repository->resolveFilename(pixmap.second).isEmpty());
+            }
+            if (!*it) {
+                report(Diagnostic::Error,
+                       QObject::tr("%1 not found: %2").arg(keyName(pixmap.first), pixmap.second));
+            }
+        }
+        for (const auto& color : w.colors) {
+            if (!input.colors.contains(color.second)) {
+                report(Diagnostic::Error,
+                       QObject::tr("%1 refers to undefined color %2")
+                         .arg(keyName(color.first), color.second));
+            }
+        }
+        if (!w.font.isEmpty() && !input.fonts.contains(w.font)) {
+            report(Diagnostic::Error, QObject::tr("undefined font %1").arg(w.font));
+        }
+        if (w.isPanel && !input.screens.contains(w.name)) {
+            report(Diagnostic::Error, QObject::tr("panel refers to missing screen %1").arg(w.name));
+        }
+        for (const auto& attr : w.otherAttributes) {
+            report(Diagnostic::Info, QObject::tr("unknown attribute %1").arg(attr));
+        }
+        if (!input.output.isNull() && !w.rect.isEmpty() && !input.output.contains(w.rect)) {
+            report(Diagnostic::Warning,
+                   QObject::tr("outside of the %1x%2 output")
+                     .arg(input.output.width())
+                     .arg(input.output.height()));
+        }
+    }
+    return result;
+}
+
+QVariant SkinValidator::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case ColumnSeverity:
+        return tr("Severity");
+    case ColumnWidget:
+        return tr("Widget");
+    case ColumnMessage:
+        return tr("Message");
+    default:
+        return QVariant();
+    }
+}
+
+int SkinValidator::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int SkinValidator::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnsCount;
+}
+
+QVariant SkinValidator::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size())
+        return QVariant();
+
+    const Diagnostic& d = m_rows[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case ColumnSeverity:
+            return Diagnostic::severityName(d.severity);
+        case ColumnWidget:
+            return d.widget.isEmpty() ? d.screen : d.screen + '/' + d.widget;
+        case ColumnMessage:
+            return d.message;
+        default:
+            return QVariant();
+        }
+    case Qt::ToolTipRole:
+        return d.message;
+    case WidgetIdRole:
+        return d.widgetId;
+    case SeverityRole:
+        return d.severity;
+    default:
+        return QVariant();
+    }
+}
+
+void SkinValidator::onWidgetChanged(uint id, int key)
+{
+    const WidgetData* w = m_model->widgetById(id);
+    if (!w)
+        return;
+
+    switch (key) {
+    case Property::position:
+    case Property::size:
+        // Children move along
+        markTree(*w);
+        break;
+    case Property::name:
+        // Children show the name in their path
+        markTree(*w);
+        if (w->type() == WidgetData::WidgetType::Screen) {
+            // Panels may now find their screen, or lose it
+            for (auto it = m_users.cbegin(); it != m_users.cend(); ++it) {
+                if (it.key().startsWith("screen:")) {
+                    markUsers(it.key());
+                }
+            }
+        }
+        break;
+    default:
+        markDirty(id);
+        break;
+    }
+}
+
+void SkinValidator::onWidgetsChanged(const QVector<QPair<uint, int>>& changes)
+{
+    for (const auto& change : changes) {
+        onWidgetChanged(change.first, change.second);
+    }
+}
+
+void SkinValidator::onRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    for (int i = first; i <= last; ++i) {
+        const QModelIndex index = m_model->index(i, ScreensModel::ColumnElement, parent);
+        const WidgetData& w = m_model->widget(index);
+        markTree(w);
+        if (w.type() == WidgetData::WidgetType::Screen) {
+            markUsers("screen:" + w.name());
+        }
+    }
+}
+
+void SkinValidator::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    QStringList screens;
+    for (int i = first; i <= last; ++i) {
+        const QModelIndex index = m_model->index(i, ScreensModel::ColumnElement, parent);
+        const WidgetData& w = m_model->widget(index);
+        forgetTree(w);
+        if (w.type() == WidgetData::WidgetType::Screen) {
+            screens.append(w.name());
+        }
+    }
+    for (const auto& name : qAsConst(screens)) {
+        markUsers("screen:" + name);
+    }
+    // Rows of the removed widgets go away now
+    applyResult(ValidationResult());
+}
+
+void SkinValidator::onValidationFinished()
+{
+    // Already taken by validateNow()
+    if (!m_resultPending)
+        return;
+    m_resultPending = false;
+    applyResult(m_watcher.result());
+    if (m_full || !m_dirty.isEmpty()) {
+        schedule();
+    } else {
+        emit finished();
+    }
+}
+
+void SkinValidator::startNext()
+{
+    if (m_resultPending || !(m_full || !m_dirty.isEmpty()))
+        return;
+    const ValidationInput input = takeInput();
+    m_resultPending = true;
+    m_watcher.setFuture(QtConcurrent::run([input] { return validate(input); }));
+}
+
+void SkinValidator::markDirty(uint id)
+{
+    m_dirty.insert(id);
+    schedule();
+}
+
+void SkinValidator::markTree(const WidgetData& widget)
+{
+    m_dirty.insert(widget.id());
+    for (int i = 0; i < widget.childCount(); ++i) {
+        markTree(*widget.child(i));
+    }
+    schedule();
+}
+
+void SkinValidator::markUsers(const QString& resource)
+{
+    const auto users = m_users.value(resource);
+    if (users.isEmpty())
+        return;
+    m_dirty.unite(users);
+    schedule();
+}
+
+void SkinValidator::forgetTree(const WidgetData& widget)
+{
+    const uint id = widget.id();
+    m_dirty.remove(id);
+    m_diagnostics.remove(id);
+    forgetUses(id);
+    for (int i = 0; i < widget.childCount(); ++i) {
+        forgetTree(*widget.child(i));
+    }
+}
+
+void SkinValidator::updateUses(const ValidationInput::Widget& widget)
+{
+    forgetUses(widget.id);
+    QStringList uses;
+    for (const auto& color : widget.colors) {
+        uses.append("color:" + color.second);
+    }
+    if (!widget.font.isEmpty()) {
+        uses.append("font:" + widget.font);
+    }
+    if (widget.isPanel) {
+        uses.append("screen:" + widget.name);
+    }
+    for (const auto& resource : qAsConst(uses)) {
+        m_users[resource].insert(widget.id);
+    }
+    if (!uses.isEmpty()) {
+        m_uses.insert(widget.id, uses);
+    }
+}
+
+void SkinValidator::forgetUses(uint id)
+{
+    const QStringList uses = m_uses.take(id);
+    for (const auto& resource : uses) {
+        auto it = m_users.find(resource);
+        if (it != m_users.end()) {
+            it->remove(id);
+            if (it->isEmpty()) {
+                m_users.erase(it);
+            }
+        }
+    }
+}
+
+void SkinValidator::schedule()
+{
+    // A running check schedules the next one when it finishes
+    if (!m_timer.isActive() && !m_resultPending) {
+        m_timer.start();
+    }
+}
+
+ValidationInput SkinValidator::takeInput()
+{
+    TRACE_ZONE("validator", "SkinValidator::takeInput");
+    ValidationInput input;
+    input.output = m_output;
+    // The singleton must not be created by the worker
+    input.repository = &m_model->repository();
+    for (const auto& color : m_model->colors()) {
+        input.colors.insert(color.name());
+    }
+    for (const auto& font : m_model->fonts()) {
+        input.fonts.insert(font.name());
+    }
+    const QModelIndex root;
+    for (int i = 0; i < m_model->rowCount(root); ++i) {
+        const WidgetData& screen = m_model->widget(m_model->index(i, 0, root));
+        input.screens.insert(screen.name());
+        if (m_full) {
+            screen.updateLayout();
+            appendTree(screen, input.widgets);
+        }
+    }
+    if (!m_full) {
+        input.widgets.reserve(m_dirty.size());
+        for (uint id : qAsConst(m_dirty)) {
+            if (const WidgetData* w = m_model->widgetById(id)) {
+                input.widgets.append(ValidationInput::fromWidget(*w));
+            }
+        }
+    }
+    m_full = false;
+    m_dirty.clear();
+
+    for (const auto& w : qAsConst(input.widgets)) {
+        updateUses(w);
+    }
+    return input;
+}
+
+void SkinValidator::applyResult(const ValidationResult& result)
+{
+    for (uint id : result.checked) {
+        m_diagnostics.remove(id);
+    }
+    for (const auto& d : result.diagnostics) {
+        // Removed while the worker was busy
+        if (m_model->widgetById(d.widgetId)) {
+            m_diagnostics[d.widgetId].append(d);
+        }
+    }
+    // A reset removes widgets without notifications
+    for (auto it = m_diagnostics.begin(); it != m_diagnostics.end();) {
+        if (m_model->widgetById(it.key())) {
+            ++it;
+        } else {
+            it = m_diagnostics.erase(it);
+        }
+    }
+
+    beginResetModel();
+    m_rows.clear();
+    for (const auto& list : qAsConst(m_diagnostics)) {
+        m_rows += list;
+    }
+    std::sort(m_rows.begin(), m_rows.end(), [](const Diagnostic& a, const Diagnostic& b) {
+        if (a.severity != b.severity)
+            return a.severity > b.severity;
+        if (a.screen != b.screen)
+            return a.screen < b.screen;
+        return a.widget < b.widget;
+    });
+    endResetModel();
+}
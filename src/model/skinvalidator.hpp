@@ -0,0 +1,167 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QRect>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+class ScreensModel;
+class SkinRepository;
+class WidgetData;
+
+/**
+ * @brief problem found in a skin, refers to the widget by its stable id
+ */
+struct Diagnostic
+{
+    enum Severity
+    {
+        Info,
+        Warning,
+        Error,
+    };
+
+    Severity severity = Warning;
+    uint widgetId = 0;
+    // Screen name and path of the widget inside it
+    QString screen;
+    QString widget;
+    QString message;
+
+    static QString severityName(Severity severity);
+};
+
+/**
+ * @brief immutable copy of the widgets to check, taken in the GUI thread
+ */
+struct ValidationInput
+{
+    struct Widget
+    {
+        uint id = 0;
+        QString screen;
+        QString path;
+        bool isPanel = false;
+        QString name;
+        // In output coordinates
+        QRect rect;
+        // (key, value) pairs
+        QVector<QPair<int, QString>> pixmaps;
+        QVector<QPair<int, QString>> colors;
+        QString font;
+        QStringList otherAttributes;
+    };
+
+    QVector<Widget> widgets;
+    QSet<QString> colors;
+    QSet<QString> fonts;
+    QSet<QString> screens;
+    // Null rect skips the check
+    QRect output;
+    // Resolves pixmap names, null skips the check
+    const SkinRepository* repository = nullptr;
+
+    static Widget fromWidget(const WidgetData& widget);
+};
+
+struct ValidationResult
+{
+    QVector<uint> checked;
+    QVector<Diagnostic> diagnostics;
+};
+
+/**
+ * @brief checks references and geometry of the skin in a worker thread
+ * The first pass covers all widgets, after that only widgets touched by
+ * change notifications and users of changed colors, fonts and screens
+ * are checked again. Exposes the diagnostics as a table.
+ */
+class SkinValidator : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum
+    {
+        ColumnSeverity,
+        ColumnWidget,
+        ColumnMessage,
+        ColumnsCount,
+    };
+
+    enum Roles
+    {
+        WidgetIdRole = Qt::UserRole + 1,
+        SeverityRole,
+    };
+
+    explicit SkinValidator(ScreensModel* model, QObject* parent = nullptr);
+    ~SkinValidator() override;
+
+    // Widgets outside the rect are reported, null rect disables the check
+    void setOutputRect(const QRect& rect);
+    // Schedule a full pass
+    void validateAll();
+    // Check the queued widgets without a worker thread
+    void validateNow();
+    bool isBusy() const;
+
+    QVector<Diagnostic> diagnostics() const { return m_rows; }
+    QVector<Diagnostic> diagnostics(uint widgetId) const { return m_diagnostics.value(widgetId); }
+
+    // Runs the checks, thread safe
+    static ValidationResult validate(const ValidationInput& input);
+
+    // QAbstractItemModel interface
+    QVariant headerData(int section,
+                        Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+signals:
+    // All queued widgets have been checked
+    void finished();
+
+private slots:
+    void onWidgetChanged(uint id, int key);
+    void onWidgetsChanged(const QVector<QPair<uint, int>>& changes);
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void onValidationFinished();
+    void startNext();
+
+private:
+    void markDirty(uint id);
+    void markTree(const WidgetData& widget);
+    void markUsers(const QString& resource);
+    void forgetTree(const WidgetData& widget);
+    void updateUses(const ValidationInput::Widget& widget);
+    void forgetUses(uint id);
+    void schedule();
+    ValidationInput takeInput();
+    void applyResult(const ValidationResult& result);
+
+    ScreensModel* m_model;
+    QRect m_output;
+
+    QHash<uint, QVector<Diagnostic>> m_diagnostics;
+    QVector<Diagnostic> m_rows;
+
+    // Widgets to check on the next run
+    QSet<uint> m_dirty;
+    bool m_full;
+    // A worker runs or its result is not applied yet
+    bool m_resultPending;
+    // Widgets by referenced resource, "color:name", "font:name" or "screen:name"
+    QHash<QString, QSet<uint>> m_users;
+    QHash<uint, QStringList> m_uses;
+
+    // Coalesces bursts of notifications into one run
+    QTimer m_timer;
+    QFutureWatcher<ValidationResult> m_watcher;
+};
@@ -0,0 +1,536 @@
+#include "thumbnailsmodel.hpp"
+#include "model/screensmodel.hpp"
+#include "repository/skinrepository.hpp"
+#include "base/trace.hpp"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPainter>
+#include <QPainterPath>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Bump when painting changes to drop old thumbnails from the disk cache
+const quint32 thumbnailFormatVersion = 1;
+// Disk cache limits, older entries are removed first
+const int maxCachedThumbnails = 2000;
+const int maxThumbnailAgeDays = 30;
+
+void appendItems(const WidgetData& parent, QPoint offset, QVector<ScreenSnapshot::Item>& items)
+{
+    QVector<const WidgetData*> children;
+    for (int i = 0; i < parent.childCount(); ++i) {
+        children.append(parent.child(i));
+    }
+    std::stable_sort(children.begin(), children.end(), [](const auto* a, const auto* b) {
+        return a->zPosition() < b->zPosition();
+    });
+
+    for (const auto* w : qAsConst(children)) {
+        ScreenSnapshot::Item item;
+        item.render = w->sceneRender();
+        item.rect = QRect(offset + w->absolutePosition(), w->selfSize());
+        item.transparent = w->transparent();
+        item.background = w->getQColor(Property::backgroundColor);
+        item.foreground = w->getQColor(Property::foregroundColor);
+        item.border = w->getQColor(Property::borderColor);
+        item.borderWidth = w->borderWidth();
+        item.text = w->text().isNull() ? w->scenePreview().toString() : w->text();
+        item.font = w->font().getFont();
+        item.alignment = int(w->halign()) | int(w->valign());
+        item.pixmap = SkinRepository::current().resolveFilename(w->pixmap(Property::pixmap));
+        item.scale = w->scale();
+        item.percent = qBound(0, w->scenePreview().toInt(), 100);
+        item.vertical = w->orientation() != Property::orHorizontal;
+        items.append(item);
+        appendItems(*w, item.rect.topLeft(), items);
+    }
+}
+
+void paintItem(QPainter& painter, const ScreenSnapshot::Item& item, QHash<QString, QImage>& images)
+{
+    switch (item.render) {
+    case Property::Screen:
+        if (!item.transparent)
+            painter.fillRect(item.rect, item.background);
+        break;
+    case Property::Label:
+    case Property::FixedLabel:
+        if (!item.transparent)
+            painter.fillRect(item.rect, item.background);
+        painter.setPen(item.foreground);
+        painter.setFont(item.font);
+        painter.drawText(item.rect, item.alignment | Qt::TextWordWrap, item.text);
+        break;
+    case Property::Pixmap:
+    case Property::Picon: {
+        if (item.pixmap.isEmpty())
+            break;
+        auto it = images.find(item.pixmap);
+        if (it == images.end()) {
+            it = images.insert(item.pixmap, QImage(item.pixmap));
+        }
+        const QImage& image = *it;
+        QRect source(QPoint(0, 0), item.scale ? image.size() : item.rect.size());
+        painter.drawImage(item.rect, image, source);
+        break;
+    }
+    case Property::Slider: {
+        QRect r = item.rect;
+        if (item.vertical) {
+            r.setHeight(r.height() * item.percent / 100);
+        } else {
+            r.setWidth(r.width() * item.percent / 100);
+        }
+        if (!item.transparent)
+            painter.fillRect(item.rect, item.background);
+        painter.fillRect(r, item.foreground);
+        break;
+    }
+    default:
+        break;
+    }
+
+    const int bw = item.borderWidth;
+    if (bw > 0 && bw <= item.rect.width() && bw <= item.rect.height()) {
+        QPainterPath outer, inner;
+        outer.addRect(item.rect);
+        inner.addRect(item.rect.adjusted(bw, bw, -bw, -bw));
+        painter.fillPath(outer.subtracted(inner), item.border);
+    }
+}
+
+QImage loadOrRender(const ScreenSnapshot& snapshot, const QSize& size, const QString& cacheDir)
+{
+    TRACE_ZONE("thumbnails", "loadOrRender");
+    QString path;
+    if (!cacheDir.isEmpty()) {
+        path = QDir(cacheDir).filePath(snapshot.hash(size) + ".png");
+        QImage cached(path);
+        if (!cached.isNull()) {
+            // Keep used entries away from pruning
+            QFile file(path);
+            if (file.open(QIODevice::Append)) {
+                file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+            }
+            return cached;
+        }
+    }
+    QImage image = snapshot.render(size);
+    if (!path.isEmpty() && QDir().mkpath(cacheDir)) {
+        image.save(path, "PNG");
+    }
+    return image;
+}
+
+void pruneCache(const QString& cacheDir)
+{
+    TRACE_ZONE("thumbnails", "pruneCache");
+    const QDateTime oldest = QDateTime::currentDateTime().addDays(-maxThumbnailAgeDays);
+    const auto entries =
+      QDir(cacheDir).entryInfoList({ "*.png" }, QDir::Files, QDir::Time); // newest first
+    for (int i = 0; i < entries.size(); ++i) {
+        if (i >= maxCachedThumbnails || entries[i].lastModified() < oldest) {
+            QFile::remove(entries[i].filePath());
+        }
+    }
+}
+
+} // namespace
+
+// ScreenSnapshot
+
+ScreenSnapshot ScreenSnapshot::fromScreen(const WidgetData& screen)
+{
+    ScreenSnapshot snapshot;
+    snapshot.screenId = screen.id();
+    screen.updateLayout();
+    snapshot.size = screen.selfSize();
+
+    Item self;
+    self.render = Property::Screen;
+    self.rect = QRect(QPoint(0, 0), snapshot.size);
+    self.transparent = screen.transparent();
+    self.background = screen.getQColor(Property::backgroundColor);
+    self.border = screen.getQColor(Property::borderColor);
+    self.borderWidth = screen.borderWidth();
+    snapshot.items.append(self);
+    appendItems(screen, QPoint(0, 0), snapshot.items);
+    return snapshot;
+}
+
+QByteArray ScreenSnapshot::hash(const QSize& thumbnailSize) const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << thumbnailFormatVersion << thumbnailSize << size;
+    for (const auto& item : items) {
+        stream << qint32(item.render) << item.rect << item.transparent << item.background
+               << item.foreground << item.border << qint32(item.borderWidth) << item.text
+               << item.font.toString() << qint32(item.alignment) << item.scale
+               << qint32(item.percent) << item.vertical << item.pixmap;
+        // Edited image files must not reuse the old thumbnail
+        if (!item.pixmap.isEmpty()) {
+            QFileInfo info(item.pixmap);
+            stream << info.size() << info.lastModified();
+        }
+    }
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+QImage ScreenSnapshot::render(const QSize& thumbnailSize) const
+{
+    TRACE_ZONE("thumbnails", "ScreenSnapshot::render");
+    QImage image(thumbnailSize, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    if (size.isEmpty())
+        return image;
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    const qreal scale = qMin(qreal(thumbnailSize.width()) / size.width(),
+                             qreal(thumbnailSize.height()) / size.height());
+    painter.translate((thumbnailSize.width() - size.width() * scale) / 2,
+                      (thumbnailSize.height() - size.height() * scale) / 2);
+    painter.scale(scale, scale);
+    painter.setClipRect(QRect(QPoint(0, 0), size));
+
+    QHash<QString, QImage> images;
+    for (const auto& item : items) {
+        paintItem(painter, item, images);
+    }
+    return image;
+}
+
+// ThumbnailsModel
+
+ThumbnailsModel::ThumbnailsModel(ScreensModel* model, QObject* parent)
+    : QAbstractProxyModel(parent)
+    , m_model(model)
+    , m_thumbnailSize(160, 90)
+    , m_rebuilding(false)
+    , m_renderingId(UniqueId::invalid)
+    , m_renderingGeneration(0)
+{
+    setSourceModel(model);
+    setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                      + "/thumbnails");
+    beginRebuild(QModelIndex());
+    endRebuild();
+
+    connect(&m_watcher,
+            &QFutureWatcher<QImage>::finished,
+            this,
+            &ThumbnailsModel::onRenderFinished);
+
+    connect(model, &ScreensModel::widgetChanged, this, [this](uint id, int key) {
+        Q_UNUSED(key);
+        invalidate(screenOfWidget(id));
+    });
+    connect(model,
+            &ScreensModel::widgetsChanged,
+            this,
+            [this](const QVector<QPair<uint, int>>& changes) {
+                QSet<uint> screens;
+                for (const auto& change : changes) {
+                    screens.insert(screenOfWidget(change.first));
+                }
+                for (uint id : qAsConst(screens)) {
+                    invalidate(id);
+                }
+            });
+    connect(model,
+            &QAbstractItemModel::dataChanged,
+            this,
+            [this](const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+                for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+                    QModelIndex index = mapFromSource(topLeft.sibling(row, 0));
+                    if (index.isValid()) {
+                        emit dataChanged(index, index, { Qt::DisplayRole, Qt::ToolTipRole });
+                    }
+                }
+            });
+
+    // Screens are listed again when top level or include rows change
+    auto onRowsAboutToChange = [this](const QModelIndex& parent) { beginRebuild(parent); };
+    auto onRowsChanged = [this](const QModelIndex& parent) {
+        endRebuild();
+        invalidate(screenOfIndex(parent));
+    };
+    connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, onRowsAboutToChange);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, onRowsAboutToChange);
+    connect(model, &QAbstractItemModel::rowsInserted, this, onRowsChanged);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, onRowsChanged);
+    connect(model,
+            &QAbstractItemModel::rowsAboutToBeMoved,
+            this,
+            [this](const QModelIndex& parent, int, int, const QModelIndex& destination) {
+                beginRebuild(parent);
+                beginRebuild(destination);
+            });
+    connect(model,
+            &QAbstractItemModel::rowsMoved,
+            this,
+            [this](const QModelIndex& parent, int, int, const QModelIndex& destination) {
+                endRebuild();
+                invalidate(screenOfIndex(parent));
+                invalidate(screenOfIndex(destination));
+            });
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this] {
+        beginRebuild(QModelIndex());
+    });
+    connect(model, &QAbstractItemModel::modelReset, this, [this] {
+        endRebuild();
+        invalidateAll();
+    });
+}
+
+ThumbnailsModel::~ThumbnailsModel()
+{
+    m_watcher.waitForFinished();
+}
+
+QModelIndex ThumbnailsModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || proxyIndex.row() >= m_screens.size())
+        return QModelIndex();
+    return m_model->indexFromId(m_screens[proxyIndex.row()]);
+}
+
+QModelIndex ThumbnailsModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.column() != 0)
+        return QModelIndex();
+    auto it = m_rows.constFind(m_model->idFromIndex(sourceIndex));
+    if (it == m_rows.cend())
+        return QModelIndex();
+    return createIndex(*it, 0);
+}
+
+QModelIndex ThumbnailsModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || column != 0 || row < 0 || row >= m_screens.size())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex ThumbnailsModel::parent(const QModelIndex& child) const
+{
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+QVariant ThumbnailsModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    const QModelIndex source = mapToSource(index);
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return source.sibling(source.row(), ScreensModel::ColumnName).data();
+    case Qt::DecorationRole: {
+        uint id = m_model->idFromIndex(source);
+        const WidgetData* screen = m_model->widgetById(id);
+        if (!screen || screen->type() != WidgetData::WidgetType::Screen)
+            return QVariant();
+
+        // Only thumbnails the view asks for are rendered
+        auto it = m_thumbnails.constFind(id);
+        if (it == m_thumbnails.cend() || it->generation != generation(id)) {
+            const_cast<ThumbnailsModel*>(this)->request(id);
+        }
+        if (it != m_thumbnails.cend())
+            return it->image; // possibly outdated until the new one is ready
+
+        QImage placeholder(m_thumbnailSize, QImage::Format_ARGB32_Premultiplied);
+        placeholder.fill(Qt::darkGray);
+        return placeholder;
+    }
+    default:
+        return QAbstractProxyModel::data(index, role);
+    }
+}
+
+Qt::ItemFlags ThumbnailsModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+int ThumbnailsModel::columnCount(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return 1;
+}
+
+int ThumbnailsModel::rowCount(const QModelIndex& parent) const
+{
+    // Flat list of screens
+    if (parent.isValid())
+        return 0;
+    return m_screens.size();
+}
+
+void ThumbnailsModel::setThumbnailSize(const QSize& size)
+{
+    if (size == m_thumbnailSize)
+        return;
+    m_thumbnailSize = size;
+    invalidateAll();
+}
+
+void ThumbnailsModel::setCacheDirectory(const QString& path)
+{
+    m_cacheDir = path;
+    if (!m_cacheDir.isEmpty()) {
+        pruneCache(m_cacheDir);
+    }
+}
+
+void ThumbnailsModel::onRenderFinished()
+{
+    uint id = m_renderingId;
+    m_renderingId = UniqueId::invalid;
+
+    QModelIndex index = mapFromSource(m_model->indexFromId(id));
+    if (index.isValid()) {
+        m_thumbnails[id] = Thumbnail{ m_renderingGeneration, m_watcher.result() };
+        emit dataChanged(index, index, { Qt::DecorationRole });
+    }
+    startNext();
+}
+
+bool ThumbnailsModel::listsChildrenOf(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+        return true;
+    // Children of a top level include file
+    if (parent.parent().isValid())
+        return false;
+    const WidgetData* w = m_model->widgetById(m_model->idFromIndex(parent));
+    return w && w->type() != WidgetData::WidgetType::Screen;
+}
+
+void ThumbnailsModel::beginRebuild(const QModelIndex& parent)
+{
+    if (m_rebuilding || !listsChildrenOf(parent))
+        return;
+    m_rebuilding = true;
+    beginResetModel();
+}
+
+void ThumbnailsModel::endRebuild()
+{
+    if (!m_rebuilding)
+        return;
+
+    m_screens.clear();
+    m_rows.clear();
+    for (int row = 0; row < m_model->rowCount(); ++row) {
+        const QModelIndex top = m_model->index(row, 0);
+        if (listsChildrenOf(top)) {
+            for (int i = 0; i < m_model->rowCount(top); ++i) {
+                m_screens.append(m_model->idFromIndex(m_model->index(i, 0, top)));
+            }
+        } else {
+            m_screens.append(m_model->idFromIndex(top));
+        }
+    }
+    for (int i = 0; i < m_screens.size(); ++i) {
+        m_rows.insert(m_screens[i], i);
+    }
+
+    // Forget screens which are gone
+    for (auto it = m_generations.begin(); it != m_generations.end();) {
+        if (m_rows.contains(it.key())) {
+            ++it;
+        } else {
+            m_thumbnails.remove(it.key());
+            m_queue.removeAll(it.key());
+            it = m_generations.erase(it);
+        }
+    }
+
+    m_rebuilding = false;
+    endResetModel();
+}
+
+uint ThumbnailsModel::screenOfWidget(uint id) const
+{
+    const WidgetData* w = m_model->widgetById(id);
+    while (w && w->type() != WidgetData::WidgetType::Screen) {
+        w = w->parent() && w->parent()->isChild() ? w->parent()->self() : nullptr;
+    }
+    return w ? w->id() : UniqueId::invalid;
+}
+
+uint ThumbnailsModel::screenOfIndex(const QModelIndex& index) const
+{
+    return index.isValid() ? screenOfWidget(m_model->idFromIndex(index)) : UniqueId::invalid;
+}
+
+void ThumbnailsModel::invalidate(uint screenId)
+{
+    if (screenId == UniqueId::invalid)
+        return;
+    ++m_generations[screenId];
+    QModelIndex index = mapFromSource(m_model->indexFromId(screenId));
+    if (index.isValid()) {
+        emit dataChanged(index, index, { Qt::DecorationRole });
+    }
+}
+
+void ThumbnailsModel::invalidateAll()
+{
+    // A running job finishes for nothing, its screen is invalid now
+    m_queue.clear();
+    m_thumbnails.clear();
+    for (auto it = m_generations.begin(); it != m_generations.end(); ++it) {
+        ++it.value();
+    }
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 0), index(rowCount() - 1, 0), { Qt::DecorationRole });
+    }
+}
+
+void ThumbnailsModel::request(uint screenId)
+{
+    m_queue.removeAll(screenId);
+    m_queue.append(screenId);
+    startNext();
+}
+
+void ThumbnailsModel::startNext()
+{
+    if (m_watcher.isRunning())
+        return;
+
+    while (!m_queue.isEmpty()) {
+        uint id = m_queue.takeLast();
+        const WidgetData* screen = m_model->widgetById(id);
+        if (!screen)
+            continue;
+        auto it = m_thumbnails.constFind(id);
+        if (it != m_thumbnails.cend() && it->generation == generation(id))
+            continue;
+
+        m_renderingId = id;
+        m_renderingGeneration = generation(id);
+        const auto snapshot = ScreenSnapshot::fromScreen(*screen);
+        const QSize size = m_thumbnailSize;
+        const QString dir = m_cacheDir;
+        m_watcher.setFuture(
+          QtConcurrent::run([snapshot, size, dir] { return loadOrRender(snapshot, size, dir); }));
+        return;
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "skin/enums.hpp"
+#include <QColor>
+#include <QFont>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QAbstractProxyModel>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+class ScreensModel;
+class WidgetData;
+
+/**
+ * @brief immutable copy of everything needed to paint a screen
+ * Taken in the GUI thread, painted in a worker thread
+ */
+struct ScreenSnapshot
+{
+    struct Item
+    {
+        Property::Render render = Property::Widget;
+        QRect rect; // relative to the screen
+        bool transparent = false;
+        QColor background;
+        QColor foreground;
+        QColor border;
+        int borderWidth = 0;
+        QString text;
+        QFont font;
+        int alignment = 0;
+        QString pixmap; // resolved file name
+        bool scale = false;
+        int percent = 0;
+        bool vertical = false;
+    };
+
+    uint screenId = 0;
+    QSize size;
+    QVector<Item> items; // in painting order
+
+    static ScreenSnapshot fromScreen(const WidgetData& screen);
+    // Content hash used as the disk cache key
+    QByteArray hash(const QSize& thumbnailSize) const;
+    // Thread safe, pixmaps are loaded as QImage
+    QImage render(const QSize& thumbnailSize) const;
+};
+
+/**
+ * @brief list of screens decorated with thumbnails
+ * Flat list of top level screens and screens of include files.
+ * Thumbnails are rendered one at a time in a worker thread,
+ * the ones requested by the view last are rendered first.
+ * Each screen has a generation counter bumped on any change in its subtree,
+ * only screens with a newer generation than their thumbnail are rendered again.
+ * The disk cache keeps recently used thumbnails only.
+ */
+class ThumbnailsModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailsModel(ScreensModel* model, QObject* parent = nullptr);
+    ~ThumbnailsModel() override;
+
+    // QAbstractProxyModel interface
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+    QModelIndex index(int row,
+                      int column,
+                      const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+    QSize thumbnailSize() const { return m_thumbnailSize; }
+    void setThumbnailSize(const QSize& size);
+    // Thumbnails already rendered for the same content are stored here,
+    // old entries are removed when the directory is set
+    void setCacheDirectory(const QString& path);
+    QString cacheDirectory() const { return m_cacheDir; }
+
+    quint64 generation(uint screenId) const { return m_generations.value(screenId); }
+
+private slots:
+    void onRenderFinished();
+
+private:
+    struct Thumbnail
+    {
+        quint64 generation = 0;
+        QImage image;
+    };
+
+    // Whether rows under @p parent are listed
+    bool listsChildrenOf(const QModelIndex& parent) const;
+    void beginRebuild(const QModelIndex& parent);
+    void endRebuild();
+    uint screenOfWidget(uint id) const;
+    uint screenOfIndex(const QModelIndex& index) const;
+    void invalidate(uint screenId);
+    void invalidateAll();
+    void request(uint screenId);
+    void startNext();
+
+    ScreensModel* m_model;
+    QSize m_thumbnailSize;
+    QString m_cacheDir;
+    // Listed screens and their rows
+    QVector<uint> m_screens;
+    QHash<uint, int> m_rows;
+    bool m_rebuilding;
+    QHash<uint, quint64> m_generations;
+    QHash<uint, Thumbnail> m_thumbnails;
+    // Screens waiting for rendering, the last one goes first
+    QVector<uint> m_queue;
+    QFutureWatcher<QImage> m_watcher;
+    uint m_renderingId;
+    quint64 m_renderingGeneration;
+};
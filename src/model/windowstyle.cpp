@@ -3,6 +3,7 @@
 #include "base/meta.hpp"
 #include <QMetaEnum>
 #include <QColor>
+#include <QDataStream>
 
 // WindowStyleTitle
 
@@ -26,6 +27,19 @@ void WindowStyleTitle::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void WindowStyleTitle::fromStream(QDataStream& stream)
+{
+    QString positionStr, fontStr;
+    stream >> positionStr >> fontStr;
+    position = PositionAttr(positionStr);
+    font = FontAttr(fontStr);
+}
+
+void WindowStyleTitle::toStream(QDataStream& stream) const
+{
+    stream << position.toStr() << font.toStr();
+}
+
 // WindowStyleColor
 
 void WindowStyleColor::fromXml(QXmlStreamReader& xml)
@@ -45,6 +59,20 @@ void WindowStyleColor::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void WindowStyleColor::fromStream(QDataStream& stream)
+{
+    qint32 r;
+    QString colorStr;
+    stream >> r >> colorStr;
+    role = static_cast<ColorRole>(r);
+    color = ColorAttr(colorStr, true);
+}
+
+void WindowStyleColor::toStream(QDataStream& stream) const
+{
+    stream << qint32(role) << color.toXml();
+}
+
 // WindowStyle
 
 WindowStyle::WindowStyle()
@@ -90,6 +118,33 @@ void WindowStyle::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void WindowStyle::fromStream(QDataStream& stream)
+{
+    qint32 id, count;
+    stream >> m_type >> id;
+    m_id = id;
+    m_title.fromStream(stream);
+    stream >> count;
+    m_colors.clear();
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        WindowStyleColor color;
+        color.fromStream(stream);
+        m_colors.append(color);
+    }
+    m_borderSet.fromStream(stream);
+}
+
+void WindowStyle::toStream(QDataStream& stream) const
+{
+    stream << m_type << qint32(m_id);
+    m_title.toStream(stream);
+    stream << qint32(m_colors.size());
+    for (const WindowStyleColor& c : m_colors) {
+        c.toStream(stream);
+    }
+    m_borderSet.toStream(stream);
+}
+
 int WindowStyle::roleCount()
 {
     return QMetaEnum::fromType<WindowStyleColor::ColorRole>().keyCount();
@@ -132,6 +187,26 @@ void WindowStylesList::toXml(QXmlStreamWriter& xml) const
     }
 }
 
+void WindowStylesList::fromStream(QDataStream& stream)
+{
+    clear();
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        WindowStyle style;
+        style.fromStream(stream);
+        appendItem(style);
+    }
+}
+
+void WindowStylesList::toStream(QDataStream& stream) const
+{
+    stream << qint32(itemsCount());
+    for (const WindowStyle& s : *this) {
+        s.toStream(stream);
+    }
+}
+
 void WindowStylesList::emitValueChanged(const QString& name, const WindowStyle& value) const
 {
     emit styleChanged(name, value);
@@ -8,11 +8,15 @@
 #include "model/namedlist.hpp"
 #include <QMetaEnum>
 
+class QDataStream;
+
 class WindowStyleTitle
 {
 public:
     void fromXml(QXmlStreamReader& xml);
     void toXml(QXmlStreamWriter& xml) const;
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
 
     PositionAttr position;
     FontAttr font;
@@ -24,6 +28,8 @@ class WindowStyleColor
 public:
     void fromXml(QXmlStreamReader& xml);
     void toXml(QXmlStreamWriter& xml) const;
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
 
     enum class ColorRole
     {
@@ -61,11 +67,15 @@ public:
 
     void fromXml(QXmlStreamReader& xml);
     void toXml(QXmlStreamWriter& xml) const;
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
     static int roleCount();
 
     ColorAttr getColor(WindowStyleColor::ColorRole role);
     void setColor(WindowStyleColor::ColorRole role, const ColorAttr& color);
     BorderSet borderSet() const { return m_borderSet; }
+    WindowStyleTitle title() const { return m_title; }
+    void setTitle(const WindowStyleTitle& title) { m_title = title; }
 
 private:
     QString m_type;
@@ -82,7 +92,12 @@ public:
     void appendFromXml(QXmlStreamReader& xml);
     // Xml:
     void toXml(QXmlStreamWriter& xml) const;
+    // Binary cache:
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
     inline const WindowStyle getStyle(int id) { return getValue(QString::number(id)); }
+    // Replace the style at @p i, it keeps its name
+    bool setStyle(int i, const WindowStyle& style) { return setItem(i, style); }
     void clear() { removeItems(0, itemsCount()); }
 
 signals:
@@ -0,0 +1,405 @@
+#include "assetoptimizer.hpp"
+#include "repository/skinrepository.hpp"
+#include "repository/skinbatch.hpp"
+#include "base/trace.hpp"
+#include <QBuffer>
+#include <QDebug>
+#include <QDirIterator>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Qt maps PNG quality 0 to the best zlib compression
+const int pngQuality = 0;
+
+QByteArray encode(const QImage& image)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "png");
+    writer.setQuality(pngQuality);
+    if (!writer.write(image)) {
+        return QByteArray();
+    }
+    return data;
+}
+
+// Image in Format_ARGB32
+bool isOpaque(const QImage& image)
+{
+    for (int y = 0; y < image.height(); ++y) {
+        auto* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            if (qAlpha(line[x]) != 255)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Alpha of an image in Format_ARGB32 becomes either 0 or 255
+QImage thresholdAlpha(const QImage& image)
+{
+    QImage result = image.copy();
+    for (int y = 0; y < result.height(); ++y) {
+        auto* line = reinterpret_cast<QRgb*>(result.scanLine(y));
+        for (int x = 0; x < result.width(); ++x) {
+            const QRgb pixel = line[x];
+            line[x] = qAlpha(pixel) < 128 ? qRgba(0, 0, 0, 0) : (pixel | 0xff000000);
+        }
+    }
+    return result;
+}
+
+// Exact palette of an image in Format_ARGB32 or Format_RGB32,
+// null if it has more than 256 colors
+QImage toPalette(const QImage& image)
+{
+    QHash<QRgb, int> indexes;
+    QVector<QRgb> colors;
+    QImage result(image.size(), QImage::Format_Indexed8);
+    for (int y = 0; y < image.height(); ++y) {
+        auto* line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        uchar* indexLine = result.scanLine(y);
+        for (int x = 0; x < image.width(); ++x) {
+            auto it = indexes.constFind(line[x]);
+            if (it == indexes.cend()) {
+                if (colors.size() == 256)
+                    return QImage();
+                it = indexes.insert(line[x], colors.size());
+                colors.append(line[x]);
+            }
+            indexLine[x] = uchar(*it);
+        }
+    }
+    result.setColorTable(colors);
+    return result;
+}
+
+} // namespace
+
+qint64 DeployReport::originalSize() const
+{
+    qint64 size = 0;
+    for (const auto& asset : assets) {
+        size += asset.originalSize;
+    }
+    return size;
+}
+
+qint64 DeployReport::optimizedSize() const
+{
+    qint64 size = 0;
+    for (const auto& asset : assets) {
+        size += asset.optimizedSize;
+    }
+    return size;
+}
+
+AssetOptimizer::AssetOptimizer(bool quantize)
+    : m_quantize(quantize)
+{}
+
+QByteArray AssetOptimizer::optimize(const QImage& source,
+                                    Property::Alphatest alphatest,
+                                    int bpp,
+                                    QString* format) const
+{
+    const QImage converted = source.convertToFormat(QImage::Format_ARGB32);
+    // Wrapping the pixels leaves text chunks and other metadata behind
+    QImage image(converted.constBits(),
+                 converted.width(),
+                 converted.height(),
+                 converted.bytesPerLine(),
+                 QImage::Format_ARGB32);
+
+    // Boxes with 8 bpp show a palette anyway
+    const bool lossy = m_quantize || (bpp > 0 && bpp <= 8);
+    if (lossy && alphatest == Property::off) {
+        // The box draws the pixmap without its alpha channel
+        image = image.convertToFormat(QImage::Format_RGB32);
+    } else if (lossy && alphatest == Property::on) {
+        image = thresholdAlpha(image);
+    }
+    if (image.format() == QImage::Format_ARGB32 && isOpaque(image)) {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+
+    QVector<QPair<QImage, QString>> candidates;
+    candidates.append(qMakePair(image, QString(image.hasAlphaChannel() ? "argb" : "rgb")));
+    QImage palette = toPalette(image);
+    if (!palette.isNull()) {
+        candidates.append(qMakePair(palette, QString("palette")));
+    } else if (lossy && alphatest != Property::blend) {
+        // Alpha is binary here, it fits a palette with a transparent color
+        palette = image.convertToFormat(QImage::Format_Indexed8,
+                                        Qt::DiffuseDither | Qt::ThresholdAlphaDither);
+        candidates.append(qMakePair(palette, QString("quantized")));
+    }
+
+    QByteArray best;
+    for (const auto& candidate : qAsConst(candidates)) {
+        QByteArray data = encode(candidate.first);
+        if (!data.isEmpty() && (best.isEmpty() || data.size() < best.size())) {
+            best = data;
+            if (format) {
+                *format = candidate.second;
+            }
+        }
+    }
+    return best;
+}
+
+QHash<QString, Property::Alphatest> AssetOptimizer::assets(const ScreensModel& screens,
+                                                           const WindowStylesList& styles)
+{
+    static const int pixmapKeys[] = {
+        Property::pixmap,           Property::selectionPixmap, Property::sliderPixmap,
+        Property::backgroundPixmap, Property::pointer,         Property::seek_pointer,
+    };
+
+    QHash<QString, Property::Alphatest> result;
+    auto use = [&](const QString& raw, Property::Alphatest alphatest) {
+        const QString path = screens.repository().resolveFilename(raw);
+        if (path.isEmpty())
+            return;
+        auto it = result.find(path);
+        if (it == result.end()) {
+            result.insert(path, alphatest);
+        } else {
+            *it = std::max(*it, alphatest);
+        }
+    };
+
+    QVector<const WidgetData*> stack;
+    for (int i = 0; i < screens.rowCount(); ++i) {
+        stack.append(&screens.widget(screens.index(i, 0)));
+    }
+    while (!stack.isEmpty()) {
+        const WidgetData* widget = stack.takeLast();
+        for (int key : pixmapKeys) {
+            // Only the main pixmap follows the alphatest attribute
+            const auto alphatest = key == Property::pixmap ? widget->alphatest() : Property::blend;
+            use(widget->pixmap(key), alphatest);
+        }
+        for (int i = 0; i < widget->childCount(); ++i) {
+            stack.append(widget->child(i));
+        }
+    }
+
+    // Borders are blended over the screen background
+    for (const auto& style : styles) {
+        const BorderSet borders = style.borderSet();
+        for (int i = 0; i < BorderSet::count(); ++i) {
+            auto bp = static_cast<Property::BorderPosition>(i);
+            use(borders.getBorder(bp).fileName(), Property::blend);
+        }
+    }
+    return result;
+}
+
+DeployReport AssetOptimizer::deploy(const QString& path, const QString& target) const
+{
+    TraceZone zone("batch", "AssetOptimizer::deploy");
+    zone.setDetail(path);
+
+    DeployReport report;
+    SkinRepository repository;
+    repository.setHeadless(true);
+    SkinRepository::Scope scope(&repository);
+    if (!repository.open(SkinBatch::skinDirectory(path))) {
+        report.error = repository.lastError();
+        return report;
+    }
+
+    const QDir source = repository.dir();
+    const QDir destination(target);
+    const QString sourcePath = source.absolutePath();
+    const QString targetPath = destination.absolutePath();
+    if (targetPath == sourcePath || targetPath.startsWith(sourcePath + '/')) {
+        report.error = QObject::tr("Target directory is inside of the skin");
+        return report;
+    }
+
+    const QHash<QString, Property::Alphatest> assets = relativeAssets(source);
+
+    // Other files are copied as they are. Hidden files and directories
+    // are version control data, editor swap files or our own cache
+    QDirIterator files(sourcePath, QDir::Files, QDirIterator::Subdirectories);
+    while (files.hasNext()) {
+        const QString file = files.next();
+        const QString name = source.relativeFilePath(file);
+        const QString copy = destination.filePath(name);
+        if (!destination.mkpath(QFileInfo(name).path())) {
+            report.error = QObject::tr("Can not create directory for %1").arg(copy);
+            return report;
+        }
+        if (assets.contains(name))
+            continue;
+        QFile::remove(copy);
+        if (!QFile::copy(file, copy)) {
+            report.error = QObject::tr("Can not write %1").arg(copy);
+            return report;
+        }
+    }
+
+    QStringList names = assets.keys();
+    std::sort(names.begin(), names.end());
+    const int bpp = SkinRepository::outputs()->getOutput(0).bpp();
+    auto optimizeOne = [&](const QString& name) {
+        AssetReport asset = optimizeFile(
+          source.filePath(name), destination.filePath(name), assets.value(name), bpp);
+        asset.fileName = name;
+        return asset;
+    };
+    const QList<AssetReport> reports =
+      QtConcurrent::blockingMapped<QList<AssetReport>>(names, optimizeOne);
+    report.assets = reports.toVector();
+    return report;
+}
+
+DeployReport AssetOptimizer::resample(qreal sx, qreal sy, const QString& target) const
+{
+    TraceZone zone("batch", "AssetOptimizer::resample");
+    zone.setDetail(target);
+
+    DeployReport report;
+    const QDir source = SkinRepository::current().dir();
+    const QDir destination(target);
+    if (destination.absolutePath() == source.absolutePath()) {
+        report.error = QObject::tr("Target directory is the skin directory");
+        return report;
+    }
+
+    const QHash<QString, Property::Alphatest> assets = relativeAssets(source);
+    QStringList names = assets.keys();
+    std::sort(names.begin(), names.end());
+    for (const auto& name : qAsConst(names)) {
+        if (!destination.mkpath(QFileInfo(name).path())) {
+            report.error = QObject::tr("Can not create directory for %1").arg(name);
+            return report;
+        }
+    }
+
+    const int bpp = SkinRepository::outputs()->getOutput(0).bpp();
+    auto resampleOne = [&](const QString& name) {
+        AssetReport asset = resampleFile(source.filePath(name),
+                                         destination.filePath(name),
+                                         assets.value(name),
+                                         bpp,
+                                         QSizeF(sx, sy));
+        asset.fileName = name;
+        return asset;
+    };
+    const QList<AssetReport> reports =
+      QtConcurrent::blockingMapped<QList<AssetReport>>(names, resampleOne);
+    report.assets = reports.toVector();
+    return report;
+}
+
+QHash<QString, Property::Alphatest> AssetOptimizer::relativeAssets(const QDir& source)
+{
+    QHash<QString, Property::Alphatest> result;
+    const auto used = assets(*SkinRepository::screens(), *SkinRepository::styles());
+    for (auto it = used.cbegin(); it != used.cend(); ++it) {
+        const QString name = source.relativeFilePath(it.key());
+        if (name.startsWith("../")) {
+            qWarning() << "Pixmap outside of the skin is skipped" << it.key();
+            continue;
+        }
+        result.insert(name, it.value());
+    }
+    return result;
+}
+
+AssetReport AssetOptimizer::resampleFile(const QString& source,
+                                         const QString& target,
+                                         Property::Alphatest alphatest,
+                                         int bpp,
+                                         const QSizeF& scale) const
+{
+    TraceZone zone("batch", "AssetOptimizer::resampleFile");
+    zone.setDetail(source);
+
+    AssetReport report;
+    report.fileName = source;
+    report.originalSize = QFileInfo(source).size();
+    QImageReader reader(source);
+    QImage image = reader.read();
+    if (image.isNull()) {
+        report.error = reader.errorString();
+        return report;
+    }
+    const QSize size(qMax(1, qRound(image.width() * scale.width())),
+                     qMax(1, qRound(image.height() * scale.height())));
+    image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    QByteArray data;
+    if (reader.format() == "png") {
+        data = optimize(image, alphatest, bpp, &report.format);
+    } else {
+        // Other formats keep their format
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (!image.save(&buffer, reader.format().constData())) {
+            data.clear();
+        }
+        report.format = QString::fromLatin1(reader.format());
+    }
+    if (data.isEmpty()) {
+        report.error = QObject::tr("Can not encode the image");
+        return report;
+    }
+
+    QSaveFile copy(target);
+    if (!copy.open(QIODevice::WriteOnly) || copy.write(data) != data.size() || !copy.commit()) {
+        report.error = copy.errorString();
+        return report;
+    }
+    report.optimizedSize = data.size();
+    return report;
+}
+
+AssetReport AssetOptimizer::optimizeFile(const QString& source,
+                                         const QString& target,
+                                         Property::Alphatest alphatest,
+                                         int bpp) const
+{
+    TraceZone zone("batch", "AssetOptimizer::optimizeFile");
+    zone.setDetail(source);
+
+    AssetReport report;
+    report.fileName = source;
+    QFile file(source);
+    if (!file.open(QIODevice::ReadOnly)) {
+        report.error = file.errorString();
+        return report;
+    }
+    const QByteArray original = file.readAll();
+    report.originalSize = original.size();
+
+    QByteArray data = original;
+    QImage image;
+    if (image.loadFromData(original, "png")) {
+        QString format;
+        QByteArray optimized = optimize(image, alphatest, bpp, &format);
+        if (!optimized.isEmpty() && optimized.size() < original.size()) {
+            data = optimized;
+            report.format = format;
+        }
+    }
+    // Other files are copied as they are
+
+    QSaveFile copy(target);
+    if (!copy.open(QIODevice::WriteOnly) || copy.write(data) != data.size() || !copy.commit()) {
+        report.error = copy.errorString();
+        return report;
+    }
+    report.optimizedSize = data.size();
+    return report;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "skin/enums.hpp"
+#include <QDir>
+#include <QHash>
+#include <QImage>
+#include <QSizeF>
+#include <QVector>
+
+class ScreensModel;
+class WindowStylesList;
+
+/**
+ * @brief result of writing one pixmap of a deployment copy
+ */
+struct AssetReport
+{
+    // Relative to the skin directory
+    QString fileName;
+    qint64 originalSize = 0;
+    qint64 optimizedSize = 0;
+    // Form of the written image, empty when the original was copied
+    QString format;
+    QString error;
+
+    qint64 saved() const { return originalSize - optimizedSize; }
+};
+
+struct DeployReport
+{
+    // Empty when the copy was written
+    QString error;
+    QVector<AssetReport> assets;
+
+    qint64 originalSize() const;
+    qint64 optimizedSize() const;
+};
+
+/**
+ * @brief writes copies of skins made smaller for set-top boxes
+ * PNG files used by widgets and window style borders are recompressed
+ * without metadata, in parallel. Lossless palettes are used for images
+ * with few colors. Quantisation reduces alpha to what the alphatest mode
+ * of the widgets needs and allows lossy palettes, it is always allowed
+ * for outputs with 8 bpp or less, where the box has a palette anyway.
+ * Pixmaps can also be resampled for another output resolution.
+ */
+class AssetOptimizer
+{
+public:
+    explicit AssetOptimizer(bool quantize = false);
+
+    // Smallest PNG the box shows like the image, thread safe
+    QByteArray optimize(const QImage& image,
+                        Property::Alphatest alphatest,
+                        int bpp = 32,
+                        QString* format = nullptr) const;
+
+    // Pixmaps of the document by resolved path, with the most demanding
+    // alphatest mode of their users
+    static QHash<QString, Property::Alphatest> assets(const ScreensModel& screens,
+                                                      const WindowStylesList& styles);
+
+    // Copy the skin directory to @p target and optimise its pixmaps
+    DeployReport deploy(const QString& path, const QString& target) const;
+    // Pixmaps of the current document scaled by @p sx and @p sy, written
+    // to @p target with their names relative to the skin directory
+    DeployReport resample(qreal sx, qreal sy, const QString& target) const;
+
+private:
+    // Pixmaps of the current document inside of @p source, by relative name
+    static QHash<QString, Property::Alphatest> relativeAssets(const QDir& source);
+    AssetReport resampleFile(const QString& source,
+                             const QString& target,
+                             Property::Alphatest alphatest,
+                             int bpp,
+                             const QSizeF& scale) const;
+    AssetReport optimizeFile(const QString& source,
+                             const QString& target,
+                             Property::Alphatest alphatest,
+                             int bpp) const;
+
+    bool m_quantize;
+};
@@ -1,17 +1,60 @@
 #include "pixmapstorage.hpp"
+#include "base/trace.hpp"
+#include <QFileInfo>
+#include <QImage>
+#include <QtConcurrent>
+#include <QtMath>
+
+namespace {
+
+QString mipmapKey(const QString& path, int level)
+{
+    return QStringLiteral("%1@mip%2").arg(path).arg(level);
+}
+QImage decodeImage(const QString& path)
+{
+    TraceZone zone("pixmap", "decodeImage");
+    zone.setDetail(path);
+    return QImage(path);
+}
+} // namespace
 
 PixmapStorage::PixmapStorage(QObject* parent)
     : QObject(parent)
 {
-    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &PixmapStorage::onFileChanged);
+    connect(&m_watcher,
+            &QFileSystemWatcher::directoryChanged,
+            this,
+            &PixmapStorage::onDirectoryChanged);
+
+    // Editors may touch a directory several times while saving
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(200);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &PixmapStorage::reloadPending);
+
+    m_pollTimer.setInterval(2000);
+    connect(&m_pollTimer, &QTimer::timeout, this, &PixmapStorage::pollFiles);
 }
 
 void PixmapStorage::registerObserver(const QString& path, PixmapWatcher* observer)
 {
     Q_ASSERT(!m_observers.contains(path, observer));
 
+    bool first = !m_observers.contains(path);
     m_observers.insert(path, observer);
-    m_watcher.addPath(path);
+    if (!first)
+        return;
+
+    auto dir = QFileInfo(path).absolutePath();
+    auto& files = m_directories[dir];
+    if (files.isEmpty()) {
+        m_watcher.addPath(dir);
+    }
+    files.insert(path);
+    m_stamps.insert(path, stamp(path));
+    if (!m_pollTimer.isActive()) {
+        m_pollTimer.start();
+    }
 }
 
 void PixmapStorage::unregisterObserver(const QString& path, PixmapWatcher* observer)
@@ -19,14 +62,153 @@ void PixmapStorage::unregisterObserver(const QString& path, PixmapWatcher* obser
     Q_ASSERT(m_observers.contains(path, observer));
 
     m_observers.remove(path, observer);
-    if (!m_observers.contains(path))
-        m_watcher.removePath(path);
+    if (m_observers.contains(path))
+        return;
+
+    auto dir = QFileInfo(path).absolutePath();
+    auto it = m_directories.find(dir);
+    if (it != m_directories.end()) {
+        it->remove(path);
+        if (it->isEmpty()) {
+            m_directories.erase(it);
+            m_watcher.removePath(dir);
+        }
+    }
+    m_stamps.remove(path);
+    m_pending.remove(path);
+    if (m_stamps.isEmpty()) {
+        m_pollTimer.stop();
+    }
+    // Nobody watches the file anymore, so the cached copy may get stale
+    removeFromCache(path);
 }
 
-void PixmapStorage::onFileChanged(const QString& path)
+QPixmap PixmapStorage::pixmap(const QString& path)
 {
-    // Iterate over all values with the given key
-    for (auto it = m_observers.find(path); it != m_observers.end() && it.key() == path; ++it) {
-        it.value()->fileChangedEvent();
+    QPixmap pixmap;
+    if (path.isEmpty())
+        return pixmap;
+    if (!QPixmapCache::find(path, &pixmap)) {
+        TraceZone zone("pixmap", "PixmapStorage::load");
+        zone.setDetail(path);
+        pixmap.load(path);
+        QPixmapCache::insert(path, pixmap);
+    }
+    return pixmap;
+}
+
+QPixmap PixmapStorage::mipmap(const QString& path, int level)
+{
+    level = qBound(0, level, maxMipmapLevel);
+    if (level == 0 || path.isEmpty())
+        return pixmap(path);
+
+    QPixmap result;
+    const QString key = mipmapKey(path, level);
+    if (!QPixmapCache::find(key, &result)) {
+        // Built from the previous level, so each level is a single 2x reduction
+        QPixmap source = mipmap(path, level - 1);
+        if (source.width() < 2 || source.height() < 2)
+            return source;
+        TRACE_ZONE("pixmap", "PixmapStorage::mipmap");
+        result = source.scaled(source.size() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        QPixmapCache::insert(key, result);
+    }
+    return result;
+}
+
+int PixmapStorage::mipmapLevel(qreal scale)
+{
+    if (scale <= 0 || scale >= 1)
+        return 0;
+    return qBound(0, qFloor(std::log2(1 / scale)), maxMipmapLevel);
+}
+
+void PixmapStorage::removeFromCache(const QString& path)
+{
+    QPixmapCache::remove(path);
+    for (int level = 1; level <= maxMipmapLevel; ++level) {
+        QPixmapCache::remove(mipmapKey(path, level));
+    }
+}
+
+PixmapStorage::FileStamp PixmapStorage::stamp(const QString& path)
+{
+    QFileInfo info(path);
+    FileStamp s;
+    if (info.exists()) {
+        s.size = info.size();
+        s.modified = info.lastModified();
+    }
+    return s;
+}
+
+void PixmapStorage::onDirectoryChanged(const QString& path)
+{
+    emit directoryChanged(path);
+
+    auto it = m_directories.constFind(path);
+    if (it == m_directories.cend())
+        return;
+
+    for (const auto& file : *it) {
+        checkFile(file);
+    }
+    m_recheck.insert(path);
+    m_reloadTimer.start();
+}
+
+void PixmapStorage::pollFiles()
+{
+    TRACE_ZONE("pixmap", "PixmapStorage::pollFiles");
+    for (auto it = m_stamps.cbegin(); it != m_stamps.cend(); ++it) {
+        checkFile(it.key());
+    }
+}
+
+void PixmapStorage::checkFile(const QString& path)
+{
+    auto s = stamp(path);
+    auto it = m_stamps.find(path);
+    if (it != m_stamps.end() && s != *it) {
+        *it = s;
+        m_pending.insert(path);
+        m_reloadTimer.start();
+    }
+}
+
+void PixmapStorage::reloadPending()
+{
+    // Writes still in progress during the directory event are finished by now
+    const auto recheck = m_recheck;
+    m_recheck.clear();
+    for (const auto& dir : recheck) {
+        for (const auto& file : m_directories.value(dir)) {
+            checkFile(file);
+        }
+    }
+
+    QStringList paths = m_pending.values();
+    m_pending.clear();
+    if (paths.isEmpty())
+        return;
+
+    // Decoding is thread safe for QImage only,
+    // conversion to QPixmap must happen in the GUI thread
+    auto images = QtConcurrent::blockingMapped<QVector<QImage>>(paths, decodeImage);
+    for (int i = 0; i < paths.size(); ++i) {
+        removeFromCache(paths[i]);
+        if (!images[i].isNull()) {
+            QPixmapCache::insert(paths[i], QPixmap::fromImage(images[i]));
+        }
+    }
+
+    for (const auto& path : qAsConst(paths)) {
+        // Observer may unregister itself while handling the event
+        const auto observers = m_observers.values(path);
+        for (auto* observer : observers) {
+            observer->fileChangedEvent();
+        }
     }
+    emit pixmapsChanged(paths);
 }
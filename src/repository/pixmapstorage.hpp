@@ -3,6 +3,9 @@
 #include <QObject>
 #include <QPixmapCache>
 #include <QFileSystemWatcher>
+#include <QDateTime>
+#include <QSet>
+#include <QTimer>
 #include "base/singleton.hpp"
 
 class PixmapWatcher;
@@ -11,22 +14,74 @@ class PixmapWatcher;
  * @brief Collection of png files used by skin
  * Provides interface to get Pixmap by filename
  * Watches file system changes and notifies about changed Pixmaps
+ *
+ * Only directories of registered files are watched, one watch per
+ * directory keeps us far from the inotify limit. A directory event
+ * compares the stamps of its registered files now and once more after
+ * the debounce, writers may still be busy. Files rewritten in place fire
+ * no directory event and are found by a slow stamp poll.
+ * Changes are collected for a short time and the whole batch is decoded
+ * in parallel before observers are notified.
  */
-class PixmapStorage : public SingletonMixin<PixmapStorage>, public QObject
+class PixmapStorage : public QObject, public SingletonMixin<PixmapStorage>
 {
+    Q_OBJECT
     Q_DISABLE_COPY(PixmapStorage)
 public:
     explicit PixmapStorage(QObject* parent = Q_NULLPTR);
     void registerObserver(const QString& path, PixmapWatcher* observer);
     void unregisterObserver(const QString& path, PixmapWatcher* observer);
 
+    /// Decoded pixmap, shared between all users of the same file
+    static QPixmap pixmap(const QString& path);
+    /// Pixmap downscaled by 2^level for zoomed out painting, level 0 is the pixmap itself
+    static QPixmap mipmap(const QString& path, int level);
+    /// Coarsest mipmap level which still has at least one pixel per device pixel
+    static int mipmapLevel(qreal scale);
+    static constexpr int maxMipmapLevel = 4;
+
+signals:
+    /// Watched directory content has changed
+    void directoryChanged(const QString& path);
+    /// Batch of files was reloaded and observers were notified
+    void pixmapsChanged(const QStringList& paths);
+
 private slots:
-    /// Route QFileSystemWatcher event to registered observers
-    void onFileChanged(const QString& path);
+    /// Map QFileSystemWatcher event back to registered files
+    void onDirectoryChanged(const QString& path);
+    /// Compare stamps of all registered files
+    void pollFiles();
+    /// Decode pending files and route the event to registered observers
+    void reloadPending();
 
 private:
+    struct FileStamp
+    {
+        qint64 size = -1;
+        QDateTime modified;
+        bool operator==(const FileStamp& other) const
+        {
+            return size == other.size && modified == other.modified;
+        }
+        bool operator!=(const FileStamp& other) const { return !(*this == other); }
+    };
+    static FileStamp stamp(const QString& path);
+    /// Queue the file for reload if its stamp differs
+    void checkFile(const QString& path);
+    /// Drop the decoded pixmap and all its mipmaps
+    static void removeFromCache(const QString& path);
+
     QFileSystemWatcher m_watcher;
     QMultiHash<QString, PixmapWatcher*> m_observers;
+    // Watched directory -> registered files in it
+    QHash<QString, QSet<QString>> m_directories;
+    QHash<QString, FileStamp> m_stamps;
+    // Files changed since the last reload
+    QSet<QString> m_pending;
+    // Directories changed since the last reload, checked again after it
+    QSet<QString> m_recheck;
+    QTimer m_reloadTimer;
+    QTimer m_pollTimer;
 };
 
 /**
@@ -62,6 +117,7 @@ public:
 
 protected:
     /// Override this function to handle file change events
+    /// The new content is already available from PixmapStorage::pixmap()
     virtual void fileChangedEvent() = 0;
 
 private:
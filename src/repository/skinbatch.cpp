@@ -0,0 +1,88 @@
+#include "skinbatch.hpp"
+#include "repository/skinrepository.hpp"
+#include "repository/pixmapstorage.hpp"
+#include "base/trace.hpp"
+#include <QFileInfo>
+#include <QtConcurrent>
+#include <algorithm>
+
+bool SkinReport::hasErrors() const
+{
+    return !error.isEmpty()
+           || std::any_of(diagnostics.begin(), diagnostics.end(), [](const Diagnostic& d) {
+                  return d.severity == Diagnostic::Error;
+              });
+}
+
+QString SkinBatch::skinDirectory(const QString& path)
+{
+    QFileInfo info(path);
+    return info.isFile() ? info.absolutePath() : info.absoluteFilePath();
+}
+
+SkinReport SkinBatch::validate(const QString& path)
+{
+    TraceZone zone("batch", "SkinBatch::validate");
+    zone.setDetail(path);
+
+    SkinReport report;
+    report.path = path;
+
+    SkinRepository repository;
+    repository.setHeadless(true);
+    SkinRepository::Scope scope(&repository);
+    if (!repository.open(skinDirectory(path))) {
+        report.error = repository.lastError();
+        return report;
+    }
+
+    SkinValidator validator(SkinRepository::screens());
+    validator.setOutputRect(QRect(QPoint(0, 0), repository.outputSize()));
+    validator.validateNow();
+    report.diagnostics = validator.diagnostics();
+    return report;
+}
+
+QVector<SkinReport> SkinBatch::validate(const QStringList& paths)
+{
+    // Repositories listen to the storage, it must live in the main thread
+    PixmapStorage::instance();
+
+    const QList<SkinReport> reports = QtConcurrent::blockingMapped(
+      paths, static_cast<SkinReport (*)(const QString&)>(&SkinBatch::validate));
+    return reports.toVector();
+}
+
+SkinReport SkinBatch::estimate(const QString& path)
+{
+    TraceZone zone("batch", "SkinBatch::estimate");
+    zone.setDetail(path);
+
+    SkinReport report;
+    report.path = path;
+
+    SkinRepository repository;
+    repository.setHeadless(true);
+    SkinRepository::Scope scope(&repository);
+    if (!repository.open(skinDirectory(path))) {
+        report.error = repository.lastError();
+        return report;
+    }
+
+    ScreenEstimator estimator(SkinRepository::screens());
+    estimator.setBpp(SkinRepository::outputs()->getOutput(0).bpp());
+    estimator.estimateNow();
+    report.estimates = estimator.estimates();
+    return report;
+}
+
+QVector<SkinReport> SkinBatch::estimate(const QStringList& paths)
+{
+    PixmapStorage::instance();
+
+    QVector<SkinReport> reports;
+    for (const auto& path : paths) {
+        reports.append(estimate(path));
+    }
+    return reports;
+}
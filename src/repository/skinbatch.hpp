@@ -0,0 +1,42 @@
+#pragma once
+
+#include "model/screenestimator.hpp"
+#include "model/skinvalidator.hpp"
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief result of processing one skin without the editor
+ */
+struct SkinReport
+{
+    QString path;
+    // Empty when the skin was loaded
+    QString error;
+    QVector<Diagnostic> diagnostics;
+    QVector<ScreenEstimate> estimates;
+
+    bool hasErrors() const;
+};
+
+/**
+ * @brief headless processing of skin directories
+ * Every skin gets its own headless repository, so the skins are handled
+ * concurrently in the global thread pool without touching pixmaps.
+ */
+class SkinBatch
+{
+public:
+    // Skin directory of a skin.xml file or of the directory itself
+    static QString skinDirectory(const QString& path);
+
+    // Load the skin and check all its widgets, thread safe
+    static SkinReport validate(const QString& path);
+    static QVector<SkinReport> validate(const QStringList& paths);
+
+    // Load the skin and estimate the cost of its screens for the
+    // first output, screens are estimated concurrently
+    static SkinReport estimate(const QString& path);
+    // Skins one after another, each of them uses the whole pool
+    static QVector<SkinReport> estimate(const QStringList& paths);
+};
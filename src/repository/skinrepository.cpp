@@ -1,29 +1,175 @@
 #include "skinrepository.hpp"
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
 #include <QObject>
+#include <QSaveFile>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
+#include "base/trace.hpp"
 #include "base/xmlstreamwriter.hpp"
 
+namespace {
+
+const quint32 cacheMagic = 0x45324443; // E2DC
+const quint32 cacheVersion = 1;
+
+/// State of a file which was used to build the model cache
+struct SourceStamp
+{
+    QString name;
+    qint64 size = -1;
+    qint64 modified = 0;
+    QByteArray hash;
+};
+
+QDataStream& operator<<(QDataStream& stream, const SourceStamp& s)
+{
+    return stream << s.name << s.size << s.modified << s.hash;
+}
+
+QDataStream& operator>>(QDataStream& stream, SourceStamp& s)
+{
+    return stream >> s.name >> s.size >> s.modified >> s.hash;
+}
+
+QByteArray fileHash(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+SourceStamp stampFile(const QDir& dir, const QString& name)
+{
+    SourceStamp s;
+    s.name = name;
+    QFileInfo info(dir, name);
+    if (info.exists()) {
+        s.size = info.size();
+        s.modified = info.lastModified().toMSecsSinceEpoch();
+        s.hash = fileHash(info.filePath());
+    }
+    return s;
+}
+
+bool isUpToDate(const QDir& dir, const SourceStamp& s)
+{
+    QFileInfo info(dir, s.name);
+    if (!info.exists()) {
+        return s.size < 0;
+    }
+    // Cheap checks go first
+    if (info.size() != s.size || info.lastModified().toMSecsSinceEpoch() != s.modified) {
+        return false;
+    }
+    return fileHash(info.filePath()) == s.hash;
+}
+
+thread_local SkinRepository* currentRepository = nullptr;
+
+} // namespace
+
+SkinRepository::Scope::Scope(SkinRepository* repository)
+    : m_previous(currentRepository)
+{
+    currentRepository = repository;
+}
+
+SkinRepository::Scope::~Scope()
+{
+    currentRepository = m_previous;
+}
+
+SkinRepository& SkinRepository::current()
+{
+    return currentRepository ? *currentRepository : instance();
+}
+
 SkinRepository::SkinRepository(QObject* parent)
     : QObject(parent)
     , m_colors(new ColorsModel(this))
     , m_roles(*m_colors)
     , m_fonts(new FontsModel(this))
     , m_screensModel(new ScreensModel(*m_colors, m_roles, *m_fonts, this))
-{}
+    , m_cacheEnabled(false)
+    , m_loadedFromCache(false)
+    , m_watchEnabled(false)
+    , m_headless(false)
+    , m_watcher(new SkinWatcher(this, m_screensModel, this))
+    , m_resolveGeneration(0)
+{
+    m_screensModel->setRepository(this);
+    connect(&PixmapStorage::instance(),
+            &PixmapStorage::directoryChanged,
+            this,
+            &SkinRepository::onDirectoryChanged);
+
+    // Screens are laid out in the first output
+    connect(&m_outputRepository, &OutputsModel::valueChanged, this, [this](int id) {
+        if (id == 0) {
+            m_screensModel->setOutputSize(outputSize());
+        }
+    });
+    m_screensModel->setOutputSize(outputSize());
+}
+
+QDir SkinRepository::dir() const
+{
+    QMutexLocker locker(&m_resolveMutex);
+    return m_directory;
+}
 
 QSize SkinRepository::outputSize() const
 {
     return m_outputRepository.getOutput(0).size();
 }
 
+/**
+ * @brief Find the file referenced by the skin on disk
+ * Results are cached by the raw path, the cache is dropped when
+ * skin directory changes or a watched directory content changes.
+ * Unresolved names are not cached, as we don't watch for files to appear.
+ */
 QString SkinRepository::resolveFilename(const QString& path) const
 {
     if (path.isEmpty()) {
         return QString();
     }
-    QDir dir = this->dir();
+
+    QMutexLocker locker(&m_resolveMutex);
+    auto it = m_resolveCache.constFind(path);
+    if (it != m_resolveCache.cend()) {
+        ++m_resolveStats.hits;
+        return *it;
+    }
+    ++m_resolveStats.misses;
+    const QDir directory = m_directory;
+    const quint64 generation = m_resolveGeneration;
+    locker.unlock();
+
+    // Disk lookups run unlocked, the result is dropped if the cache was cleared meanwhile
+    auto fileName = lookupFilename(directory, path);
+    locker.relock();
+    if (!fileName.isNull() && generation == m_resolveGeneration) {
+        m_resolveCache.insert(path, fileName);
+    }
+    return fileName;
+}
+
+SkinRepository::ResolveCacheStats SkinRepository::resolveCacheStats() const
+{
+    QMutexLocker locker(&m_resolveMutex);
+    return m_resolveStats;
+}
+
+QString SkinRepository::lookupFilename(const QDir& directory, const QString& path) const
+{
+    QDir dir = directory;
     // First assume that file prefix is our directory name
     dir.cdUp();
     if (dir.exists(path)) {
@@ -32,7 +178,7 @@ QString SkinRepository::resolveFilename(const QString& path) const
         // Secondly replace file prefix with our directory name
         QStringList list = path.split("/");
         list.pop_front();
-        dir = this->dir();
+        dir = directory;
         if (dir.exists(list.join("/"))) {
             return dir.filePath(list.join("/"));
         }
@@ -48,14 +194,26 @@ QString SkinRepository::resolveFilename(const QString& path) const
  */
 bool SkinRepository::open(const QString& path)
 {
-    m_directory = QDir(path);
+    TraceZone zone("repository", "SkinRepository::open");
+    zone.setDetail(path);
+    Scope scope(this);
+    m_watcher->stop();
+    m_loadedFromCache = false;
+    setDirectory(QDir(path));
     if (!m_directory.exists()) {
         return setError(tr("Directory does not exists"));
     }
 
+    QString skinFile = m_directory.filePath("skin.xml");
+    if (m_cacheEnabled && QFileInfo::exists(skinFile) && loadCache()) {
+        m_loadedFromCache = true;
+        emit filePathChanged(skinFile);
+        updateWatcher();
+        return true;
+    }
+
     m_screensModel->loadPreviews(previewFilePath());
 
-    QString skinFile = m_directory.filePath("skin.xml");
     QFile file(skinFile);
     bool ok = file.open(QIODevice::ReadOnly);
     if (!ok) {
@@ -74,6 +232,10 @@ bool SkinRepository::open(const QString& path)
     }
     file.close();
 
+    if (m_cacheEnabled) {
+        saveCache();
+    }
+    updateWatcher();
     return ok;
 }
 
@@ -90,6 +252,8 @@ bool SkinRepository::fromXmlDocument(QXmlStreamReader& xml)
 
 bool SkinRepository::save()
 {
+    TRACE_ZONE("repository", "SkinRepository::save");
+    Scope scope(this);
     if (!isOpened()) {
         setError(tr("Skin directory is not specified"));
         return false;
@@ -114,13 +278,19 @@ bool SkinRepository::save()
 
     // Tell undo model that the state is saved
     m_screensModel->undoStack()->setClean();
+
+    if (m_cacheEnabled) {
+        saveCache();
+    }
+    // Remember the written content, it is not an external change
+    updateWatcher();
     return true;
 }
 
 bool SkinRepository::saveAs(const QString& path)
 {
     QDir oldDir = m_directory;
-    m_directory = QDir(path);
+    setDirectory(QDir(path));
     qDebug() << oldDir.absolutePath() << m_directory.absolutePath();
     if (oldDir == m_directory || QFileInfo(m_directory, "skin.xml").exists()
         || QFileInfo(m_directory, "preview.xml").exists()) {
@@ -128,7 +298,7 @@ bool SkinRepository::saveAs(const QString& path)
     }
     bool saved = save();
     if (!saved) {
-        m_directory = oldDir;
+        setDirectory(oldDir);
     }
     return saved;
 }
@@ -136,17 +306,17 @@ bool SkinRepository::saveAs(const QString& path)
 bool SkinRepository::create(const QString& path)
 {
     clear();
-    m_directory = QDir();
+    setDirectory(QDir());
     emit filePathChanged(QString());
 
     auto dir = QDir(path);
     if (QFileInfo(dir, "skin.xml").exists() || QFileInfo(dir, "preview.xml").exists()) {
         return setError("This folder already contains a skin");
     }
-    m_directory = dir;
+    setDirectory(dir);
     bool saved = save();
     if (!saved) {
-        m_directory = QDir();
+        setDirectory(QDir());
     }
     emit filePathChanged(m_directory.filePath("skin.xml"));
     return saved;
@@ -161,7 +331,10 @@ bool SkinRepository::isOpened() const
 void SkinRepository::fromXml(QXmlStreamReader& xml)
 {
     Q_ASSERT(xml.isStartElement() && xml.name() == "skin");
+    Scope scope(this);
 
+    // Screens are published with a single reset when the document is read
+    m_screensModel->beginBulkLoad();
     clear();
 
     while (xml.readNextStartElement()) {
@@ -182,11 +355,19 @@ void SkinRepository::fromXml(QXmlStreamReader& xml)
             xml.skipCurrentElement();
         }
     }
+    m_screensModel->endBulkLoad();
+
+    applyDefaultStyle();
+}
 
+void SkinRepository::applyDefaultStyle()
+{
     if (m_windowStyles.itemsCount() > 0) {
         defaultStyle = m_windowStyles.itemAt(0);
         m_roles.setStyle(&defaultStyle);
-        m_borders.setStyle(&defaultStyle);
+        if (!m_headless) {
+            m_borders.setStyle(&defaultStyle);
+        }
     }
 }
 
@@ -211,6 +392,128 @@ QString SkinRepository::previewFilePath() const
     return m_directory.filePath("preview.xml");
 }
 
+QString SkinRepository::cacheFilePath() const
+{
+    return m_directory.filePath(".e2designer.cache");
+}
+
+/// Files the model is built from, relative to the skin directory
+QStringList SkinRepository::sourceFiles() const
+{
+    QStringList files = { "skin.xml", "preview.xml" };
+    files.append(m_screensModel->includeFiles());
+    return files;
+}
+
+/**
+ * @brief Restore the model from the binary cache
+ * @return false if the cache is missing, corrupted or outdated,
+ * in this case the skin must be loaded from xml
+ */
+bool SkinRepository::loadCache()
+{
+    TRACE_ZONE("repository", "SkinRepository::loadCache");
+    QFile file(cacheFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // Avoid copying the file into memory when possible
+    const uchar* data = file.map(0, file.size());
+    QByteArray bytes = data ? QByteArray::fromRawData(reinterpret_cast<const char*>(data),
+                                                      static_cast<int>(file.size()))
+                            : file.readAll();
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_11);
+
+    quint32 magic, version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != cacheMagic || version != cacheVersion) {
+        return false;
+    }
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count; ++i) {
+        SourceStamp s;
+        stream >> s;
+        if (stream.status() != QDataStream::Ok || !isUpToDate(m_directory, s)) {
+            return false;
+        }
+    }
+
+    clear();
+    m_outputRepository.fromStream(stream);
+    m_windowStyles.fromStream(stream);
+    m_fonts->fromStream(stream);
+    m_colors->fromStream(stream);
+    m_screensModel->readPreviews(stream);
+    m_screensModel->fromStream(stream);
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Model cache is corrupted" << file.fileName();
+        clear();
+        return false;
+    }
+    applyDefaultStyle();
+    return true;
+}
+
+bool SkinRepository::saveCache() const
+{
+    QSaveFile file(cacheFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Can not write model cache" << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_11);
+
+    stream << cacheMagic << cacheVersion;
+    const auto sources = sourceFiles();
+    stream << qint32(sources.size());
+    for (const auto& name : sources) {
+        stream << stampFile(m_directory, name);
+    }
+
+    m_outputRepository.toStream(stream);
+    m_windowStyles.toStream(stream);
+    m_fonts->toStream(stream);
+    m_colors->toStream(stream);
+    m_screensModel->writePreviews(stream);
+    m_screensModel->toStream(stream);
+    return file.commit();
+}
+
+void SkinRepository::setWatchEnabled(bool enabled)
+{
+    m_watchEnabled = enabled;
+    updateWatcher();
+}
+
+void SkinRepository::updateWatcher()
+{
+    if (m_watchEnabled && isOpened()) {
+        m_watcher->watch();
+    } else {
+        m_watcher->stop();
+    }
+}
+
+void SkinRepository::setDirectory(const QDir& dir)
+{
+    QMutexLocker locker(&m_resolveMutex);
+    m_directory = dir;
+    m_resolveCache.clear();
+    ++m_resolveGeneration;
+}
+
+void SkinRepository::onDirectoryChanged(const QString& path)
+{
+    Q_UNUSED(path)
+    // Any file might have been removed or shadowed, directory events are rare
+    QMutexLocker locker(&m_resolveMutex);
+    m_resolveCache.clear();
+    ++m_resolveGeneration;
+}
+
 /**
  * @brief Set error message
  * @param message that can be displayed to the user
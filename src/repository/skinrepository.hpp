@@ -7,7 +7,9 @@
 #include "model/screensmodel.hpp"
 #include "model/windowstyle.hpp"
 #include "model/bordersmodel.hpp"
+#include "repository/skinwatcher.hpp"
 #include <QDir>
+#include <QMutex>
 #include <QObject>
 
 class QXmlStreamReader;
@@ -16,6 +18,10 @@ class QXmlStreamWriter;
 /**
  * @brief provides storage of the skin data
  * stores C++ types like int, enum, QPoint, QSize, struct
+ *
+ * Every instance holds one document. The editor uses the singleton,
+ * batch tools create their own instances, one per thread, and make
+ * them current with Scope while working on them.
  */
 class SkinRepository : public QObject, public SingletonMixin<SkinRepository>, public XmlData
 {
@@ -23,20 +29,44 @@ class SkinRepository : public QObject, public SingletonMixin<SkinRepository>, pu
     Q_DISABLE_COPY(SkinRepository)
 
 public:
-    // Never call this manually. FIXME: declare private
     explicit SkinRepository(QObject* parent = Q_NULLPTR);
 
-    // functions for easy access to singleton childs
-    static ColorsModel* colors() { return instance().m_colors; }
-    static FontsModel* fonts() { return instance().m_fonts; }
-    static ScreensModel* screens() { return instance().m_screensModel; }
-    static OutputsModel* outputs() { return &instance().m_outputRepository; }
-    static WindowStylesList* styles() { return &instance().m_windowStyles; }
-    static BorderStorage* borders() { return &instance().m_borders; }
+    /**
+     * @brief Makes the repository current for the calling thread
+     * Attributes and models without access to their document resolve
+     * files and fonts through the current repository.
+     */
+    class Scope
+    {
+        Q_DISABLE_COPY(Scope)
+    public:
+        explicit Scope(SkinRepository* repository);
+        ~Scope();
+
+    private:
+        SkinRepository* m_previous;
+    };
+    // Repository of the calling thread, the singleton by default
+    static SkinRepository& current();
+
+    // functions for easy access to childs of the current repository
+    static ColorsModel* colors() { return current().m_colors; }
+    static FontsModel* fonts() { return current().m_fonts; }
+    static ScreensModel* screens() { return current().m_screensModel; }
+    static OutputsModel* outputs() { return &current().m_outputRepository; }
+    static WindowStylesList* styles() { return &current().m_windowStyles; }
+    static BorderStorage* borders() { return &current().m_borders; }
     QSize outputSize() const;
-    inline QDir dir() const { return m_directory; }
+    QDir dir() const;
     QString resolveFilename(const QString& path) const;
 
+    struct ResolveCacheStats
+    {
+        quint64 hits = 0;
+        quint64 misses = 0;
+    };
+    ResolveCacheStats resolveCacheStats() const;
+
     bool open(const QString& path);
     bool save();
     bool saveAs(const QString& path);
@@ -49,14 +79,42 @@ public:
     QString skinFilePath() const;
     QString previewFilePath() const;
 
+    // Binary snapshot of the model stored next to the skin,
+    // used instead of xml parsing while source files are unchanged
+    void setCacheEnabled(bool enabled) { m_cacheEnabled = enabled; }
+    bool isCacheEnabled() const { return m_cacheEnabled; }
+    QString cacheFilePath() const;
+    // Whether the last open() restored the model from the cache
+    bool isLoadedFromCache() const { return m_loadedFromCache; }
+
+    // Batch repositories in worker threads neither load pixmaps nor
+    // register fonts, both need the GUI thread. Set before opening
+    void setHeadless(bool headless) { m_headless = headless; }
+    bool isHeadless() const { return m_headless; }
+
+    // Reload files changed by other programs, off by default
+    void setWatchEnabled(bool enabled);
+    bool isWatchEnabled() const { return m_watchEnabled; }
+    SkinWatcher* watcher() const { return m_watcher; }
+
     QString lastError() const { return m_errorMessage; }
 
 signals:
     void filePathChanged(const QString& path);
 
 private slots:
+    void onDirectoryChanged(const QString& path);
 
 private:
+    void setDirectory(const QDir& dir);
+    QString lookupFilename(const QDir& directory, const QString& path) const;
+    void applyDefaultStyle();
+
+    bool loadCache();
+    bool saveCache() const;
+    QStringList sourceFiles() const;
+    void updateWatcher();
+
     ColorsModel* m_colors;
     ColorRolesModel m_roles;
     BorderStorage m_borders;
@@ -66,6 +124,19 @@ private:
     WindowStylesList m_windowStyles;
     WindowStyle defaultStyle;
     QDir m_directory;
+    bool m_cacheEnabled;
+    bool m_loadedFromCache;
+    bool m_watchEnabled;
+    bool m_headless;
+    SkinWatcher* m_watcher;
+
+    // Resolved file names by the raw path written in the skin,
+    // the mutex also guards m_directory read by worker threads
+    mutable QMutex m_resolveMutex;
+    mutable QHash<QString, QString> m_resolveCache;
+    mutable ResolveCacheStats m_resolveStats;
+    // Bumped when the cache is dropped, lookups started before are not cached
+    quint64 m_resolveGeneration;
 
     // Error handling
     bool setError(const QString& message);
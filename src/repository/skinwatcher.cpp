@@ -0,0 +1,234 @@
+#include "skinwatcher.hpp"
+#include "repository/skinrepository.hpp"
+#include "skin/includefile.hpp"
+#include "base/trace.hpp"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QXmlStreamReader>
+#include <QtConcurrent>
+
+namespace {
+
+const char skinFileName[] = "skin.xml";
+
+QByteArray fileHash(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+} // namespace
+
+SkinWatcher::SkinWatcher(SkinRepository* repository, ScreensModel* model, QObject* parent)
+    : QObject(parent)
+    , m_repository(repository)
+    , m_model(model)
+    , m_watching(false)
+    , m_generation(0)
+    , m_parser(nullptr)
+{
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &SkinWatcher::onFileChanged);
+
+    // Editors may write a file several times while saving
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(200);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &SkinWatcher::reloadNext);
+}
+
+SkinWatcher::~SkinWatcher()
+{
+    // The parser reads through the repository
+    if (m_parser) {
+        m_parser->waitForFinished();
+        qDeleteAll(m_parser->result().items);
+    }
+}
+
+void SkinWatcher::watch()
+{
+    stop();
+    if (!m_repository->isOpened())
+        return;
+
+    m_watching = true;
+    QStringList fileNames = { skinFileName };
+    fileNames.append(m_model->includeFiles());
+    addFiles(fileNames);
+}
+
+void SkinWatcher::stop()
+{
+    m_watching = false;
+    ++m_generation;
+    const QStringList files = m_watcher.files();
+    if (!files.isEmpty()) {
+        m_watcher.removePaths(files);
+    }
+    m_hashes.clear();
+    m_pending.clear();
+    m_reloadTimer.stop();
+}
+
+void SkinWatcher::addFiles(const QStringList& fileNames)
+{
+    const QDir dir = m_repository->dir();
+    const QStringList watched = m_watcher.files();
+    for (const auto& fileName : fileNames) {
+        const QString path = dir.filePath(fileName);
+        if (!m_hashes.contains(fileName)) {
+            m_hashes.insert(fileName, fileHash(path));
+        }
+        if (!watched.contains(path) && QFileInfo::exists(path)) {
+            m_watcher.addPath(path);
+        }
+    }
+}
+
+void SkinWatcher::onFileChanged(const QString& path)
+{
+    if (!m_watching)
+        return;
+
+    // Files replaced by a rename are not watched anymore
+    if (!m_watcher.files().contains(path) && QFileInfo::exists(path)) {
+        m_watcher.addPath(path);
+    }
+    m_pending.insert(m_repository->dir().relativeFilePath(path));
+    m_reloadTimer.start();
+}
+
+void SkinWatcher::reloadNext()
+{
+    // One file at a time, the next one is started when this one is merged
+    if (m_parser || m_pending.isEmpty())
+        return;
+
+    // skin.xml goes first, it may add or drop includes
+    const QString fileName = m_pending.contains(skinFileName) ? skinFileName : *m_pending.cbegin();
+    m_pending.remove(fileName);
+
+    const int generation = m_generation;
+    m_parser = new QFutureWatcher<Result>(this);
+    connect(m_parser, &QFutureWatcher<Result>::finished, this, [this, generation] {
+        Result result = m_parser->result();
+        m_parser->deleteLater();
+        m_parser = nullptr;
+        if (generation == m_generation) {
+            apply(result);
+        } else {
+            qDeleteAll(result.items);
+        }
+        if (!m_pending.isEmpty()) {
+            m_reloadTimer.start();
+        }
+    });
+    m_parser->setFuture(
+      QtConcurrent::run(&SkinWatcher::parse, m_repository, fileName, m_hashes.value(fileName)));
+}
+
+SkinWatcher::Result SkinWatcher::parse(SkinRepository* repository,
+                                       QString fileName,
+                                       QByteArray knownHash)
+{
+    TraceZone zone("repository", "SkinWatcher::parse");
+    zone.setDetail(fileName);
+    // Include files and pixmaps are resolved through the current repository
+    SkinRepository::Scope scope(repository);
+
+    Result result;
+    result.fileName = fileName;
+    const QDir dir = repository->dir();
+    const QString path = dir.filePath(fileName);
+    const QByteArray hash = fileHash(path);
+    result.hashes.insert(fileName, hash);
+    // Written by the editor or touched without changes
+    if (hash == knownHash)
+        return result;
+    result.changed = true;
+
+    if (fileName != skinFileName) {
+        if (!IncludeFile::readScreens(path, result.items, result.error)) {
+            qDeleteAll(result.items);
+            result.items.clear();
+        }
+        return result;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.error = file.errorString();
+        return result;
+    }
+    QXmlStreamReader xml(&file);
+    xml.readNextStartElement();
+    if (xml.name() != "skin") {
+        xml.raiseError(tr("Unknow tag in skin: ") + xml.name());
+    }
+    while (!xml.hasError() && xml.readNextStartElement()) {
+        if (xml.name() == "screen") {
+            auto* screen = new WidgetData();
+            screen->fromXml(xml);
+            result.items.append(screen);
+        } else if (xml.name() == IncludeFile::tag) {
+            auto* include = new IncludeFile();
+            include->fromXml(xml);
+            result.items.append(include);
+            result.hashes.insert(include->fileName(),
+                                 fileHash(dir.filePath(include->fileName())));
+        } else {
+            // Other sections are not reloaded
+            xml.skipCurrentElement();
+        }
+    }
+    if (xml.hasError()) {
+        result.error = xml.errorString();
+        qDeleteAll(result.items);
+        result.items.clear();
+    }
+    return result;
+}
+
+void SkinWatcher::apply(const Result& result)
+{
+    for (auto it = result.hashes.cbegin(); it != result.hashes.cend(); ++it) {
+        m_hashes.insert(it.key(), it.value());
+    }
+    if (!result.changed)
+        return;
+
+    TraceZone zone("repository", "SkinWatcher::apply");
+    zone.setDetail(result.fileName);
+    if (!result.error.isEmpty()) {
+        qWarning() << "Can not reload" << result.fileName << result.error;
+        emit reloadFailed(result.fileName, result.error);
+        return;
+    }
+
+    QModelIndex parent;
+    if (result.fileName != skinFileName) {
+        for (int row = 0; row < m_model->rowCount() && !parent.isValid(); ++row) {
+            const QModelIndex index = m_model->index(row, 0);
+            auto* include = dynamic_cast<const IncludeFile*>(&m_model->widget(index));
+            if (include && include->fileName() == result.fileName) {
+                parent = index;
+            }
+        }
+        // Not included anymore
+        if (!parent.isValid()) {
+            qDeleteAll(result.items);
+            return;
+        }
+    }
+    m_model->mergeChildren(parent, result.items, tr("Reload %1").arg(result.fileName));
+    if (result.fileName == skinFileName) {
+        addFiles(m_model->includeFiles());
+    }
+    emit reloaded(result.fileName);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+class SkinRepository;
+class ScreensModel;
+class WidgetData;
+
+/**
+ * @brief reloads skin files changed by other programs
+ * Only the changed file is parsed again, in the global thread pool, and
+ * merged into the screens model as a single undo step. Files written by
+ * the editor itself are recognized by their content and ignored.
+ *
+ * Only screens and includes are reloaded from skin.xml, changes of
+ * outputs, styles, colors and fonts still need the skin to be reopened.
+ */
+class SkinWatcher : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(SkinWatcher)
+
+public:
+    SkinWatcher(SkinRepository* repository, ScreensModel* model, QObject* parent = Q_NULLPTR);
+    ~SkinWatcher() override;
+
+    // Watch skin.xml and the include files of the current content
+    void watch();
+    void stop();
+    bool isWatching() const { return m_watching; }
+    QStringList watchedFiles() const { return m_watcher.files(); }
+
+signals:
+    // File name is relative to the skin directory
+    void reloaded(const QString& fileName);
+    void reloadFailed(const QString& fileName, const QString& error);
+
+private slots:
+    void onFileChanged(const QString& path);
+    void reloadNext();
+
+private:
+    struct Result
+    {
+        QString fileName;
+        bool changed = false;
+        QString error;
+        // Content hash of every file which was read
+        QHash<QString, QByteArray> hashes;
+        QVector<WidgetData*> items;
+    };
+    static Result parse(SkinRepository* repository, QString fileName, QByteArray knownHash);
+    void apply(const Result& result);
+    void addFiles(const QStringList& fileNames);
+
+    SkinRepository* m_repository;
+    ScreensModel* m_model;
+    bool m_watching;
+    // Results of an older document are dropped
+    int m_generation;
+    // Running parse, there is at most one
+    QFutureWatcher<Result>* m_parser;
+    QFileSystemWatcher m_watcher;
+    // Content known to the model by file name
+    QHash<QString, QByteArray> m_hashes;
+    // Files changed since the last reload
+    QSet<QString> m_pending;
+    QTimer m_reloadTimer;
+};
@@ -1,11 +1,16 @@
 #include "borderview.hpp"
 #include "repository/skinrepository.hpp"
+#include "scene/levelofdetail.hpp"
 #include <QPainter>
+#include <QPainterPath>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
 
 BorderView::BorderView(QGraphicsRectItem* parent)
     : QGraphicsRectItem(parent)
 {
     connect(SkinRepository::borders(), &BorderStorage::changed, this, [this] {
+        invalidate();
         adjust();
         update();
     });
@@ -22,78 +27,131 @@ void BorderView::setInnerRect(const QRectF& innerRect)
 
 void BorderView::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget)
 {
-    auto draw = [&](const QPointF position, const QSizeF size, const QPixmap& pixmap) {
-        // qDebug() << "draw:" << pos << size;
-        painter->drawPixmap(QRectF(position, size), pixmap, QRectF(QPointF(0, 0), size));
-    };
+    // Zoomed out the frame is a plain rect, tiled strips are neither rendered nor scaled
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+    if (lod < LevelOfDetail::current().plainBorders) {
+        QPainterPath frame;
+        frame.addRect(rect());
+        frame.addRect(m_rect);
+        painter->fillPath(frame, QColor(128, 128, 128, 160));
+        QGraphicsRectItem::paint(painter, option, widget);
+        return;
+    }
+
+    updateCache();
 
     auto& borders = *SkinRepository::borders();
+    const QRectF r = rect();
 
+    painter->drawPixmap(r.topLeft(), m_top);
+    painter->drawPixmap(QPointF(r.left(), r.bottom() - m_bottom.height()), m_bottom);
+    painter->drawPixmap(QPointF(r.left(), r.top() + borders[bp::bpTopLeft].height()), m_left);
+    painter->drawPixmap(QPointF(m_rect.right(), r.top() + borders[bp::bpTopRight].height()),
+                        m_right);
+
+    QGraphicsRectItem::paint(painter, option, widget);
+}
+
+void BorderView::adjust()
+{
+    auto& borders = *SkinRepository::borders();
+    auto t = qMax(borders[bp::bpTop].height(),
+                  qMax(borders[bp::bpTopRight].height(), borders[bp::bpTopLeft].height()));
+    auto b = qMax(borders[bp::bpBottom].height(),
+                  qMax(borders[bp::bpBottomRight].height(), borders[bp::bpBottomLeft].height()));
+    setRect(m_rect.adjusted(-borders[bp::bpLeft].width(), -t, borders[bp::bpRight].width(), b));
+}
+
+void BorderView::invalidate()
+{
+    m_top = QPixmap();
+    m_bottom = QPixmap();
+    m_left = QPixmap();
+    m_right = QPixmap();
+}
+
+/**
+ * @brief Rebuild frame pieces whose size does not match the current rect
+ * During a resize only the strips along the changed dimension are rendered again.
+ */
+void BorderView::updateCache()
+{
+    auto& borders = *SkinRepository::borders();
     const QRectF r = rect();
-    qreal x = r.left();
-    qreal xm = r.right();
-    const qreal t = m_rect.top() - r.top();
-
-    if (auto& px = borders[bp::bpTopLeft]; !px.isNull()) {
-        auto sz = QSizeF(px.size()).boundedTo(QSizeF(xm - x, t));
-        //        qDebug() << sz;
-        draw(r.topLeft(), sz, px);
-        x += sz.width();
+    const int width = qCeil(r.width());
+
+    const QSize topSize(width, qCeil(m_rect.top() - r.top()));
+    if (m_top.size() != topSize) {
+        m_top = renderHorizontal(topSize, bp::bpTopLeft, bp::bpTop, bp::bpTopRight, false);
     }
-    if (auto& px = borders[bp::bpTopRight]; !px.isNull()) {
-        auto sz = QSizeF(px.size()).boundedTo(QSizeF(xm - x, t));
-        xm -= sz.width();
-        draw(QPointF(xm, r.top()), sz, px);
+    const QSize bottomSize(width, qCeil(r.bottom() - m_rect.bottom()));
+    if (m_bottom.size() != bottomSize) {
+        m_bottom = renderHorizontal(
+          bottomSize, bp::bpBottomLeft, bp::bpBottom, bp::bpBottomRight, true);
     }
-    if (auto& px = borders[bp::bpTop]; !px.isNull()) {
-        if (xm > x) {
-            painter->drawTiledPixmap(QRectF(x, r.top(), xm - x, px.height()), px);
-        }
+
+    const qreal leftHeight = r.height() - borders[bp::bpTopLeft].height()
+                             - borders[bp::bpBottomLeft].height();
+    const QSize leftSize(qCeil(m_rect.left() - r.left()), qCeil(leftHeight));
+    if (m_left.size() != leftSize) {
+        m_left = renderVertical(leftSize, bp::bpLeft);
     }
+    const qreal rightHeight = r.height() - borders[bp::bpTopRight].height()
+                              - borders[bp::bpBottomRight].height();
+    const QSize rightSize(qCeil(r.right() - m_rect.right()), qCeil(rightHeight));
+    if (m_right.size() != rightSize) {
+        m_right = renderVertical(rightSize, bp::bpRight);
+    }
+}
 
-    x = r.left();
-    xm = r.right();
-    const qreal b = r.bottom() - m_rect.bottom();
+QPixmap BorderView::renderHorizontal(const QSize& size,
+                                     bp left,
+                                     bp edge,
+                                     bp right,
+                                     bool alignBottom) const
+{
+    if (size.isEmpty())
+        return QPixmap();
 
-    if (auto& px = borders[bp::bpBottomLeft]; !px.isNull()) {
-        auto sz = QSizeF(px.size()).boundedTo(QSizeF(xm - x, b));
-        draw(QPointF(x, r.bottom() - sz.height()), sz, px);
+    auto& borders = *SkinRepository::borders();
+    QPixmap strip(size);
+    strip.fill(Qt::transparent);
+    QPainter painter(&strip);
+
+    auto top = [&](int height) { return alignBottom ? size.height() - height : 0; };
+    auto draw = [&](int x, const QSize& sz, const QPixmap& pixmap) {
+        painter.drawPixmap(QRect(QPoint(x, top(sz.height())), sz), pixmap, QRect(QPoint(0, 0), sz));
+    };
+
+    int x = 0;
+    int xm = size.width();
+    if (auto& px = borders[left]; !px.isNull()) {
+        auto sz = px.size().boundedTo(QSize(xm - x, size.height()));
+        draw(x, sz, px);
         x += sz.width();
     }
-    if (auto& px = borders[bp::bpBottomRight]; !px.isNull()) {
-        auto sz = QSizeF(px.size()).boundedTo(QSizeF(xm - x, b));
+    if (auto& px = borders[right]; !px.isNull()) {
+        auto sz = px.size().boundedTo(QSize(xm - x, size.height()));
         xm -= sz.width();
-        draw(QPointF(xm, r.bottom() - sz.height()), sz, px);
+        draw(xm, sz, px);
     }
-    if (auto& px = borders[bp::bpBottom]; !px.isNull()) {
+    if (auto& px = borders[edge]; !px.isNull()) {
         if (xm > x) {
-            painter->drawTiledPixmap(QRectF(x, r.bottom() - px.height(), xm - x, px.height()), px);
+            painter.drawTiledPixmap(QRect(x, top(px.height()), xm - x, px.height()), px);
         }
     }
-
-    if (auto& px = borders[bp::bpLeft]; !px.isNull()) {
-        auto y = r.top() + borders[bp::bpTopLeft].height();
-        auto ym = r.bottom() - borders[bp::bpBottomLeft].height();
-        QRectF target(QPointF(r.left(), y), QPointF(m_rect.left(), ym));
-        painter->drawTiledPixmap(target, px);
-    }
-
-    if (auto& px = borders[bp::bpRight]; !px.isNull()) {
-        auto y = r.top() + borders[bp::bpTopRight].height();
-        auto ym = r.bottom() - borders[bp::bpBottomRight].height();
-        QRectF target(QPointF(m_rect.right(), y), QPointF(r.right(), ym));
-        painter->drawTiledPixmap(target, px);
-    }
-
-    QGraphicsRectItem::paint(painter, option, widget);
+    return strip;
 }
 
-void BorderView::adjust()
+QPixmap BorderView::renderVertical(const QSize& size, bp edge) const
 {
-    auto& borders = *SkinRepository::borders();
-    auto t = qMax(borders[bp::bpTop].height(),
-                  qMax(borders[bp::bpTopRight].height(), borders[bp::bpTopLeft].height()));
-    auto b = qMax(borders[bp::bpBottom].height(),
-                  qMax(borders[bp::bpBottomRight].height(), borders[bp::bpBottomLeft].height()));
-    setRect(m_rect.adjusted(-borders[bp::bpLeft].width(), -t, borders[bp::bpRight].width(), b));
+    auto& px = (*SkinRepository::borders())[edge];
+    if (size.isEmpty() || px.isNull())
+        return QPixmap();
+
+    QPixmap strip(size);
+    strip.fill(Qt::transparent);
+    QPainter painter(&strip);
+    painter.drawTiledPixmap(QRect(QPoint(0, 0), size), px);
+    return strip;
 }
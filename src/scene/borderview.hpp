@@ -2,6 +2,7 @@
 
 #include "model/bordersmodel.hpp"
 #include <QGraphicsRectItem>
+#include <QPixmap>
 
 class BorderView : public QObject, public QGraphicsRectItem
 {
@@ -19,5 +20,18 @@ public:
 
 private:
     void adjust();
+    void invalidate();
+    void updateCache();
+    QPixmap renderHorizontal(const QSize& size, bp left, bp edge, bp right, bool alignBottom) const;
+    QPixmap renderVertical(const QSize& size, bp edge) const;
+
     QRectF m_rect;
+
+    // Frame pieces assembled for the current style and size.
+    // Top and bottom strips include corners and only depend on the width,
+    // left and right strips only depend on the height.
+    QPixmap m_top;
+    QPixmap m_bottom;
+    QPixmap m_left;
+    QPixmap m_right;
 };
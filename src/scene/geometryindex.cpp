@@ -0,0 +1,308 @@
+#include "geometryindex.hpp"
+#include "model/screensmodel.hpp"
+#include "base/trace.hpp"
+#include <algorithm>
+
+GeometryIndex::GeometryIndex(ScreensModel* model, QObject* parent)
+    : QObject(parent)
+    , m_model(model)
+    , m_screenId(UniqueId::invalid)
+{
+    connect(m_model, &ScreensModel::widgetChanged, this, &GeometryIndex::onWidgetChanged);
+    connect(m_model, &ScreensModel::widgetsChanged, this, &GeometryIndex::onWidgetsChanged);
+    connect(m_model, &ScreensModel::rowsInserted, this, &GeometryIndex::onRowsInserted);
+    connect(m_model,
+            &ScreensModel::rowsAboutToBeRemoved,
+            this,
+            &GeometryIndex::onRowsAboutToBeRemoved);
+    // Moves are rare, the affected screens are simply indexed again
+    connect(m_model, &ScreensModel::rowsMoved, this, &GeometryIndex::rebuild);
+    connect(m_model, &ScreensModel::modelReset, this, &GeometryIndex::rebuild);
+}
+
+void GeometryIndex::setScreen(uint id)
+{
+    m_screenId = id;
+    rebuild();
+}
+
+void GeometryIndex::rebuild()
+{
+    TRACE_ZONE("scene", "GeometryIndex::rebuild");
+    clear();
+
+    const WidgetData* screen = m_model->widgetById(m_screenId);
+    if (!screen)
+        return;
+    screen->updateLayout();
+    m_screenRect = QRect(QPoint(0, 0), screen->selfSize());
+    addEdges(m_screenId, m_screenRect);
+    for (int i = 0; i < screen->childCount(); ++i) {
+        insertTree(*screen->child(i), QPoint(0, 0));
+    }
+}
+
+QRect GeometryIndex::rect(uint id) const
+{
+    return id == m_screenId ? m_screenRect : m_rects.value(id);
+}
+
+QVector<uint> GeometryIndex::intersecting(const QRect& area) const
+{
+    return m_grid.query(area);
+}
+
+QVector<uint> GeometryIndex::contained(const QRect& area) const
+{
+    QVector<uint> result = m_grid.query(area);
+    result.erase(std::remove_if(result.begin(),
+                                result.end(),
+                                [&](uint id) { return !area.contains(m_rects.value(id)); }),
+                 result.end());
+    return result;
+}
+
+QVector<uint> GeometryIndex::at(const QPoint& point) const
+{
+    return m_grid.query(QRect(point, QSize(1, 1)));
+}
+
+QVector<uint> GeometryIndex::overlapping(uint id) const
+{
+    if (!m_rects.contains(id))
+        return {};
+
+    QVector<uint> result = m_grid.query(m_rects.value(id));
+    result.erase(std::remove_if(result.begin(),
+                                result.end(),
+                                [&](uint other) { return isRelated(id, other); }),
+                 result.end());
+    return result;
+}
+
+GeometryIndex::Snap GeometryIndex::snap(const QRect& rect,
+                                        int edges,
+                                        int tolerance,
+                                        const QSet<uint>& exclude) const
+{
+    struct Axis
+    {
+        const EdgeMap& map;
+        int values[3];
+        int flags[3];
+    };
+    // Right and bottom edges are exclusive, so adjacent widgets share them
+    const Axis axes[2] = {
+        { m_xEdges,
+          { rect.x(), rect.x() + rect.width() / 2, rect.x() + rect.width() },
+          { SnapLeft, SnapHCenter, SnapRight } },
+        { m_yEdges,
+          { rect.y(), rect.y() + rect.height() / 2, rect.y() + rect.height() },
+          { SnapTop, SnapVCenter, SnapBottom } },
+    };
+
+    Snap result;
+    for (int a = 0; a < 2; ++a) {
+        const Axis& axis = axes[a];
+
+        // Nearest edge of any widget around any of the edges of the rect
+        bool found = false;
+        int delta = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (!(edges & axis.flags[i]))
+                continue;
+            const int value = axis.values[i];
+            for (auto it = axis.map.lowerBound(value - tolerance);
+                 it != axis.map.end() && it.key() <= value + tolerance;
+                 ++it) {
+                const int d = it.key() - value;
+                if ((!found || qAbs(d) < qAbs(delta)) && !isExcluded(it.value(), exclude)) {
+                    found = true;
+                    delta = d;
+                }
+            }
+        }
+        if (!found)
+            continue;
+
+        // One guide per aligned edge, spanning the rect and the widgets it is aligned to
+        for (int i = 0; i < 3; ++i) {
+            if (!(edges & axis.flags[i]))
+                continue;
+            const int value = axis.values[i] + delta;
+            int from = a == 0 ? rect.top() : rect.left();
+            int to = a == 0 ? rect.bottom() : rect.right();
+            bool aligned = false;
+            for (auto it = axis.map.constFind(value); it != axis.map.cend() && it.key() == value;
+                 ++it) {
+                if (isExcluded(it.value(), exclude))
+                    continue;
+                const QRect other = this->rect(it.value());
+                from = qMin(from, a == 0 ? other.top() : other.left());
+                to = qMax(to, a == 0 ? other.bottom() : other.right());
+                aligned = true;
+            }
+            if (aligned) {
+                result.lines.append(a == 0 ? QLine(value, from, value, to)
+                                           : QLine(from, value, to, value));
+            }
+        }
+        if (a == 0) {
+            result.offset.setX(delta);
+        } else {
+            result.offset.setY(delta);
+        }
+    }
+    return result;
+}
+
+void GeometryIndex::onWidgetChanged(uint id, int key)
+{
+    if (key != Property::position && key != Property::size)
+        return;
+    if (!contains(id))
+        return;
+
+    if (id == m_screenId) {
+        if (key == Property::size) {
+            // Relative geometry of everything depends on the screen size
+            rebuild();
+        }
+        return;
+    }
+    // Children follow their parent, relative ones are resized with it
+    const WidgetData& widget = *m_model->widgetById(id);
+    insertTree(widget, parentOffset(widget));
+}
+
+void GeometryIndex::onWidgetsChanged(const QVector<QPair<uint, int>>& changes)
+{
+    for (const auto& change : changes) {
+        onWidgetChanged(change.first, change.second);
+    }
+}
+
+void GeometryIndex::onRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    const uint parentId = m_model->idFromIndex(parent);
+    if (!contains(parentId)) {
+        for (int i = first; i <= last; ++i) {
+            if (m_model->idFromIndex(m_model->index(i, 0, parent)) == m_screenId) {
+                // Our screen is back after undo
+                rebuild();
+            }
+        }
+        return;
+    }
+
+    const WidgetData& data = m_model->widget(parent);
+    const QPoint offset = rect(parentId).topLeft();
+    for (int i = first; i <= last; ++i) {
+        insertTree(*data.child(i), offset);
+    }
+}
+
+void GeometryIndex::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    const uint parentId = m_model->idFromIndex(parent);
+    if (contains(parentId)) {
+        const WidgetData& data = m_model->widget(parent);
+        for (int i = first; i <= last; ++i) {
+            removeTree(*data.child(i));
+        }
+        return;
+    }
+    for (int i = first; i <= last; ++i) {
+        if (m_model->idFromIndex(m_model->index(i, 0, parent)) == m_screenId) {
+            // Our screen goes away, it may come back on undo
+            clear();
+        }
+    }
+}
+
+bool GeometryIndex::isExcluded(uint id, const QSet<uint>& exclude) const
+{
+    const WidgetData* w = m_model->widgetById(id);
+    while (w) {
+        if (exclude.contains(w->id()))
+            return true;
+        if (w->id() == m_screenId || !w->isChild())
+            return false;
+        w = w->parent()->self();
+    }
+    return false;
+}
+
+bool GeometryIndex::isRelated(uint a, uint b) const
+{
+    return isExcluded(a, { b }) || isExcluded(b, { a });
+}
+
+void GeometryIndex::insertTree(const WidgetData& widget, const QPoint& offset)
+{
+    const uint id = widget.id();
+    const QRect r(offset + widget.absolutePosition(), widget.selfSize());
+    auto it = m_rects.find(id);
+    if (it != m_rects.end()) {
+        removeEdges(id, *it);
+        *it = r;
+    } else {
+        m_rects.insert(id, r);
+    }
+    m_grid.insert(id, r);
+    addEdges(id, r);
+    for (int i = 0; i < widget.childCount(); ++i) {
+        insertTree(*widget.child(i), r.topLeft());
+    }
+}
+
+void GeometryIndex::removeTree(const WidgetData& widget)
+{
+    const uint id = widget.id();
+    auto it = m_rects.find(id);
+    if (it != m_rects.end()) {
+        removeEdges(id, *it);
+        m_rects.erase(it);
+        m_grid.remove(id);
+    }
+    for (int i = 0; i < widget.childCount(); ++i) {
+        removeTree(*widget.child(i));
+    }
+}
+
+void GeometryIndex::clear()
+{
+    m_grid.clear();
+    m_rects.clear();
+    m_xEdges.clear();
+    m_yEdges.clear();
+    m_screenRect = QRect();
+}
+
+void GeometryIndex::addEdges(uint id, const QRect& rect)
+{
+    m_xEdges.insert(rect.x(), id);
+    m_xEdges.insert(rect.x() + rect.width() / 2, id);
+    m_xEdges.insert(rect.x() + rect.width(), id);
+    m_yEdges.insert(rect.y(), id);
+    m_yEdges.insert(rect.y() + rect.height() / 2, id);
+    m_yEdges.insert(rect.y() + rect.height(), id);
+}
+
+void GeometryIndex::removeEdges(uint id, const QRect& rect)
+{
+    m_xEdges.remove(rect.x(), id);
+    m_xEdges.remove(rect.x() + rect.width() / 2, id);
+    m_xEdges.remove(rect.x() + rect.width(), id);
+    m_yEdges.remove(rect.y(), id);
+    m_yEdges.remove(rect.y() + rect.height() / 2, id);
+    m_yEdges.remove(rect.y() + rect.height(), id);
+}
+
+QPoint GeometryIndex::parentOffset(const WidgetData& widget) const
+{
+    if (!widget.isChild())
+        return QPoint();
+    const uint parentId = widget.parent()->self()->id();
+    return parentId == m_screenId ? QPoint(0, 0) : rect(parentId).topLeft();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "base/uniqueid.hpp"
+#include "scene/spatialgrid.hpp"
+#include <QLine>
+#include <QMultiMap>
+#include <QObject>
+#include <QSet>
+
+class ScreensModel;
+class WidgetData;
+
+/**
+ * @brief geometry of all widgets of one screen in screen coordinates
+ * Follows position and size changes of the model. Rects are kept in a
+ * uniform grid for area queries, edges in sorted maps for snapping.
+ */
+class GeometryIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum SnapEdge
+    {
+        SnapLeft = 0x1,
+        SnapHCenter = 0x2,
+        SnapRight = 0x4,
+        SnapTop = 0x8,
+        SnapVCenter = 0x10,
+        SnapBottom = 0x20,
+        SnapAll = 0x3f
+    };
+
+    struct Snap
+    {
+        // Offset to apply to the snapped rect
+        QPoint offset;
+        // Guide lines in screen coordinates
+        QVector<QLine> lines;
+    };
+
+    explicit GeometryIndex(ScreensModel* model, QObject* parent = nullptr);
+
+    uint screenId() const { return m_screenId; }
+    void setScreen(uint id);
+    void rebuild();
+
+    bool contains(uint id) const
+    {
+        return id != UniqueId::invalid && (id == m_screenId || m_rects.contains(id));
+    }
+    // Widget rect relative to the screen, the screen itself is at 0,0
+    QRect rect(uint id) const;
+    // Number of indexed widgets, without the screen
+    int size() const { return m_rects.size(); }
+
+    QVector<uint> intersecting(const QRect& area) const;
+    QVector<uint> contained(const QRect& area) const;
+    QVector<uint> at(const QPoint& point) const;
+    // Widgets overlapping the given one, except its ancestors and descendants
+    QVector<uint> overlapping(uint id) const;
+
+    /**
+     * @brief Align the given edges of the rect to edges of other widgets
+     * Widgets in @p exclude and their descendants are ignored. Each axis
+     * snaps to the nearest edge within the tolerance independently.
+     */
+    Snap snap(const QRect& rect, int edges, int tolerance, const QSet<uint>& exclude) const;
+
+private slots:
+    void onWidgetChanged(uint id, int key);
+    void onWidgetsChanged(const QVector<QPair<uint, int>>& changes);
+    void onRowsInserted(const QModelIndex& parent, int first, int last);
+    void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+
+private:
+    using EdgeMap = QMultiMap<int, uint>;
+
+    void clear();
+    bool isExcluded(uint id, const QSet<uint>& exclude) const;
+    bool isRelated(uint a, uint b) const;
+    // Add or update the widget and all its children
+    void insertTree(const WidgetData& widget, const QPoint& offset);
+    void removeTree(const WidgetData& widget);
+    void addEdges(uint id, const QRect& rect);
+    void removeEdges(uint id, const QRect& rect);
+    // Absolute position of the widget's parent in the screen
+    QPoint parentOffset(const WidgetData& widget) const;
+
+    ScreensModel* m_model;
+    uint m_screenId;
+    QRect m_screenRect;
+    QHash<uint, QRect> m_rects;
+    SpatialGrid m_grid;
+    // left, horizontal center and right edges
+    EdgeMap m_xEdges;
+    // top, vertical center and bottom edges
+    EdgeMap m_yEdges;
+};
@@ -0,0 +1,35 @@
+#include "levelofdetail.hpp"
+#include <QCoreApplication>
+#include <QSettings>
+
+namespace {
+
+LevelOfDetail load()
+{
+    LevelOfDetail lod;
+    QSettings settings(QCoreApplication::organizationName(), QCoreApplication::applicationName());
+    settings.beginGroup("levelOfDetail");
+    lod.textBars = settings.value("textBars", lod.textBars).toReal();
+    lod.mipmaps = settings.value("mipmaps", lod.mipmaps).toReal();
+    lod.plainBorders = settings.value("plainBorders", lod.plainBorders).toReal();
+    settings.endGroup();
+    return lod;
+}
+
+LevelOfDetail& instance()
+{
+    static LevelOfDetail lod = load();
+    return lod;
+}
+
+} // namespace
+
+const LevelOfDetail& LevelOfDetail::current()
+{
+    return instance();
+}
+
+void LevelOfDetail::reload()
+{
+    instance() = load();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * @brief scene scale thresholds for simplified painting
+ * Below a threshold the scene paints a cheaper approximation,
+ * values are read from the "levelOfDetail" settings group.
+ */
+struct LevelOfDetail
+{
+    // Text is drawn as filled bars
+    qreal textBars = 0.35;
+    // Pixmaps are drawn from downscaled mipmaps
+    qreal mipmaps = 0.75;
+    // Frame pixmaps are replaced with plain rects
+    qreal plainBorders = 0.5;
+
+    static const LevelOfDetail& current();
+    // Re-read the settings, e.g. after they were edited
+    static void reload();
+};
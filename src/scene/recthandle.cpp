@@ -72,6 +72,10 @@ void RectHandle::mousePressEvent(QGraphicsSceneMouseEvent* event)
     if (event->button() == Qt::LeftButton) {
         event->accept();
         is_moving = true;
+        auto parent = dynamic_cast<ResizableGraphicsRectItem*>(parentItem());
+        if (parent) {
+            parent->startResize();
+        }
     } else {
         return QGraphicsRectItem::mousePressEvent(event);
     }
@@ -96,8 +100,25 @@ void RectHandle::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
     if (event->button() == Qt::LeftButton) {
         event->accept();
+        auto parent = dynamic_cast<ResizableGraphicsRectItem*>(parentItem());
+        if (is_moving && parent) {
+            parent->finishResize();
+        }
         is_moving = false;
     } else {
         return QGraphicsRectItem::mouseReleaseEvent(event);
     }
 }
+
+void RectHandle::ungrabMouseEvent(QEvent* event)
+{
+    // Grab lost without a release, finish the resize anyway
+    if (is_moving) {
+        is_moving = false;
+        auto parent = dynamic_cast<ResizableGraphicsRectItem*>(parentItem());
+        if (parent) {
+            parent->finishResize();
+        }
+    }
+    QGraphicsRectItem::ungrabMouseEvent(event);
+}
@@ -28,6 +28,7 @@ void ResizableGraphicsRectItem::setHandlesVisible(bool visible)
 
 void ResizableGraphicsRectItem::resizeRect(QPointF p, int handle)
 {
+    p = snapHandlePoint(p, handle);
     QRectF newRect = rect();
     // Depending on active handle resize rect accordingly
     // Ensure that left <= right and top <= bottom
@@ -12,12 +12,20 @@ public:
 
     /// To be called from ::RectHandle::mouseMoveEvent
     void resizeRect(QPointF p, int handle);
+    /// To be called from ::RectHandle press and release events
+    void startResize() { resizeStartedEvent(); }
+    void finishResize() { resizeFinishedEvent(); }
 
 protected:
     void setXanchor(Coordinate::Type anchor) { m_xanchor = anchor; }
     void setYanchor(Coordinate::Type anchor) { m_yanchor = anchor; }
     void updateHandlesPos();
     virtual void resizeRectEvent(const QRectF& r);
+    // Adjust the point a handle is dragged to, e.g. to align it with other items
+    virtual QPointF snapHandlePoint(const QPointF& p, int /*handle*/) { return p; }
+    // Bracket a sequence of resizeRectEvent() calls made by dragging a handle
+    virtual void resizeStartedEvent() {}
+    virtual void resizeFinishedEvent() {}
 
 private:
     // QGraphicsItem owned
@@ -1,4 +1,5 @@
 #include "sceneview.hpp"
+#include "screenview.hpp"
 
 #include <QWheelEvent>
 
@@ -20,7 +21,33 @@ void SceneView::wheelEvent(QWheelEvent* event)
         }
         scale(factor, factor);
         setTransformationAnchor(anchor);
+        updateVisibleRect();
     } else {
         QGraphicsView::wheelEvent(event);
     }
 }
+
+void SceneView::resizeEvent(QResizeEvent* event)
+{
+    QGraphicsView::resizeEvent(event);
+    updateVisibleRect();
+}
+
+void SceneView::showEvent(QShowEvent* event)
+{
+    QGraphicsView::showEvent(event);
+    updateVisibleRect();
+}
+
+void SceneView::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    updateVisibleRect();
+}
+
+void SceneView::updateVisibleRect()
+{
+    if (auto* skinScene = qobject_cast<SkinScene*>(scene())) {
+        skinScene->setVisibleRect(mapToScene(viewport()->rect()).boundingRect());
+    }
+}
@@ -10,4 +10,12 @@ public:
 protected:
     // QWidget interface
     void wheelEvent(QWheelEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    // QAbstractScrollArea interface
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    // Tell the scene which part of it is shown
+    void updateVisibleRect();
 };
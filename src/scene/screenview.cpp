@@ -3,8 +3,12 @@
 #include "foregroundwidget.hpp"
 #include "repository/skinrepository.hpp"
 #include "base/flagsetter.hpp"
+#include "base/trace.hpp"
 #include <QCoreApplication>
 #include <QGraphicsPixmapItem>
+#include <QSet>
+#include <algorithm>
+#include <limits>
 
 QModelIndex normalizeIndex(const QModelIndex& index)
 {
@@ -80,6 +84,16 @@ void SkinScene::setSelectionModel(QItemSelectionModel* model)
     }
 }
 
+void SkinScene::setVisibleRect(const QRectF& rect)
+{
+    if (rect == m_visibleRect)
+        return;
+    m_visibleRect = rect;
+    for (const auto& s : m_screens) {
+        s->setVisibleRect(rect);
+    }
+}
+
 void SkinScene::displayBorders(bool display)
 {
     for (const auto& s : m_screens) {
@@ -139,8 +153,6 @@ void SkinScene::addScreenRecursive(QModelIndex index)
             == static_cast<int>(WidgetData::WidgetType::Panel)) {
             auto panel = child.data(ScreensModel::PanelIndexRole).toModelIndex();
             if (panel.isValid()) {
-                qDebug() << panel.data(ScreensModel::TypeRole)
-                         << m_model->widgetAttr(panel, Property::name);
                 addScreenRecursive(normalizeIndex(panel));
             }
         }
@@ -151,13 +163,17 @@ void SkinScene::addScreenRecursive(QModelIndex index)
 
 ScreenView::ScreenView(ScreensModel* model, QModelIndex index, SkinScene* scene)
     : m_model(model)
-    , m_root(index)
     , m_scene(scene)
     , m_selectionModel(nullptr)
+    , m_rootId(UniqueId::invalid)
     , m_disableSelectionSlots(false)
+    , m_geometry(model)
+    , m_visibleRect(scene->visibleRect())
+    , m_snapLines(nullptr)
     , m_showBorders(true)
 {
     connect(m_model, &ScreensModel::widgetChanged, this, &ScreenView::onWidgetChanged);
+    connect(m_model, &ScreensModel::widgetsChanged, this, &ScreenView::onWidgetsChanged);
     connect(m_model,
             &ScreensModel::rowsAboutToBeRemoved,
             this,
@@ -165,16 +181,20 @@ ScreenView::ScreenView(ScreensModel* model, QModelIndex index, SkinScene* scene)
     connect(m_model, &ScreensModel::rowsAboutToBeMoved, this, &ScreenView::onRowsAboutToBeMoved);
     connect(m_model, &ScreensModel::rowsMoved, this, &ScreenView::onRowsMoved);
     connect(m_model, &ScreensModel::rowsInserted, this, &ScreenView::onRowsInserted);
+    connect(m_model,
+            &ScreensModel::modelAboutToBeReset,
+            this,
+            &ScreenView::onModelAboutToBeReset);
     connect(m_model, &ScreensModel::modelReset, this, &ScreenView::onModelReset);
 
     connect(m_scene, &QGraphicsScene::selectionChanged, this, &ScreenView::onSceneSelectionChanged);
 
-    setScreen(m_root);
+    setScreen(index);
 }
 
 ScreenView::~ScreenView()
 {
-    auto it = m_widgets.find(m_root);
+    auto it = m_widgets.find(m_rootId);
     if (it != m_widgets.end()) {
         WidgetGraphicsItem* screen = *it;
         // All child WidgetGraphicsItems will be removed recursively from scene
@@ -192,15 +212,28 @@ QItemSelection ScreenView::makeRowSelection(const QModelIndex& index)
 
 void ScreenView::setScreen(QModelIndex index)
 {
+    TRACE_ZONE("scene", "ScreenView::setScreen");
     Q_ASSERT(index.data(ScreensModel::TypeRole).toInt()
              == static_cast<int>(WidgetData::WidgetType::Screen));
 
     //    if (m_root == index)
     //        return;
 
-    qDebug() << "to delete:" << m_widgets.size();
+    clearItems();
+
+    m_rootId = m_model->idFromIndex(index);
+    auto* screen = new WidgetGraphicsItem(this, m_rootId, nullptr);
+    m_widgets[m_rootId] = screen;
+    m_scene->addItem(screen);
+
+    // Items are created for the visible widgets only
+    m_geometry.setScreen(m_rootId);
+    updateVisibleItems();
+}
 
-    WidgetGraphicsItem* oldScreen = m_widgets[m_root];
+void ScreenView::clearItems()
+{
+    WidgetGraphicsItem* oldScreen = m_widgets.value(m_rootId);
     if (oldScreen) {
         // All items must be childs of the oldScreen
         m_scene->removeItem(oldScreen);
@@ -208,17 +241,14 @@ void ScreenView::setScreen(QModelIndex index)
         m_scene->clearSelection();
     }
     m_widgets.clear();
+    m_pool.clear();
+    m_snapLines = nullptr;
+}
 
-    m_root = normalizeIndex(index);
-    auto* screen = new WidgetGraphicsItem(this, m_root, nullptr);
-    m_widgets[m_root] = screen;
-    m_scene->addItem(screen);
-
-    for (int i = 0; i < m_model->rowCount(m_root); ++i) {
-        QModelIndex widgetIndex = m_model->index(i, ScreensModel::ColumnElement, m_root);
-        Q_ASSERT(!m_widgets.contains(widgetIndex));
-        m_widgets[widgetIndex] = new WidgetGraphicsItem(this, widgetIndex, screen);
-    }
+void ScreenView::setVisibleRect(const QRectF& rect)
+{
+    m_visibleRect = rect;
+    updateVisibleItems();
 }
 
 void ScreenView::setSelectionModel(QItemSelectionModel* model)
@@ -255,17 +285,14 @@ void ScreenView::setSelectionModel(QItemSelectionModel* model)
 
 void ScreenView::deleteSelected()
 {
-    // I only delete last clicked one
-    if (m_scene->selectedItems().isEmpty())
-        return;
-    QGraphicsItem* item = m_scene->selectedItems().last();
-    auto w = qgraphicsitem_cast<WidgetGraphicsItem*>(item);
-    if (w) {
-        QModelIndex i = w->modelIndex();
-        m_model->removeRow(i.row(), i.parent());
-    } else {
-        qWarning() << "garbage selected";
+    QModelIndexList indexes;
+    for (auto* item : m_scene->selectedItems()) {
+        auto w = qgraphicsitem_cast<WidgetGraphicsItem*>(item);
+        if (w) {
+            indexes.append(w->modelIndex());
+        }
     }
+    m_model->removeWidgets(indexes);
 }
 
 void ScreenView::displayBorders(bool display)
@@ -274,37 +301,59 @@ void ScreenView::displayBorders(bool display)
     for (const auto& widget : m_widgets) {
         widget->showBorder(display);
     }
+    for (auto* widget : qAsConst(m_pool)) {
+        widget->showBorder(display);
+    }
 }
 
-void ScreenView::onWidgetChanged(const QModelIndex& index, int key)
+void ScreenView::onWidgetChanged(uint id, int key)
 {
-    auto it = m_widgets.find(index);
+    auto it = m_widgets.find(id);
     if (it != m_widgets.end()) {
         (*it)->updateAttribute(key);
     }
+
+    // The geometry index has already seen the change
+    if (key != Property::position && key != Property::size)
+        return;
+    if (id == m_rootId && key == Property::size) {
+        // Relative geometry of all children depends on the screen size
+        updateVisibleItems();
+    } else if (isRootChild(id)) {
+        if (!m_widgets.contains(id) && isInView(id) && acquireItem(id)) {
+            restackItems();
+        }
+    }
+}
+
+void ScreenView::onWidgetsChanged(const QVector<QPair<uint, int>>& changes)
+{
+    for (const auto& change : changes) {
+        onWidgetChanged(change.first, change.second);
+    }
 }
 
 /**
- * @brief Check if @p index is equal to or is child of @a m_root
+ * @brief Check if @p index is equal to or is child of our root screen
  * @param index
  * @return
  */
 bool ScreenView::belongsToRoot(QModelIndex index) const
 {
-    while (index.isValid() && !(index == m_root)) {
+    while (index.isValid() && m_model->idFromIndex(index) != m_rootId) {
         index = index.parent();
     }
     return index.isValid();
 }
 
 /**
- * @brief Check if @p index is a parent of @a m_root
+ * @brief Check if @p index is a parent of our root screen
  * @param index
  * @return
  */
 bool ScreenView::containsOurRoot(const QModelIndex& index, int first, int last) const
 {
-    QModelIndex root = m_root;
+    QModelIndex root = rootIndex();
     while (root.isValid()) {
         QModelIndex parent = root.parent();
         if (parent == index) {
@@ -321,11 +370,13 @@ void ScreenView::onRowsAboutToBeRemoved(const QModelIndex& parent, int first, in
 {
     if (containsOurRoot(parent, first, last)) {
         // our root is one of the deleted elements
-        WidgetGraphicsItem* screen = m_widgets[m_root];
+        WidgetGraphicsItem* screen = m_widgets.value(m_rootId);
         if (screen) {
             m_scene->removeItem(screen);
             delete screen;
             m_widgets.clear();
+            m_pool.clear();
+            m_snapLines = nullptr;
         }
     } else {
         // part of our screen's children will be removed
@@ -362,14 +413,13 @@ void ScreenView::removeChildren(const QModelIndex& parent, int first, int last)
 {
     if (belongsToRoot(parent)) {
         // rely on our map
+        const WidgetData& data = m_model->widget(parent);
         for (int i = first; i <= last; ++i) {
-            QModelIndex index = m_model->index(i, 0, parent);
-            Q_ASSERT(m_widgets.contains(index));
-
-            WidgetGraphicsItem* w = m_widgets.take(index);
-            // releases ownership
-            m_scene->removeItem(w);
-            delete w;
+            uint id = data.child(i)->id();
+            // Widgets out of view have no item
+            if (m_widgets.contains(id)) {
+                releaseItem(id);
+            }
         }
     }
 }
@@ -380,24 +430,193 @@ void ScreenView::onRowsInserted(const QModelIndex& parent, int first, int last)
         return;
 
     // Ok it belongs to our root
-    WidgetGraphicsItem* screen = m_widgets[m_root];
+    WidgetGraphicsItem* screen = m_widgets.value(m_rootId);
+    if (!screen)
+        return; // our screen was removed, the id may come back on undo
+    const WidgetData& data = m_model->widget(parent);
 
+    bool created = false;
     for (int i = first; i <= last; ++i) {
-        QModelIndex windex = m_model->index(i, 0, parent);
-        auto* view = new WidgetGraphicsItem(this, windex, screen);
-        Q_ASSERT(!m_widgets.contains(windex));
-        m_widgets[windex] = view;
+        uint id = data.child(i)->id();
+        Q_ASSERT(!m_widgets.contains(id));
+        if (isInView(id)) {
+            created |= acquireItem(id) != nullptr;
+        }
+    }
+    if (created) {
+        restackItems();
+    }
+}
+
+bool ScreenView::isRootChild(uint id) const
+{
+    const WidgetData* w = m_model->widgetById(id);
+    return w && w->parent() && w->parent()->self()->id() == m_rootId;
+}
+
+QRect ScreenView::visibleArea() const
+{
+    WidgetGraphicsItem* screen = m_widgets.value(m_rootId);
+    if (m_visibleRect.isNull() || !screen)
+        return QRect();
+
+    // Margin avoids creating items at the moment they scroll into view
+    const int margin = 256;
+    QRect area = screen->mapRectFromScene(m_visibleRect).toAlignedRect();
+    return area.adjusted(-margin, -margin, margin, margin);
+}
+
+bool ScreenView::isInView(uint id) const
+{
+    const QRect area = visibleArea();
+    return area.isNull() || m_geometry.rect(id).intersects(area);
+}
+
+void ScreenView::updateVisibleItems()
+{
+    TRACE_ZONE("scene", "ScreenView::updateVisibleItems");
+    WidgetGraphicsItem* screen = m_widgets.value(m_rootId);
+    if (!screen)
+        return;
+
+    const QRect area = visibleArea();
+    QVector<uint> visible;
+    if (area.isNull()) {
+        const WidgetData& root = *m_model->widgetById(m_rootId);
+        for (int i = 0; i < root.childCount(); ++i) {
+            visible.append(root.child(i)->id());
+        }
+    } else {
+        // Nested widgets move with their root child
+        visible = m_geometry.intersecting(area);
+        visible.erase(std::remove_if(visible.begin(),
+                                     visible.end(),
+                                     [this](uint id) { return !isRootChild(id); }),
+                      visible.end());
+    }
+    const QSet<uint> wanted(visible.cbegin(), visible.cend());
+
+    // Recycle items out of view, unless the user works with them
+    QVector<uint> hidden;
+    for (auto it = m_widgets.cbegin(); it != m_widgets.cend(); ++it) {
+        if (it.key() != m_rootId && !wanted.contains(it.key()) && !it.value()->isSelected()) {
+            hidden.append(it.key());
+        }
+    }
+    for (uint id : qAsConst(hidden)) {
+        releaseItem(id);
+    }
+
+    bool created = false;
+    for (uint id : qAsConst(visible)) {
+        if (!m_widgets.contains(id)) {
+            created |= acquireItem(id) != nullptr;
+        }
+    }
+    if (created) {
+        restackItems();
+    }
+}
+
+WidgetGraphicsItem* ScreenView::acquireItem(uint id)
+{
+    WidgetGraphicsItem* screen = m_widgets.value(m_rootId);
+    if (!screen)
+        return nullptr;
+
+    WidgetGraphicsItem* item;
+    if (!m_pool.isEmpty()) {
+        item = m_pool.takeLast();
+        item->setWidgetId(id);
+    } else {
+        item = new WidgetGraphicsItem(this, id, screen);
+    }
+    m_widgets[id] = item;
+    return item;
+}
+
+void ScreenView::releaseItem(uint id)
+{
+    WidgetGraphicsItem* item = m_widgets.take(id);
+    item->setWidgetId(UniqueId::invalid);
+    m_pool.append(item);
+}
+
+WidgetGraphicsItem* ScreenView::ensureItem(uint id)
+{
+    WidgetGraphicsItem* item = m_widgets.value(id);
+    if (item || !isRootChild(id))
+        return item;
+    item = acquireItem(id);
+    if (item) {
+        restackItems();
+    }
+    return item;
+}
+
+void ScreenView::restackItems()
+{
+    const WidgetData* root = m_model->widgetById(m_rootId);
+    if (!root)
+        return;
+    // Recycled items sit at arbitrary positions in the sibling list
+    WidgetGraphicsItem* previous = nullptr;
+    for (int i = root->childCount() - 1; i >= 0; --i) {
+        WidgetGraphicsItem* item = m_widgets.value(root->child(i)->id());
+        if (!item)
+            continue;
+        if (previous) {
+            item->stackBefore(previous);
+        }
+        previous = item;
+    }
+}
+
+QPoint ScreenView::snap(const QRect& rect, int edges, int tolerance, const QSet<uint>& exclude)
+{
+    WidgetGraphicsItem* screen = m_widgets.value(m_rootId);
+    if (!screen)
+        return QPoint();
+
+    const auto result = m_geometry.snap(rect, edges, tolerance, exclude);
+    if (!m_snapLines) {
+        m_snapLines = new QGraphicsPathItem(screen);
+        QPen pen(QColor(255, 0, 255));
+        pen.setCosmetic(true);
+        pen.setStyle(Qt::DashLine);
+        m_snapLines->setPen(pen);
+        m_snapLines->setZValue(std::numeric_limits<qreal>::max());
+    }
+    QPainterPath path;
+    for (const QLine& line : result.lines) {
+        path.moveTo(line.p1());
+        path.lineTo(line.p2());
+    }
+    m_snapLines->setPath(path);
+    m_snapLines->setVisible(!path.isEmpty());
+    return result.offset;
+}
+
+void ScreenView::clearSnapLines()
+{
+    if (m_snapLines) {
+        m_snapLines->setVisible(false);
     }
 }
 
 void ScreenView::onModelAboutToBeReset()
 {
-    // FIXME
+    // Items refer to widgets which are about to be deleted
+    clearItems();
 }
 
 void ScreenView::onModelReset()
 {
-    // FIXME
+    // The screen stays empty unless it survived the reset
+    QModelIndex index = m_model->indexFromId(m_rootId);
+    if (index.isValid()) {
+        setScreen(index);
+    }
 }
 
 /**
@@ -413,7 +632,7 @@ void ScreenView::onSceneSelectionChanged()
     FlagSetter fs(&m_disableSelectionSlots);
 
     for (auto index : m_selectionModel->selectedIndexes()) {
-        auto it = m_widgets.find(index);
+        auto it = m_widgets.find(m_model->idFromIndex(index));
         if (it != m_widgets.end() && !(*it)->isSelected()) {
             m_selectionModel->select(makeRowSelection(index), QItemSelectionModel::Deselect);
         }
@@ -436,16 +655,12 @@ void ScreenView::onSceneSelectionChanged()
 
 void ScreenView::setCurrentWidget(const QModelIndex& current, const QModelIndex& previous)
 {
+    Q_UNUSED(previous);
     if (m_disableSelectionSlots)
         return;
 
     FlagSetter fs(&m_disableSelectionSlots);
 
-    // previous widget should be in the scene
-    if (previous.isValid()) {
-        qDebug() << "previous in the scene:" << m_widgets.contains(normalizeIndex(previous));
-    }
-
     // find parent Screen
     QModelIndex index = current;
     while (index.isValid()
@@ -461,10 +676,9 @@ void ScreenView::setCurrentWidget(const QModelIndex& current, const QModelIndex&
     //        return;
     //    }
 
-    // current widget should be in the scene
-    // Q_ASSERT(m_widgets.contains(normalizeIndex(current)));
-    if (m_widgets.contains(normalizeIndex(current)))
-        m_widgets[normalizeIndex(current)]->setSelected(true);
+    // current widget should be in the scene, even if it is out of view
+    if (auto* item = ensureItem(m_model->idFromIndex(current)))
+        item->setSelected(true);
 }
 
 void ScreenView::updateSelection(const QItemSelection& selected, const QItemSelection& deselected)
@@ -475,15 +689,14 @@ void ScreenView::updateSelection(const QItemSelection& selected, const QItemSele
     FlagSetter fs(&m_disableSelectionSlots);
 
     for (QModelIndex index : deselected.indexes()) {
-        auto it = m_widgets.find(index);
+        auto it = m_widgets.find(m_model->idFromIndex(index));
         if (it != m_widgets.end()) {
             (*it)->setSelected(false);
         }
     }
     for (QModelIndex index : selected.indexes()) {
-        auto it = m_widgets.find(index);
-        if (it != m_widgets.end()) {
-            (*it)->setSelected(true);
+        if (auto* item = ensureItem(m_model->idFromIndex(index))) {
+            item->setSelected(true);
         }
     }
 }
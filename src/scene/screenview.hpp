@@ -5,6 +5,7 @@
 #include <QItemSelectionModel>
 
 #include "widgetview.hpp"
+#include "scene/geometryindex.hpp"
 
 // QModelIndex normalizeIndex(const QModelIndex& index);
 // bool screenLike(int type)
@@ -30,6 +31,10 @@ public:
 
     void setSelectionModel(QItemSelectionModel* model);
 
+    // Part of the scene shown by the views, null rect means everything
+    QRectF visibleRect() const { return m_visibleRect; }
+    void setVisibleRect(const QRectF& rect);
+
 public slots:
     void setScreen(QModelIndex index);
     void displayBorders(bool display);
@@ -47,6 +52,7 @@ private:
     // QGraphicsScene owned
     QGraphicsPixmapItem* m_background;
     QGraphicsRectItem* m_backgroundRect;
+    QRectF m_visibleRect;
 
     std::vector<std::unique_ptr<ScreenView>> m_screens;
 };
@@ -63,12 +69,12 @@ public:
     ScreenView(ScreensModel* model, QModelIndex index, SkinScene* scene);
     ~ScreenView();
     /// Returns current screen index
-    QModelIndex currentIndex() { return m_root; }
+    QModelIndex currentIndex() { return rootIndex(); }
     QGraphicsScene* scene() const { return m_scene; }
     void setScreen(QModelIndex index);
     ScreensModel* model() const { return m_model; }
 
-    QModelIndex rootIndex() const { return m_root; }
+    QModelIndex rootIndex() const { return m_model->indexFromId(m_rootId); }
 
     void setSelectionModel(QItemSelectionModel* model);
 
@@ -77,12 +83,31 @@ public:
     // Widget borders
     bool haveBorders() const { return m_showBorders; }
 
+    /**
+     * @brief Create graphics items only for widgets near the visible part of the scene
+     * Items scrolled away are recycled, selected ones are kept.
+     */
+    void setVisibleRect(const QRectF& rect);
+    // Number of widget items currently in the scene, without the screen
+    int itemCount() const { return m_widgets.size() - (m_widgets.contains(m_rootId) ? 1 : 0); }
+
+    // Geometry of all widgets of the screen, nested ones included
+    const GeometryIndex& geometry() const { return m_geometry; }
+    /**
+     * @brief Snap a rect being dragged to edges of the other widgets
+     * Shows guide lines until clearSnapLines() and returns the offset to apply.
+     * @p rect is in screen coordinates, @p exclude are the dragged widgets.
+     */
+    QPoint snap(const QRect& rect, int edges, int tolerance, const QSet<uint>& exclude);
+    void clearSnapLines();
+
 public slots:
     void displayBorders(bool display);
 
 private slots:
     // Screens Model
-    void onWidgetChanged(const QModelIndex& index, int key);
+    void onWidgetChanged(uint id, int key);
+    void onWidgetsChanged(const QVector<QPair<uint, int>>& changes);
     void onRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
     void onRowsAboutToBeMoved(const QModelIndex& sourceParent,
                               int sourceStart,
@@ -111,17 +136,40 @@ private:
     bool containsOurRoot(const QModelIndex& index, int first, int last) const;
     void removeChildren(const QModelIndex& parent, int first, int last);
 
+    // Virtualized items
+    bool isRootChild(uint id) const;
+    // Visible area with margin in screen coordinates, null for everything
+    QRect visibleArea() const;
+    bool isInView(uint id) const;
+    void updateVisibleItems();
+    // Delete all graphics items, the screen item included
+    void clearItems();
+    WidgetGraphicsItem* acquireItem(uint id);
+    void releaseItem(uint id);
+    // Item for a child of the root, created if needed
+    WidgetGraphicsItem* ensureItem(uint id);
+    // Keep model order of the items with equal z value
+    void restackItems();
+
     // ref
     ScreensModel* m_model;
     QGraphicsScene* m_scene;
     QPointer<QItemSelectionModel> m_selectionModel;
 
-    QPersistentModelIndex m_root;
+    // id of the screen widget
+    uint m_rootId;
     // flag to ignore signals from selectionModel
     bool m_disableSelectionSlots;
 
-    // references within scene
-    QHash<QPersistentModelIndex, WidgetGraphicsItem*> m_widgets;
+    // references within scene by widget id
+    QHash<uint, WidgetGraphicsItem*> m_widgets;
+    // Items exist only for the visible root children
+    GeometryIndex m_geometry;
+    QRectF m_visibleRect;
+    // Hidden items ready for reuse, owned by the screen item
+    QVector<WidgetGraphicsItem*> m_pool;
+    // Snap guides, owned by the screen item
+    QGraphicsPathItem* m_snapLines;
 
     bool m_showBorders;
 };
@@ -0,0 +1,125 @@
+#include "spatialgrid.hpp"
+#include <algorithm>
+
+namespace {
+
+// Rects covering more cells are not worth splitting
+const int maxCellsPerRect = 64;
+
+int floorDiv(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+} // namespace
+
+SpatialGrid::SpatialGrid(int cellSize)
+    : m_cellSize(qMax(1, cellSize))
+{}
+
+void SpatialGrid::insert(uint id, const QRect& rect)
+{
+    remove(id);
+    const QRect r = normalized(rect);
+    m_rects.insert(id, r);
+
+    QRect cells;
+    if (!cellRange(r, cells)) {
+        m_large.append(id);
+        return;
+    }
+    for (int y = cells.top(); y <= cells.bottom(); ++y) {
+        for (int x = cells.left(); x <= cells.right(); ++x) {
+            m_cells[cellKey(x, y)].append(id);
+        }
+    }
+}
+
+void SpatialGrid::remove(uint id)
+{
+    auto it = m_rects.find(id);
+    if (it == m_rects.end())
+        return;
+
+    QRect cells;
+    if (!cellRange(*it, cells)) {
+        m_large.removeOne(id);
+    } else {
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                auto cell = m_cells.find(cellKey(x, y));
+                if (cell != m_cells.end()) {
+                    cell->removeOne(id);
+                    if (cell->isEmpty()) {
+                        m_cells.erase(cell);
+                    }
+                }
+            }
+        }
+    }
+    m_rects.erase(it);
+}
+
+void SpatialGrid::clear()
+{
+    m_cells.clear();
+    m_rects.clear();
+    m_large.clear();
+}
+
+QVector<uint> SpatialGrid::query(const QRect& area) const
+{
+    QVector<uint> result;
+    const QRect a = normalized(area);
+    auto check = [&](uint id) {
+        if (m_rects.value(id).intersects(a)) {
+            result.append(id);
+        }
+    };
+
+    QRect cells;
+    if (cellRange(a, cells) && cells.width() * cells.height() < m_cells.size()) {
+        for (int y = cells.top(); y <= cells.bottom(); ++y) {
+            for (int x = cells.left(); x <= cells.right(); ++x) {
+                auto cell = m_cells.constFind(cellKey(x, y));
+                if (cell != m_cells.cend()) {
+                    for (uint id : *cell) {
+                        check(id);
+                    }
+                }
+            }
+        }
+        // Rects spanning several cells were found several times
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        for (uint id : m_large) {
+            check(id);
+        }
+    } else {
+        // Area covers most of the grid, checking every rect is cheaper
+        for (auto it = m_rects.cbegin(); it != m_rects.cend(); ++it) {
+            check(it.key());
+        }
+    }
+    return result;
+}
+
+bool SpatialGrid::cellRange(const QRect& rect, QRect& cells) const
+{
+    const int left = floorDiv(rect.left(), m_cellSize);
+    const int top = floorDiv(rect.top(), m_cellSize);
+    const int right = floorDiv(rect.right(), m_cellSize);
+    const int bottom = floorDiv(rect.bottom(), m_cellSize);
+    cells = QRect(QPoint(left, top), QPoint(right, bottom));
+    return qint64(cells.width()) * cells.height() <= maxCellsPerRect;
+}
+
+quint64 SpatialGrid::cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
+
+QRect SpatialGrid::normalized(const QRect& rect)
+{
+    return QRect(rect.topLeft(), rect.size().expandedTo(QSize(1, 1)));
+}
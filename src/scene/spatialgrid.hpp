@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QHash>
+#include <QRect>
+#include <QVector>
+
+/**
+ * @brief uniform grid of rects by id for fast area queries
+ * Each rect is stored in every cell it touches. Rects spanning too many
+ * cells are kept in a separate list which is checked on every query.
+ */
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(int cellSize = 256);
+
+    // Adds or moves the rect with the given id
+    void insert(uint id, const QRect& rect);
+    void remove(uint id);
+    void clear();
+
+    bool contains(uint id) const { return m_rects.contains(id); }
+    QRect rect(uint id) const { return m_rects.value(id); }
+    int size() const { return m_rects.size(); }
+
+    // Ids of rects intersecting the area, each id once and in no particular order
+    QVector<uint> query(const QRect& area) const;
+
+private:
+    // Cells covered by the rect, false if there are too many of them
+    bool cellRange(const QRect& rect, QRect& cells) const;
+    static quint64 cellKey(int x, int y);
+    // Empty widgets still occupy a point
+    static QRect normalized(const QRect& rect);
+
+    int m_cellSize;
+    QHash<quint64, QVector<uint>> m_cells;
+    QHash<uint, QRect> m_rects;
+    QVector<uint> m_large;
+};
@@ -2,30 +2,30 @@
 #include "repository/skinrepository.hpp"
 #include "screenview.hpp"
 #include "base/flagsetter.hpp"
+#include "base/trace.hpp"
+#include "scene/levelofdetail.hpp"
 #include "skin/widgetdata.hpp"
 #include <QCursor>
 #include <QGraphicsSceneMouseEvent>
+#include <QGraphicsView>
+#include <QGuiApplication>
 #include <QKeyEvent>
 #include <QPainter>
 #include <QTextDocument>
 
-WidgetGraphicsItem::WidgetGraphicsItem(ScreenView* screen,
-                                       QModelIndex index,
-                                       WidgetGraphicsItem* parent)
+WidgetGraphicsItem::WidgetGraphicsItem(ScreenView* screen, uint id, WidgetGraphicsItem* parent)
     : ResizableGraphicsRectItem(parent)
     , m_screen(screen)
     , m_model(screen->model())
-    , m_data(index)
-    , m_observer(m_model, index)
+    , m_id(id)
+    , m_observer(m_model, id)
     , m_border(nullptr)
     , m_rectChange(false)
+    , m_transforming(false)
 {
-    Q_ASSERT(m_data.column() == ScreensModel::ColumnElement);
+    Q_ASSERT(m_model->widgetById(m_id));
 
-    qDebug() << "create WidgetView for" << m_data.data(Qt::DisplayRole)
-             << m_data.sibling(m_data.row(), ScreensModel::ColumnName).data(Qt::DisplayRole);
-
-    if (m_model->widget(m_data).type() == WidgetData::WidgetType::Screen) {
+    if (widgetData().type() == WidgetData::WidgetType::Screen) {
         m_border = new BorderView(this);
         m_border->setFlag(ItemStacksBehindParent, true);
     }
@@ -36,17 +36,105 @@ WidgetGraphicsItem::WidgetGraphicsItem(ScreenView* screen,
     setFlag(ItemIsMovable, false);
     setFlag(ItemSendsGeometryChanges, true);
 
-    auto props = Property::propertyEnum();
-    for (int i = 0; i < props.keyCount(); ++i) {
-        updateAttribute(i);
-    }
+    loadAttributes();
     showBorder(m_screen->haveBorders());
 }
 
+void WidgetGraphicsItem::setWidgetId(uint id)
+{
+    Q_ASSERT(!m_border); // screens are not recycled
+    Q_ASSERT(id == UniqueId::invalid || m_model->widgetById(id));
+
+    setSelected(false);
+    m_transforming = false;
+    m_dragged.clear();
+    m_id = id;
+    m_observer.setId(id);
+    if (id == UniqueId::invalid) {
+        hide();
+        PixmapWatcher::setPath(QString());
+        m_pixmap = QPixmap();
+        return;
+    }
+    loadAttributes();
+    show();
+}
+
+QModelIndex WidgetGraphicsItem::modelIndex() const
+{
+    return m_model->indexFromId(m_id);
+}
+
+const QVector<int>& WidgetGraphicsItem::renderKeys(Property::Render render)
+{
+    static const QVector<int> none;
+    static const QVector<int> screen = { Property::backgroundColor, Property::flags };
+    static const QVector<int> label = { Property::backgroundColor, Property::foregroundColor };
+    static const QVector<int> pixmap = { Property::pixmap };
+
+    switch (render) {
+    case Property::Screen:
+        return screen;
+    case Property::Label:
+    case Property::FixedLabel:
+    case Property::Slider:
+        return label;
+    case Property::Pixmap:
+    case Property::Picon:
+        return pixmap;
+    default:
+        return none;
+    }
+}
+
+void WidgetGraphicsItem::loadAttributes()
+{
+    FlagSetter fs(&m_rectChange);
+
+    auto& w = widgetData();
+    applyGeometry(w);
+    setZValue(w.zPosition());
+
+    const auto& keys = renderKeys(w.sceneRender());
+    if (!keys.contains(Property::pixmap)) {
+        // Don't keep watching a file which is not painted anymore
+        PixmapWatcher::setPath(QString());
+        m_pixmap = QPixmap();
+    }
+    for (int key : keys) {
+        applyAttribute(w, key);
+    }
+    update();
+}
+
+void WidgetGraphicsItem::applyGeometry(const WidgetData& w)
+{
+    setGeometry(w.absolutePosition(), w.selfSize());
+}
+
+void WidgetGraphicsItem::setGeometry(const QPoint& pos, const QSize& size)
+{
+    QRectF r = rect();
+    setPos(pos + r.topLeft().toPoint());
+    r.moveTopLeft(QPointF(0, 0));
+    r.setSize(size);
+    setRect(r);
+    updateHandlesPos();
+    updateBorderRect();
+}
+
 void WidgetGraphicsItem::resizeRectEvent(const QRectF& r)
 {
     FlagSetter fs(&m_rectChange);
 
+    if (m_transforming) {
+        // update the scene only, model is changed on release
+        ResizableGraphicsRectItem::resizeRectEvent(r);
+        updateBorderRect();
+        previewChildLayout();
+        return;
+    }
+
     // update data in model
     QPoint oldPos = mapRectToParent(rect()).topLeft().toPoint();
     QPoint p = mapRectToParent(r).topLeft().toPoint();
@@ -61,28 +149,230 @@ void WidgetGraphicsItem::resizeRectEvent(const QRectF& r)
     updateBorderRect();
 }
 
+void WidgetGraphicsItem::resizeStartedEvent()
+{
+    beginTransform();
+}
+
+void WidgetGraphicsItem::resizeFinishedEvent()
+{
+    m_screen->clearSnapLines();
+    endTransform();
+}
+
+QPointF WidgetGraphicsItem::snapHandlePoint(const QPointF& p, int handle)
+{
+    const int tolerance = snapTolerance();
+    if (tolerance == 0) {
+        m_screen->clearSnapLines();
+        return p;
+    }
+    // Only the dragged edges snap, the point is an empty rect for the index
+    int edges = 0;
+    if (handle & (RectHandle::Left | RectHandle::Right)) {
+        edges |= GeometryIndex::SnapLeft;
+    }
+    if (handle & (RectHandle::Top | RectHandle::Bottom)) {
+        edges |= GeometryIndex::SnapTop;
+    }
+    const QPoint point = mapToItem(topLevelItem(), p).toPoint();
+    return p + m_screen->snap(QRect(point, QSize(0, 0)), edges, tolerance, { m_id });
+}
+
+void WidgetGraphicsItem::mousePressEvent(QGraphicsSceneMouseEvent* event)
+{
+    ResizableGraphicsRectItem::mousePressEvent(event);
+    if (event->button() == Qt::LeftButton && scene()) {
+        // All selected items are dragged together
+        m_dragged.clear();
+        for (auto* item : scene()->selectedItems()) {
+            auto w = qgraphicsitem_cast<WidgetGraphicsItem*>(item);
+            if (w) {
+                w->beginTransform();
+                m_dragged.append(w);
+            }
+        }
+    }
+}
+
+void WidgetGraphicsItem::mouseMoveEvent(QGraphicsSceneMouseEvent* event)
+{
+    // Moves the selected items along with the mouse
+    ResizableGraphicsRectItem::mouseMoveEvent(event);
+
+    const int tolerance = snapTolerance();
+    if (m_dragged.isEmpty() || tolerance == 0) {
+        m_screen->clearSnapLines();
+        return;
+    }
+
+    // The selection snaps as a whole
+    QSet<uint> ids;
+    QRect bounds;
+    for (const auto& w : qAsConst(m_dragged)) {
+        if (w) {
+            ids.insert(w->widgetId());
+            bounds |= w->screenRect();
+        }
+    }
+    const QPoint offset = m_screen->snap(bounds, GeometryIndex::SnapAll, tolerance, ids);
+    if (offset.isNull())
+        return;
+    for (const auto& w : qAsConst(m_dragged)) {
+        if (!w)
+            continue;
+        // Children of dragged items move with their parent
+        bool nested = false;
+        for (auto* p = w->parentItem(); p && !nested; p = p->parentItem()) {
+            auto parent = qgraphicsitem_cast<WidgetGraphicsItem*>(p);
+            nested = parent && ids.contains(parent->widgetId());
+        }
+        if (!nested) {
+            w->moveBy(offset.x(), offset.y());
+        }
+    }
+}
+
+void WidgetGraphicsItem::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton) {
+        m_screen->clearSnapLines();
+        commitTransforms(m_dragged);
+        m_dragged.clear();
+    }
+    ResizableGraphicsRectItem::mouseReleaseEvent(event);
+}
+
+void WidgetGraphicsItem::ungrabMouseEvent(QEvent* event)
+{
+    // Focus change, modal dialog or hidden item, after a release there is nothing left
+    if (!m_dragged.isEmpty()) {
+        m_screen->clearSnapLines();
+        commitTransforms(m_dragged);
+        m_dragged.clear();
+    }
+    ResizableGraphicsRectItem::ungrabMouseEvent(event);
+}
+
+void WidgetGraphicsItem::beginTransform()
+{
+    if (m_transforming)
+        return;
+    m_transforming = true;
+    m_transformStart = mapRectToParent(rect()).toRect();
+}
+
+bool WidgetGraphicsItem::transformChanged() const
+{
+    return m_transforming && mapRectToParent(rect()).toRect() != m_transformStart;
+}
+
+void WidgetGraphicsItem::endTransform()
+{
+    if (!m_transforming)
+        return;
+    m_transforming = false;
+
+    QRect r = mapRectToParent(rect()).toRect();
+    if (r == m_transformStart) {
+        return;
+    } else if (r.size() == m_transformStart.size()) {
+        commitPositionChange(r.topLeft());
+    } else if (r.topLeft() == m_transformStart.topLeft()) {
+        commitSizeChange(r.size());
+    } else {
+        commitRectChange(r);
+    }
+}
+
+void WidgetGraphicsItem::commitTransforms(const QVector<QPointer<WidgetGraphicsItem>>& items)
+{
+    int changed = 0;
+    for (const auto& w : items) {
+        if (w && w->transformChanged()) {
+            ++changed;
+        }
+    }
+    // One undo step for the whole drag
+    if (changed > 1) {
+        m_model->undoStack()->beginMacro(QString("move %1 widgets").arg(changed));
+    }
+    for (const auto& w : items) {
+        if (w) {
+            w->endTransform();
+        }
+    }
+    if (changed > 1) {
+        m_model->undoStack()->endMacro();
+    }
+}
+
+QRect WidgetGraphicsItem::screenRect() const
+{
+    return mapRectToItem(topLevelItem(), rect()).toRect();
+}
+
+int WidgetGraphicsItem::snapTolerance() const
+{
+    // Alt drags freely
+    if (QGuiApplication::keyboardModifiers() & Qt::AltModifier)
+        return 0;
+    // A few pixels on the monitor whatever the zoom
+    const qreal pixels = 6;
+    qreal scale = 1;
+    if (scene() && !scene()->views().isEmpty()) {
+        scale = scene()->views().first()->transform().m11();
+    }
+    return qMax(1, qRound(pixels / scale));
+}
+
+void WidgetGraphicsItem::previewChildLayout()
+{
+    const QSize size = rect().size().toSize();
+    for (auto* item : childItems()) {
+        auto child = qgraphicsitem_cast<WidgetGraphicsItem*>(item);
+        if (child && child->widgetId() != UniqueId::invalid) {
+            child->previewGeometry(size);
+        }
+    }
+}
+
+void WidgetGraphicsItem::previewGeometry(const QSize& parentSize)
+{
+    const auto& w = widgetData();
+    if (!w.size().isRelative() && !w.position().isRelative())
+        return;
+
+    FlagSetter fs(&m_rectChange);
+    QSize size = w.size().getSize(parentSize);
+    setGeometry(w.position().toPoint(size, parentSize), size);
+    if (w.size().isRelative()) {
+        previewChildLayout();
+    }
+}
+
 void WidgetGraphicsItem::fileChangedEvent()
 {
-    m_pixmap = QPixmap(PixmapWatcher::path());
+    m_pixmap = PixmapStorage::pixmap(PixmapWatcher::path());
     update();
 }
 
 void WidgetGraphicsItem::commitSizeChange(const QSize& size)
 {
     FlagSetter fs(&m_rectChange);
-    m_model->resizeWidget(m_data, size);
+    m_model->resizeWidget(modelIndex(), size);
 }
 
 void WidgetGraphicsItem::commitRectChange(const QRect& rect)
 {
     FlagSetter fs(&m_rectChange);
-    m_model->changeWidgetRect(m_data, rect);
+    m_model->changeWidgetRect(modelIndex(), rect);
 }
 
 void WidgetGraphicsItem::commitPositionChange(const QPoint& point)
 {
     FlagSetter fs(&m_rectChange);
-    m_model->moveWidget(m_data, point);
+    m_model->moveWidget(modelIndex(), point);
 }
 
 void WidgetGraphicsItem::updateAttribute(int key)
@@ -91,36 +381,38 @@ void WidgetGraphicsItem::updateAttribute(int key)
         return;
     FlagSetter fs(&m_rectChange);
 
-    auto& w = m_model->widget(m_data);
-
-    // To be removed
-    //    QVariant value = mModel->widget(mData).getAttr(key);
+    auto& w = widgetData();
 
     switch (key) {
-    case Property::position: {
-        QRectF r = rect();
-        setPos(w.absolutePosition() + r.topLeft().toPoint());
-        r.moveTopLeft(QPointF(0, 0));
-        setRect(r);
-        updateHandlesPos();
-        updateBorderRect();
-        break;
-    }
-    case Property::size: {
-        QRectF r = rect();
-        r.setSize(w.selfSize());
-        setRect(r);
-        updateHandlesPos();
-        updateBorderRect();
+    case Property::render:
+    case Property::previewRender:
+        // Set of relevant attributes depends on the render
+        loadAttributes();
+        return;
+    case Property::position:
+    case Property::size:
+        applyGeometry(w);
         break;
-    }
     case Property::zPosition:
         setZValue(w.zPosition());
         break;
+    default:
+        // Other attributes are read by paint() directly
+        if (renderKeys(w.sceneRender()).contains(key)) {
+            applyAttribute(w, key);
+        }
+        break;
+    }
+    update();
+}
+
+void WidgetGraphicsItem::applyAttribute(const WidgetData& w, int key)
+{
+    switch (key) {
     case Property::pixmap: {
-        auto path = SkinRepository::instance().resolveFilename(w.pixmap(key));
+        auto path = SkinRepository::current().resolveFilename(w.pixmap(key));
         PixmapWatcher::setPath(path);
-        m_pixmap = QPixmap(path);
+        m_pixmap = PixmapStorage::pixmap(path);
         break;
     }
     case Property::backgroundColor:
@@ -138,8 +430,9 @@ void WidgetGraphicsItem::updateAttribute(int key)
             }
         }
         break;
+    default:
+        break;
     }
-    update();
 }
 
 void WidgetGraphicsItem::showBorder(bool show)
@@ -155,11 +448,14 @@ void WidgetGraphicsItem::paint(QPainter* painter,
                                const QStyleOptionGraphicsItem* option,
                                QWidget* widget)
 {
+    TRACE_ZONE("paint", "WidgetGraphicsItem::paint");
+
     // no blending in the OSD layer
     painter->setCompositionMode(QPainter::CompositionMode_Source);
 
-    auto& w = m_model->widget(m_data);
+    auto& w = widgetData();
     auto render = w.sceneRender();
+    const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
 
     switch (render) {
     case Property::Screen:
@@ -167,17 +463,16 @@ void WidgetGraphicsItem::paint(QPainter* painter,
         break;
     case Property::Label:
     case Property::FixedLabel:
-        paintLabel(painter, w);
+        paintLabel(painter, w, lod);
         break;
     case Property::Pixmap:
     case Property::Picon:
-        paintPixmap(painter, w);
+        paintPixmap(painter, w, lod);
         break;
     case Property::Slider:
         paintSlider(painter, w);
         break;
     default:
-        qDebug() << "no render to paint";
         break;
     }
     paintBorder(painter, w);
@@ -205,12 +500,14 @@ void WidgetGraphicsItem::paintBorder(QPainter* painter, const WidgetData& w)
 
 void WidgetGraphicsItem::paintScreen(QPainter* painter, const WidgetData& w)
 {
+    TRACE_ZONE("paint", "paintScreen");
     if (!w.transparent())
         painter->fillRect(rect(), QBrush(m_background_color));
 }
 
-void WidgetGraphicsItem::paintLabel(QPainter* painter, const WidgetData& w)
+void WidgetGraphicsItem::paintLabel(QPainter* painter, const WidgetData& w, qreal lod)
 {
+    TRACE_ZONE("paint", "paintLabel");
     if (!w.transparent()) {
         //		painter->setCompositionMode(QPainter::CompositionMode_Difference);
         painter->fillRect(rect(), QBrush(m_background_color));
@@ -219,13 +516,51 @@ void WidgetGraphicsItem::paintLabel(QPainter* painter, const WidgetData& w)
     if (text.isNull()) {
         text = w.scenePreview().toString();
     }
+    if (lod < LevelOfDetail::current().textBars) {
+        paintTextBar(painter, w, text);
+        return;
+    }
     painter->setPen(m_foreground_color);
     painter->setFont(w.font().getFont());
     painter->drawText(rect(), w.halign() | w.valign() | Qt::TextWordWrap, text);
 }
 
-void WidgetGraphicsItem::paintPixmap(QPainter* painter, const WidgetData& w)
+/**
+ * @brief Unreadable text replaced with a bar of its approximate extent
+ * Avoids text layout when the scene is zoomed out
+ */
+void WidgetGraphicsItem::paintTextBar(QPainter* painter, const WidgetData& w, const QString& text)
+{
+    if (text.isEmpty())
+        return;
+    const QRectF r = rect();
+    const QFont font = w.font().getFont();
+    const qreal fontHeight = font.pixelSize() > 0 ? font.pixelSize() : font.pointSizeF() * 4 / 3;
+    const qreal lineHeight = qMin(fontHeight, r.height());
+    if (lineHeight <= 0)
+        return;
+    // Average glyph is about half as wide as the line is high
+    const qreal width = qMin(r.width(), text.size() * lineHeight / 2);
+    QRectF bar(0, 0, width, lineHeight * 0.6);
+    bar.moveCenter(r.center());
+    if (w.halign() == PropertyHAlign::left) {
+        bar.moveLeft(r.left());
+    } else if (w.halign() == PropertyHAlign::right) {
+        bar.moveRight(r.right());
+    }
+    if (w.valign() == PropertyVAlign::top) {
+        bar.moveTop(r.top() + lineHeight * 0.2);
+    } else if (w.valign() == PropertyVAlign::bottom) {
+        bar.moveBottom(r.bottom() - lineHeight * 0.2);
+    }
+    QColor color = m_foreground_color;
+    color.setAlphaF(color.alphaF() * 0.5);
+    painter->fillRect(bar, color);
+}
+
+void WidgetGraphicsItem::paintPixmap(QPainter* painter, const WidgetData& w, qreal lod)
 {
+    TRACE_ZONE("paint", "paintPixmap");
     painter->save();
 
     if (w.alphatest() == Property::Alphatest::blend || w.alphatest() == Property::Alphatest::on
@@ -233,16 +568,26 @@ void WidgetGraphicsItem::paintPixmap(QPainter* painter, const WidgetData& w)
         painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
     }
 
+    // Zoomed out, smaller copy of the pixmap is scaled instead of the full one
+    int level = 0;
+    if (!m_pixmap.isNull() && lod < LevelOfDetail::current().mipmaps) {
+        level = PixmapStorage::mipmapLevel(w.scale() ? lod * rect().width() / m_pixmap.width()
+                                                     : lod);
+    }
+    const QPixmap pixmap = level > 0 ? PixmapStorage::mipmap(PixmapWatcher::path(), level)
+                                     : m_pixmap;
     if (w.scale()) {
-        painter->drawPixmap(rect(), m_pixmap, QRect(QPoint(0, 0), m_pixmap.size()));
+        painter->drawPixmap(rect(), pixmap, QRect(QPoint(0, 0), pixmap.size()));
     } else {
-        painter->drawPixmap(rect(), m_pixmap, QRect(QPoint(0, 0), rect().size().toSize()));
+        QSizeF source = rect().size() * pixmap.width() / qMax(1, m_pixmap.width());
+        painter->drawPixmap(rect(), pixmap, QRectF(QPointF(0, 0), source));
     }
     painter->restore();
 }
 
 void WidgetGraphicsItem::paintSlider(QPainter* painter, const WidgetData& w)
 {
+    TRACE_ZONE("paint", "paintSlider");
     int percent = qBound(0, w.scenePreview().toInt(), 100);
     QRect r = rect().toRect();
     if (w.orientation() == Property::orHorizontal) {
@@ -265,7 +610,6 @@ void WidgetGraphicsItem::updateBorderRect()
 
 void WidgetGraphicsItem::keyPressEvent(QKeyEvent* event)
 {
-    qDebug() << "WidgetView keyPressEvent";
     if (!isSelected()) {
         qWarning() << "press on non selected!";
     }
@@ -294,7 +638,18 @@ void WidgetGraphicsItem::keyPressEvent(QKeyEvent* event)
     default:
         QGraphicsRectItem::keyPressEvent(event);
     }
-    setPos(pos() + mv);
+    if (mv.isNull() || !scene())
+        return;
+
+    // Nudge all selected widgets with a single command
+    QModelIndexList indexes;
+    for (auto* item : scene()->selectedItems()) {
+        auto w = qgraphicsitem_cast<WidgetGraphicsItem*>(item);
+        if (w) {
+            indexes.append(w->modelIndex());
+        }
+    }
+    m_model->nudgeWidgets(indexes, mv);
 }
 
 QVariant WidgetGraphicsItem::itemChange(QGraphicsItem::GraphicsItemChange change,
@@ -302,7 +657,7 @@ QVariant WidgetGraphicsItem::itemChange(QGraphicsItem::GraphicsItemChange change
 {
     switch (change) {
     case ItemPositionHasChanged:
-        if (!m_rectChange) {
+        if (!m_rectChange && !m_transforming) {
             QPointF position = value.toPointF();
             commitPositionChange((position + rect().topLeft()).toPoint());
         }
@@ -310,7 +665,7 @@ QVariant WidgetGraphicsItem::itemChange(QGraphicsItem::GraphicsItemChange change
     case ItemSelectedHasChanged:
         if (isSelected() && scene()) {
             setHandlesVisible(true);
-            auto pos = m_model->widget(m_data).position();
+            auto pos = widgetData().position();
             setXanchor(pos.x().type());
             setYanchor(pos.y().type());
             setFlag(ItemIsFocusable, true);
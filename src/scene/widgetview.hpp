@@ -4,6 +4,7 @@
 #include <QGraphicsPixmapItem>
 #include <QGraphicsRectItem>
 #include <QGraphicsTextItem>
+#include <QPointer>
 
 #include "rectselector.hpp"
 #include "repository/skinrepository.hpp"
@@ -33,13 +34,19 @@ class WidgetGraphicsItem : public QObject, public ResizableGraphicsRectItem, pub
 {
     Q_OBJECT
 public:
-    WidgetGraphicsItem(ScreenView* screen, QModelIndex index, WidgetGraphicsItem* parent);
+    WidgetGraphicsItem(ScreenView* screen, uint id, WidgetGraphicsItem* parent);
     enum
     {
         Type = getGraphicsItemType<WidgetGraphicsItem>()
     };
     int type() const override { return Type; }
-    QPersistentModelIndex modelIndex() const { return m_data; }
+    uint widgetId() const { return m_id; }
+    /**
+     * @brief Show another widget of the same parent, used to recycle items
+     * With UniqueId::invalid the item is hidden and unbound from the model.
+     */
+    void setWidgetId(uint id);
+    QModelIndex modelIndex() const;
 
     // QGraphicsItem interface
     void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
@@ -49,14 +56,29 @@ public:
     // call me when attribute value changes in the model
     void updateAttribute(int key);
 
+    /**
+     * @brief Attributes which affect the item state for the given render
+     * Position, size and zPosition are always applied and not listed here.
+     * Attributes read by paint() are not cached, their changes only repaint.
+     */
+    static const QVector<int>& renderKeys(Property::Render render);
+
     // Whether to display widget borders
     void showBorder(bool show);
 
 protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
     void keyPressEvent(QKeyEvent* event) override;
+    void mousePressEvent(QGraphicsSceneMouseEvent* event) override;
+    void mouseMoveEvent(QGraphicsSceneMouseEvent* event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent* event) override;
+    // Commits the drag when the grab is lost without a release
+    void ungrabMouseEvent(QEvent* event) override;
 
     void resizeRectEvent(const QRectF& rect) override;
+    void resizeStartedEvent() override;
+    void resizeFinishedEvent() override;
+    QPointF snapHandlePoint(const QPointF& p, int handle) override;
 
     // PixmapWatcher interface
     void fileChangedEvent() override;
@@ -65,7 +87,7 @@ private:
     // refs
     ScreenView* m_screen;
     ScreensModel* m_model;
-    QPersistentModelIndex m_data;
+    uint m_id;
 
     // Observer
     WidgetObserverRegistrator m_observer;
@@ -105,15 +127,45 @@ private:
     // don't call setData
     bool m_rectChange;
 
+    // Interactive transform: while dragging the item is moved and resized
+    // in the scene only, the model gets a single command on release
+    bool m_transforming;
+    QRect m_transformStart;
+    // Items dragged along with this one
+    QVector<QPointer<WidgetGraphicsItem>> m_dragged;
+
+    void beginTransform();
+    bool transformChanged() const;
+    void endTransform();
+    void commitTransforms(const QVector<QPointer<WidgetGraphicsItem>>& items);
+    // Rect relative to the screen item
+    QRect screenRect() const;
+    // Snap distance in scene units, constant in view pixels; 0 disables snapping
+    int snapTolerance() const;
+    // Cheap layout of relative children, without touching the model
+    void previewChildLayout();
+    void previewGeometry(const QSize& parentSize);
+
     void commitPositionChange(const QPoint& point);
     void commitSizeChange(const QSize& size);
     void commitRectChange(const QRect& rect);
     void paintBorder(QPainter* painter, const WidgetData& w);
     void paintScreen(QPainter* painter, const WidgetData& w);
-    void paintLabel(QPainter* painter, const WidgetData& w);
-    void paintPixmap(QPainter* painter, const WidgetData& w);
+    // lod is the scene scale, see QStyleOptionGraphicsItem::levelOfDetailFromTransform
+    void paintLabel(QPainter* painter, const WidgetData& w, qreal lod);
+    void paintPixmap(QPainter* painter, const WidgetData& w, qreal lod);
+    void paintTextBar(QPainter* painter, const WidgetData& w, const QString& text);
     void paintSlider(QPainter* painter, const WidgetData& w);
 
+    // The item only lives while its widget is in the model
+    const WidgetData& widgetData() const { return *m_model->widgetById(m_id); }
+
     QPixmap loadPixmap(const QString& fname);
     void updateBorderRect();
+
+    // Apply the whole widget state in one pass
+    void loadAttributes();
+    void applyGeometry(const WidgetData& w);
+    void setGeometry(const QPoint& pos, const QSize& size);
+    void applyAttribute(const WidgetData& w, int key);
 };
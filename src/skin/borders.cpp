@@ -1,5 +1,6 @@
 #include "borders.hpp"
 #include "skin/enums.hpp"
+#include <QDataStream>
 
 // Border
 
@@ -36,6 +37,18 @@ void Border::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void Border::fromStream(QDataStream& stream)
+{
+    qint32 bp;
+    stream >> bp >> m_fname;
+    m_bp = bp;
+}
+
+void Border::toStream(QDataStream& stream) const
+{
+    stream << qint32(m_bp) << m_fname;
+}
+
 void Border::reset()
 {
     m_bp = bpInvalid;
@@ -113,6 +126,24 @@ void BorderSet::toXml(QXmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void BorderSet::fromStream(QDataStream& stream)
+{
+    qint32 bs;
+    stream >> bs;
+    m_bs = bs;
+    for (Border& b : m_borders) {
+        b.fromStream(stream);
+    }
+}
+
+void BorderSet::toStream(QDataStream& stream) const
+{
+    stream << qint32(m_bs);
+    for (const Border& b : m_borders) {
+        b.toStream(stream);
+    }
+}
+
 const Border& BorderSet::getBorder(Property::BorderPosition bp) const
 {
     return m_borders[bp];
@@ -5,6 +5,7 @@
 
 class QXmlStreamReader;
 class QXmlStreamWriter;
+class QDataStream;
 
 /**
  * @brief Stores (border position, pixmap file name) pair defined in skin
@@ -21,6 +22,8 @@ public:
 
     void fromXml(QXmlStreamReader& xml);
     void toXml(QXmlStreamWriter& xml) const;
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
 
     inline int bp() const { return m_bp; }
     inline bool isValid() const { return m_bp != bpInvalid; }
@@ -45,6 +48,8 @@ public:
 
     void fromXml(QXmlStreamReader& xml);
     void toXml(QXmlStreamWriter& xml) const;
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
 
     const Border& getBorder(Property::BorderPosition bp) const;
 
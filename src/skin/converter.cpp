@@ -2,6 +2,7 @@
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 #include <QMetaType>
+#include <QDataStream>
 #include <QMetaObject>
 #include <QFile>
 #include <functional>
@@ -40,6 +41,17 @@ void Converter::toXml(XmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+void Converter::fromStream(QDataStream& stream)
+{
+    stream >> m_type >> m_text;
+    parseArgument();
+}
+
+void Converter::toStream(QDataStream& stream) const
+{
+    stream << m_type << m_text;
+}
+
 void Converter::setArg(const QString& arg)
 {
     m_text = arg;
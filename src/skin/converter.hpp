@@ -12,6 +12,7 @@
 #include "base/meta.hpp"
 
 class QXmlStreamReader;
+class QDataStream;
 
 class Source
 {
@@ -68,6 +69,8 @@ public:
     Converter() {}
     void fromXml(QXmlStreamReader& xml);
     void toXml(XmlStreamWriter& xml) const;
+    void fromStream(QDataStream& stream);
+    void toStream(QDataStream& stream) const;
     const QString& arg() const { return m_text; }
     void setArg(const QString& arg);
     const QString& type() const { return m_type; }
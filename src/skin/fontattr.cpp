@@ -9,6 +9,15 @@ QFont FontAttr::getFont() const
     return f;
 }
 
+FontAttr FontAttr::scaled(qreal factor) const
+{
+    FontAttr result(*this);
+    if (m_size > 0) {
+        result.m_size = qMax(1, qRound(m_size * factor));
+    }
+    return result;
+}
+
 QString FontAttr::toStr() const
 {
     if (!m_name.isNull() && m_size > 0)
@@ -16,6 +16,9 @@ public:
         fromStr(str);
     }
     QString name() const { return m_name; }
+    int size() const { return m_size; }
+    // Same font, size multiplied by @p factor
+    FontAttr scaled(qreal factor) const;
     QFont getFont() const;
     QString toStr() const;
     void fromStr(const QString& str);
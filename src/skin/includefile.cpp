@@ -1,5 +1,7 @@
 #include "includefile.hpp"
 #include "repository/skinrepository.hpp"
+#include "base/trace.hpp"
+#include <QDataStream>
 
 IncludeFile::IncludeFile()
     : WidgetData()
@@ -12,13 +14,29 @@ bool IncludeFile::fromXml(QXmlStreamReader& xml)
     m_fileName = xml.attributes().value("filename").toString();
     xml.skipCurrentElement();
 
-    auto file_name = SkinRepository::instance().dir().filePath(m_fileName);
+    auto file_name = SkinRepository::current().dir().filePath(m_fileName);
+    TraceZone zone("repository", "IncludeFile::fromXml");
+    zone.setDetail(m_fileName);
 
+    QVector<WidgetData*> screens;
+    QString error;
+    bool ok = readScreens(file_name, screens, error);
+    for (auto* screen : qAsConst(screens)) {
+        appendChild(screen);
+    }
+    if (!ok) {
+        xml.raiseError(error);
+    }
+    return ok;
+}
+
+bool IncludeFile::readScreens(const QString& path, QVector<WidgetData*>& screens, QString& error)
+{
     // FIXME: this code is similar to SkinRepository code
-    QFile file(file_name);
+    QFile file(path);
     bool ok = file.open(QIODevice::ReadOnly);
     if (!ok) {
-        xml.raiseError(QObject::tr("Can not find include file %1").arg(m_fileName));
+        error = QObject::tr("Can not find include file %1").arg(path);
         return false;
     }
 
@@ -29,9 +47,9 @@ bool IncludeFile::fromXml(QXmlStreamReader& xml)
             if (inner_xml.name() == "screen") {
                 WidgetData* widget = new WidgetData();
                 widget->fromXml(inner_xml);
-                appendChild(widget);
+                screens.append(widget);
             } else {
-                qWarning() << "Unexpected tag in inner xml file" << xml.name();
+                qWarning() << "Unexpected tag in inner xml file" << inner_xml.name();
                 inner_xml.skipCurrentElement();
             }
         }
@@ -40,12 +58,12 @@ bool IncludeFile::fromXml(QXmlStreamReader& xml)
     }
 
     if (inner_xml.hasError()) {
-        xml.raiseError(inner_xml.errorString());
+        error = inner_xml.errorString();
         return false;
     }
     // Check for read errors
     if (file.error() != QFileDevice::FileError::NoError) {
-        xml.raiseError(file.errorString());
+        error = file.errorString();
         return false;
     }
     file.close();
@@ -58,15 +76,20 @@ void IncludeFile::toXml(XmlStreamWriter& xml) const
     xml.writeStartElement(tag);
     xml.writeAttribute("filename", m_fileName);
     xml.writeEndElement();
+}
 
-    auto file_name = SkinRepository::instance().dir().filePath(m_fileName);
+bool IncludeFile::save() const
+{
+    auto file_name = SkinRepository::current().dir().filePath(m_fileName);
+    TraceZone zone("repository", "IncludeFile::save");
+    zone.setDetail(m_fileName);
 
     // FIXME: this code is similar to SkinRepository code
     QFile file(file_name);
     bool ok = file.open(QIODevice::WriteOnly);
     if (!ok) {
         qWarning() << file.errorString(); // TODO: abort on error
-        return;
+        return false;
     }
 
     XmlStreamWriter inner_xml(&file);
@@ -81,4 +104,17 @@ void IncludeFile::toXml(XmlStreamWriter& xml) const
     inner_xml.writeEndElement();
 
     file.close();
+    return file.error() == QFileDevice::NoError;
+}
+
+bool IncludeFile::fromStream(QDataStream& stream)
+{
+    stream >> m_fileName;
+    return WidgetData::fromStream(stream);
+}
+
+void IncludeFile::toStream(QDataStream& stream) const
+{
+    stream << m_fileName;
+    WidgetData::toStream(stream);
 }
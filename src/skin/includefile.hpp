@@ -10,7 +10,17 @@ public:
     IncludeFile();
 
     bool fromXml(QXmlStreamReader& xml) override;
+    // Only the include element, the screens are written by save()
     void toXml(XmlStreamWriter& xml) const override;
+    // Write the screens to the include file
+    bool save() const;
+    bool fromStream(QDataStream& stream) override;
+    void toStream(QDataStream& stream) const override;
+
+    QString fileName() const { return m_fileName; }
+
+    // Screens of the include file at @p path, false with a message on errors
+    static bool readScreens(const QString& path, QVector<WidgetData*>& screens, QString& error);
 
 private:
     QString m_fileName;
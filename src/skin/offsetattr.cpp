@@ -19,6 +19,11 @@ OffsetAttr::OffsetAttr(const QString& str)
     }
 }
 
+OffsetAttr OffsetAttr::scaled(qreal sx, qreal sy) const
+{
+    return OffsetAttr(qRound(m_x * sx), qRound(m_y * sy));
+}
+
 QString OffsetAttr::toStr() const
 {
     if (m_x == 0 && m_y == 0) {
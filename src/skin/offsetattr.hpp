@@ -9,6 +9,9 @@ public:
     explicit OffsetAttr(int x = 0, int y = 0);
     OffsetAttr(const QString& str);
     QString toStr() const;
+    int x() const { return m_x; }
+    int y() const { return m_y; }
+    OffsetAttr scaled(qreal sx, qreal sy) const;
 
 private:
     int m_x, m_y;
@@ -68,6 +68,13 @@ bool Coordinate::isRelative() const
     return m_type == Type::Center;
 }
 
+Coordinate Coordinate::scaled(qreal factor) const
+{
+    if (m_type != Type::Pixel)
+        return *this;
+    return Coordinate(Type::Pixel, qRound(m_value * factor));
+}
+
 // PositionAttr
 
 PositionAttr::PositionAttr(const Coordinate& x, const Coordinate& y)
@@ -77,9 +84,13 @@ PositionAttr::PositionAttr(const Coordinate& x, const Coordinate& y)
 
 QPoint PositionAttr::toPoint(const WidgetData& widget) const
 {
-    QSize s = widget.selfSize();
-    QSize p = widget.parentSize();
-    return QPoint(m_x.getInt(s.width(), p.width()), m_y.getInt(s.height(), p.height()));
+    return toPoint(widget.selfSize(), widget.parentSize());
+}
+
+QPoint PositionAttr::toPoint(const QSize& selfSize, const QSize& parentSize) const
+{
+    return QPoint(m_x.getInt(selfSize.width(), parentSize.width()),
+                  m_y.getInt(selfSize.height(), parentSize.height()));
 }
 
 void PositionAttr::setPoint(const WidgetData& widget, const QPoint& pos)
@@ -91,6 +102,11 @@ void PositionAttr::setPoint(const WidgetData& widget, const QPoint& pos)
     m_y.parseInt(pos.y(), s.height(), p.height());
 }
 
+PositionAttr PositionAttr::scaled(qreal sx, qreal sy) const
+{
+    return PositionAttr(m_x.scaled(sx), m_y.scaled(sy));
+}
+
 QString PositionAttr::toStr() const
 {
     return m_x.toStr() + "," + m_y.toStr();
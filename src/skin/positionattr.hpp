@@ -3,6 +3,7 @@
 #include <QString>
 #include <QPair>
 #include <QPoint>
+#include <QSize>
 #include <QMetaType>
 
 /**
@@ -39,6 +40,8 @@ public:
 
     /// Depends on parent or on size
     bool isRelative() const;
+    /// Pixels multiplied by @p factor, percents and center are kept
+    Coordinate scaled(qreal factor) const;
 
     inline bool operator==(const Coordinate& other)
     {
@@ -64,7 +67,10 @@ public:
     inline const Coordinate& y() const { return m_y; }
     bool isRelative() const { return m_x.isRelative() || m_y.isRelative(); }
     QPoint toPoint(const WidgetData& widget) const;
+    // Does not touch the widget tree, for layout previews
+    QPoint toPoint(const QSize& selfSize, const QSize& parentSize) const;
     void setPoint(const WidgetData& widget, const QPoint& pos);
+    PositionAttr scaled(qreal sx, qreal sy) const;
 
     QString toStr() const;
     void fromStr(const QString& str);
@@ -60,6 +60,15 @@ bool Dimension::isRelative() const
     return m_type != Type::Number;
 }
 
+Dimension Dimension::scaled(qreal factor) const
+{
+    Dimension result(*this);
+    if (m_type == Type::Number) {
+        result.m_value = qRound(m_value * factor);
+    }
+    return result;
+}
+
 // SizeAttr
 
 SizeAttr::SizeAttr(Dimension w, Dimension h)
@@ -69,8 +78,12 @@ SizeAttr::SizeAttr(Dimension w, Dimension h)
 
 QSize SizeAttr::getSize(const WidgetData& widget) const
 {
-    QSize ps = widget.parentSize();
-    return QSize(m_width.getInt(ps.width()), m_height.getInt(ps.height()));
+    return getSize(widget.parentSize());
+}
+
+QSize SizeAttr::getSize(const QSize& parentSize) const
+{
+    return QSize(m_width.getInt(parentSize.width()), m_height.getInt(parentSize.height()));
 }
 
 void SizeAttr::setSize(const WidgetData& widget, const QSize size)
@@ -80,6 +93,11 @@ void SizeAttr::setSize(const WidgetData& widget, const QSize size)
     m_height.parseInt(size.height(), s.height());
 }
 
+SizeAttr SizeAttr::scaled(qreal sx, qreal sy) const
+{
+    return SizeAttr(m_width.scaled(sx), m_height.scaled(sy));
+}
+
 QString SizeAttr::toStr() const
 {
     return m_width.toStr() + "," + m_height.toStr();
@@ -33,6 +33,8 @@ public:
 
     /// Depends on parent or on size
     bool isRelative() const;
+    /// Numbers multiplied by @p factor, fill and percents are kept
+    Dimension scaled(qreal factor) const;
 
     inline bool operator==(const Dimension& other)
     {
@@ -56,7 +58,10 @@ public:
     SizeAttr(const QString& str) { fromStr(str); }
     bool isRelative() const { return m_width.isRelative() || m_height.isRelative(); }
     QSize getSize(const WidgetData& widget) const;
+    // Does not touch the widget tree, for layout previews
+    QSize getSize(const QSize& parentSize) const;
     void setSize(const WidgetData& widget, const QSize size);
+    SizeAttr scaled(qreal sx, qreal sy) const;
 
     QString toStr() const;
     void fromStr(const QString& str);
@@ -1,4 +1,5 @@
 #include "widgetdata.hpp"
+#include <QDataStream>
 #include <QDebug>
 #include <QTimer>
 #include <QXmlStreamReader>
@@ -13,6 +14,7 @@
 #include "skin/enumattr.hpp"
 #include "skin/attributes.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <type_traits>
@@ -241,7 +243,8 @@ static WidgetReflection reflection;
 // WidgetData
 
 WidgetData::WidgetData()
-    : m_zValue(0)
+    : m_layoutValid(false)
+    , m_zValue(0)
     , m_transparent(false)
     , m_borderWidth(0)
     , m_alphatest(Property::Alphatest::off)
@@ -262,7 +265,13 @@ WidgetData::WidgetData()
     Q_ASSERT(reflection.hasAllKeys());
 }
 
-WidgetData::~WidgetData() = default;
+WidgetData::~WidgetData()
+{
+    // Children are deleted by the base class and detach themselves
+    if (m_model) {
+        m_model->widgetDetached(this);
+    }
+}
 
 bool WidgetData::insertChild(int position, WidgetData* child)
 {
@@ -295,7 +304,17 @@ QVector<WidgetData*> WidgetData::takeChildren(int position, int count)
 
 void WidgetData::setModel(ScreensModel* model)
 {
-    m_model = model;
+    // Called for the whole subtree when it moves to another parent
+    m_layoutValid = false;
+    if (m_model != model) {
+        if (m_model) {
+            m_model->widgetDetached(this);
+        }
+        m_model = model;
+        if (m_model) {
+            m_model->widgetAttached(this);
+        }
+    }
     for (int i = 0; i < childCount(); ++i) {
         child(i)->setModel(m_model);
     }
@@ -372,23 +391,31 @@ void WidgetData::setSize(const SizeAttr& size)
 void WidgetData::move(const QPointF& pos)
 {
     m_position.setPoint(*this, pos.toPoint());
+    m_layoutValid = false;
     notifyAttrChange(Property::position);
 }
 
 void WidgetData::setPosition(const PositionAttr& pos)
 {
     m_position = pos;
+    m_layoutValid = false;
     notifyAttrChange(Property::position);
 }
 
 QPoint WidgetData::absolutePosition() const
 {
-    return m_position.toPoint(*this);
+    if (!m_layoutValid) {
+        resolveLayout(parentSize());
+    }
+    return m_layout.topLeft();
 }
 
 QSize WidgetData::selfSize() const
 {
-    return m_size.getSize(*this);
+    if (!m_layoutValid) {
+        resolveLayout(parentSize());
+    }
+    return m_layout.size();
 }
 
 QSize WidgetData::parentSize() const
@@ -396,11 +423,32 @@ QSize WidgetData::parentSize() const
     MixinTreeNode<WidgetData>* p = parent();
     if (p && p->isChild()) {
         return p->self()->selfSize();
+    } else if (m_model) {
+        return m_model->outputSize();
     } else {
-        return SkinRepository::instance().outputSize();
+        return SkinRepository::current().outputSize();
     }
 }
 
+void WidgetData::updateLayout() const
+{
+    const QSize size = selfSize();
+    for (int i = 0; i < childCount(); ++i) {
+        const WidgetData* w = child(i);
+        if (!w->m_layoutValid) {
+            w->resolveLayout(size);
+        }
+        w->updateLayout();
+    }
+}
+
+void WidgetData::resolveLayout(const QSize& parentSize) const
+{
+    const QSize size = m_size.getSize(parentSize);
+    m_layout = QRect(m_position.toPoint(size, parentSize), size);
+    m_layoutValid = true;
+}
+
 void WidgetData::setZPosition(int z)
 {
     m_zValue = z;
@@ -705,17 +753,26 @@ void WidgetData::loadPreview()
         MixinTreeNode<WidgetData>* ptr = parent();
         if (ptr) {
             QString screen = ptr->self()->name();
-            Preview p = m_model->getPreview(screen, name());
-            m_previewRender = p.render;
-            m_previewValue = p.value;
+            setPreview(m_model->getPreview(screen, name()));
         }
     } else if (m_type == WidgetType::Screen) {
+        // Look up the screen once for all its widgets
+        const QMap<QString, Preview> previews = m_model->screenPreviews(name());
         for (int i = 0; i < childCount(); ++i) {
-            child(i)->loadPreview();
+            WidgetData* w = child(i);
+            if (w->m_type == WidgetType::Widget) {
+                w->setPreview(previews.value(w->name()));
+            }
         }
     }
 }
 
+void WidgetData::setPreview(const Preview& preview)
+{
+    m_previewRender = preview.render;
+    m_previewValue = preview.value;
+}
+
 Property::Render WidgetData::sceneRender() const
 {
     switch (type()) {
@@ -756,6 +813,95 @@ void WidgetData::toXml(XmlStreamWriter& xml) const
     xml.writeEndElement();
 }
 
+/**
+ * @brief Reads subtree written by toStream()
+ * Attributes are kept in their xml string form, so the result
+ * is the same as parsing the xml written by toXml().
+ * \return stream status
+ */
+bool WidgetData::fromStream(QDataStream& stream)
+{
+    qint32 type;
+    stream >> type;
+    if (!setType(type)) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    stream >> m_propertiesOrder;
+
+    qint32 count;
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        qint32 key;
+        QString value;
+        stream >> key >> value;
+        setAttrFromXml(key, value);
+    }
+    stream >> m_otherAttributes >> m_appletCode;
+
+    qint32 previewRender;
+    stream >> previewRender >> m_previewValue;
+    m_previewRender = static_cast<Property::Render>(previewRender);
+
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString name;
+        stream >> name;
+        std::unique_ptr<Converter> converter;
+        if (!name.isEmpty()) {
+            converter = ConverterFactory::instance().createConverterByName(name);
+        }
+        if (!converter) {
+            converter = std::make_unique<Converter>();
+        }
+        converter->fromStream(stream);
+        m_converters.push_back(std::move(converter));
+    }
+
+    stream >> count;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        auto* widget = new WidgetData();
+        if (widget->fromStream(stream)) {
+            appendChild(widget);
+        } else {
+            delete widget;
+        }
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+void WidgetData::toStream(QDataStream& stream) const
+{
+    stream << qint32(m_type) << m_propertiesOrder;
+
+    QVector<QPair<int, QString>> attributes;
+    for (auto it = reflection.cbegin(); it != reflection.cend(); ++it) {
+        if (it.key() >= Property::preview)
+            continue;
+        QString value = it.value()->getStr(*this);
+        if (!value.isNull()) {
+            attributes.append(qMakePair(it.key(), value));
+        }
+    }
+    stream << qint32(attributes.size());
+    for (const auto& attr : qAsConst(attributes)) {
+        stream << qint32(attr.first) << attr.second;
+    }
+    stream << m_otherAttributes << m_appletCode;
+    stream << qint32(m_previewRender) << m_previewValue;
+
+    stream << qint32(m_converters.size());
+    for (const auto& converter : m_converters) {
+        stream << converter->type();
+        converter->toStream(stream);
+    }
+
+    stream << qint32(childCount());
+    for (int i = 0; i < childCount(); ++i) {
+        child(i)->toStream(stream);
+    }
+}
+
 void WidgetData::writeAttributes(XmlStreamWriter& xml) const
 {
     QMetaEnum meta = Property::propertyEnum();
@@ -803,6 +949,45 @@ QVariant WidgetData::getAttr(int key) const
     }
 }
 
+QVector<int> WidgetData::attrKeys()
+{
+    static const QVector<int> keys = [] {
+        QVector<int> list;
+        for (auto it = reflection.cbegin(); it != reflection.cend(); ++it) {
+            list.append(it.key());
+        }
+        std::sort(list.begin(), list.end());
+        return list;
+    }();
+    return keys;
+}
+
+QString WidgetData::attrString(int key) const
+{
+    auto it = reflection.find(key);
+    if (it != reflection.cend()) {
+        return (*it)->getStr(*this);
+    }
+    return QString();
+}
+
+bool WidgetData::isPatchableFrom(const WidgetData& other) const
+{
+    if (m_type != other.m_type || m_appletCode != other.m_appletCode
+        || m_otherAttributes != other.m_otherAttributes
+        || m_converters.size() != other.m_converters.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < m_converters.size(); ++i) {
+        const auto& converter = *m_converters[i];
+        const auto& otherConverter = *other.m_converters[i];
+        if (converter.type() != otherConverter.type() || converter.arg() != otherConverter.arg()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool WidgetData::setAttr(int key, const QVariant& value)
 {
     auto it = reflection.find(key);
@@ -866,13 +1051,36 @@ void WidgetData::updateCache()
 
 void WidgetData::sizeChanged()
 {
+    // Observers may read the geometry of children, drop it before notifying
+    m_layoutValid = false;
+    for (int i = 0; i < childCount(); ++i) {
+        child(i)->invalidateRelativeLayout();
+    }
     notifyAttrChange(Property::size);
     for (int i = 0; i < childCount(); ++i) {
-        child(i)->parentSizeChanged();
+        child(i)->notifyParentSizeChanged();
     }
 }
 
 void WidgetData::parentSizeChanged()
+{
+    invalidateRelativeLayout();
+    notifyParentSizeChanged();
+}
+
+void WidgetData::invalidateRelativeLayout()
+{
+    if (m_position.isRelative() || m_size.isRelative()) {
+        m_layoutValid = false;
+    }
+    if (m_size.isRelative()) {
+        for (int i = 0; i < childCount(); ++i) {
+            child(i)->invalidateRelativeLayout();
+        }
+    }
+}
+
+void WidgetData::notifyParentSizeChanged()
 {
     if (m_position.isRelative()) {
         notifyAttrChange(Property::position);
@@ -880,7 +1088,7 @@ void WidgetData::parentSizeChanged()
     if (m_size.isRelative()) {
         notifyAttrChange(Property::size);
         for (int i = 0; i < childCount(); ++i) {
-            child(i)->parentSizeChanged();
+            child(i)->notifyParentSizeChanged();
         }
     }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "base/tree.hpp"
+#include "base/uniqueid.hpp"
 #include "repository/xmlnode.hpp"
 #include "converter.hpp"
 #include "attributes.hpp"
@@ -17,8 +18,10 @@
 
 class QXmlStreamReader;
 class QXmlStreamWriter;
+class QDataStream;
 class ScreensModel;
 class Font;
+struct Preview;
 
 using PixmapAttr = QString; // FIXME: HACK
 
@@ -52,6 +55,8 @@ public:
     // model
     ScreensModel* model() const { return m_model; }
     void setModel(ScreensModel* model);
+    // Stable across moves within the model and undo/redo, copies get a new one
+    uint id() const { return m_id.id(); }
 
     // Widget tag
     enum class WidgetType
@@ -82,9 +87,14 @@ public:
     void setPosition(const PositionAttr& pos);
 
     // Access to absolute size and position
+    // Resolved values are cached until the geometry of the widget or its parent changes
     QPoint absolutePosition() const;
     QSize selfSize() const;
     QSize parentSize() const;
+    // Resolve geometry of the whole subtree in one top-down pass
+    void updateLayout() const;
+    // Size of the parent changed outside of the tree, e.g. the output of a screen
+    void parentSizeChanged();
 
     // Common
     int zPosition() const { return m_zValue; }
@@ -167,12 +177,24 @@ public:
     virtual bool fromXml(QXmlStreamReader& xml);
     virtual void toXml(XmlStreamWriter& xml) const;
 
+    // Binary form of the subtree, including preview values
+    virtual bool fromStream(QDataStream& stream);
+    virtual void toStream(QDataStream& stream) const;
+
     // Attribute get/set QVariant methods
     QVariant getAttr(int key) const;
     bool setAttr(int key, const QVariant& value);
+    // Keys accepted by getAttr() and setAttr(), sorted
+    static QVector<int> attrKeys();
+    // Text form of the attribute as written to xml, null when not set
+    QString attrString(int key) const;
+    // Other differs only in attributes of attrKeys() and in children
+    bool isPatchableFrom(const WidgetData& other) const;
 
     // Other attributes
     QString getAttr(const QString& key) const;
+    // Names of attributes the editor does not know
+    QStringList otherAttributes() const { return m_otherAttributes.keys(); }
 
     // Required for the optimisation:
     // only widgets which are viewed by someone
@@ -196,13 +218,20 @@ protected:
 
 private:
     void sizeChanged();
-    void parentSizeChanged();
+    // Drop cached geometry depending on the parent size, in the whole subtree
+    void invalidateRelativeLayout();
+    void notifyParentSizeChanged();
+    void resolveLayout(const QSize& parentSize) const;
     void notifyAttrChange(int key);
     void setAttrFromXml(int key, const QString& str);
+    void setPreview(const Preview& preview);
 
     // Size and position
     Size m_size;
     Position m_position;
+    // Resolved geometry relative to the parent
+    mutable QRect m_layout;
+    mutable bool m_layoutValid;
 
     // Common
     QString m_name;
@@ -258,6 +287,7 @@ private:
     QHash<int, bool> m_switches;
 
     // Other
+    UniqueId m_id;
     WidgetType m_type;
     QVector<QString> m_propertiesOrder;
     std::vector<std::unique_ptr<Converter>> m_converters;
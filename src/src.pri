@@ -5,7 +5,7 @@
 
 INCLUDEPATH += $$PWD
 CONFIG += static c++17
-QT += widgets network
+QT += widgets network concurrent
 
 # Sets the win32 output dir WINDIR
 CONFIG(debug, debug|release) {
@@ -1,4 +1,4 @@
-QT += core widgets xml svg
+QT += core widgets xml svg concurrent
 
 TARGET = src
 TEMPLATE = lib
@@ -54,17 +54,28 @@ SOURCES += \
     scene/rectselector.cpp \
     repository/xmlnode.cpp \
     repository/skinrepository.cpp \
+    repository/skinbatch.cpp \
+    repository/skinwatcher.cpp \
+    repository/assetoptimizer.cpp \
     skin/widgetdata.cpp \
     repository/pixmapstorage.cpp \
     commands/attrcommand.cpp \
+    commands/retargetcommand.cpp \
     fontlistwindow.cpp \
     model/colorsmodel.cpp \
     model/fontsmodel.cpp \
+    model/modelsnapshot.cpp \
     model/propertiesmodel.cpp \
+    model/screenestimator.cpp \
     model/screensmodel.cpp \
+    model/skinvalidator.cpp \
+    model/thumbnailsmodel.cpp \
     model/bordersmodel.cpp \
     model/windowstyle.cpp \
     scene/borderview.cpp \
+    scene/spatialgrid.cpp \
+    scene/geometryindex.cpp \
+    scene/levelofdetail.cpp \
     skin/attributes.cpp \
     skin/borders.cpp \
     skin/colorattr.cpp \
@@ -77,7 +88,9 @@ SOURCES += \
     skin/offsetattr.cpp \
     model/outputsmodel.cpp \
     model/movablelistmodel.cpp \
-    outputslistwindow.cpp
+    outputslistwindow.cpp \
+    base/uniqueid.cpp \
+    base/trace.cpp
 
 HEADERS += \
     customtreeview.hpp \
@@ -99,19 +112,30 @@ HEADERS += \
     base/singleton.hpp \
     repository/xmlnode.hpp \
     repository/skinrepository.hpp \
+    repository/skinbatch.hpp \
+    repository/skinwatcher.hpp \
+    repository/assetoptimizer.hpp \
     skin/widgetdata.hpp \
     repository/pixmapstorage.hpp \
     base/tree.hpp \
     commands/attrcommand.hpp \
+    commands/retargetcommand.hpp \
     fontlistwindow.hpp \
     model/namedlist.hpp \
     model/colorsmodel.hpp \
     model/fontsmodel.hpp \
+    model/modelsnapshot.hpp \
     model/propertiesmodel.hpp \
+    model/screenestimator.hpp \
     model/screensmodel.hpp \
+    model/skinvalidator.hpp \
+    model/thumbnailsmodel.hpp \
     model/bordersmodel.hpp \
     model/windowstyle.hpp \
     scene/borderview.hpp \
+    scene/spatialgrid.hpp \
+    scene/geometryindex.hpp \
+    scene/levelofdetail.hpp \
     base/flagsetter.hpp \
     skin/attributes.hpp \
     skin/borders.hpp \
@@ -130,7 +154,9 @@ HEADERS += \
     model/outputsmodel.hpp \
     model/movablelistmodel.hpp \
     outputslistwindow.hpp \
-    base/xmlstreamwriter.hpp
+    base/xmlstreamwriter.hpp \
+    base/uniqueid.hpp \
+    base/trace.hpp
 
 FORMS += \
     mainwindow.ui \
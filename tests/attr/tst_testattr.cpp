@@ -30,6 +30,15 @@ private slots:
         QVERIFY(serialize(pos) == "50,70");
     }
 
+    void test_layoutPreview()
+    {
+        // Computed from given sizes, without a widget tree
+        QCOMPARE(SizeAttr("100,200").getSize(QSize(1280, 720)), QSize(100, 200));
+        PositionAttr pos("center,20");
+        QCOMPARE(pos.toPoint(QSize(100, 50), QSize(1280, 720)), QPoint(590, 20));
+        QCOMPARE(pos.toPoint(QSize(100, 50), QSize(1920, 1080)), QPoint(910, 20));
+    }
+
     void test_bool()
     {
         bool b;
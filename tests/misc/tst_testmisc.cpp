@@ -1,5 +1,10 @@
 #include <QtTest>
 #include "base/flagsetter.hpp"
+#include "base/trace.hpp"
+#include "repository/assetoptimizer.hpp"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 class TestMisc : public QObject
 {
@@ -22,6 +27,79 @@ private slots:
         }
         QCOMPARE(b1, true);
     }
+
+    void test_trace()
+    {
+        auto& tracer = Tracer::instance();
+        tracer.clear();
+
+        // Nothing is recorded while disabled
+        {
+            TRACE_ZONE("test", "disabled");
+        }
+        QVERIFY(tracer.events().isEmpty());
+
+        tracer.setEnabled(true);
+        {
+            TraceZone zone("test", "outer");
+            zone.setDetail("detail");
+            TRACE_ZONE("test", "inner");
+        }
+        tracer.setEnabled(false);
+
+        auto events = tracer.events();
+        QCOMPARE(events.size(), 2);
+        // Inner zone ends first
+        QCOMPARE(QString(events[0].name), QString("inner"));
+        QCOMPARE(QString(events[1].name), QString("outer"));
+        QVERIFY(events[1].start <= events[0].start);
+        QVERIFY(events[1].duration >= events[0].duration);
+
+        auto doc = QJsonDocument::fromJson(tracer.toChromeTrace());
+        auto array = doc.object().value("traceEvents").toArray();
+        QCOMPARE(array.size(), 2);
+        auto outer = array.at(1).toObject();
+        QCOMPARE(outer.value("ph").toString(), QString("X"));
+        QCOMPARE(outer.value("cat").toString(), QString("test"));
+        QCOMPARE(outer.value("args").toObject().value("detail").toString(), QString("detail"));
+        tracer.clear();
+    }
+
+    void test_assetOptimizer()
+    {
+        // Two colors, one with soft alpha, and a text chunk
+        QImage image(32, 32, QImage::Format_ARGB32);
+        image.fill(qRgba(255, 0, 0, 255));
+        for (int y = 0; y < 16; ++y) {
+            for (int x = 0; x < 32; ++x) {
+                image.setPixel(x, y, qRgba(0, 0, 255, 100));
+            }
+        }
+        image.setText("Comment", "metadata");
+
+        // Lossless palette keeps every pixel
+        QString format;
+        QByteArray data = AssetOptimizer().optimize(image, Property::blend, 32, &format);
+        QCOMPARE(format, QString("palette"));
+        QImage result = QImage::fromData(data, "png");
+        QVERIFY(result.textKeys().isEmpty());
+        QVERIFY(result.convertToFormat(QImage::Format_ARGB32) == image);
+
+        // Alpha is reduced to what the alphatest mode shows
+        AssetOptimizer quantizing(true);
+        result = QImage::fromData(quantizing.optimize(image, Property::on), "png")
+                   .convertToFormat(QImage::Format_ARGB32);
+        QCOMPARE(qAlpha(result.pixel(0, 0)), 0);
+        QCOMPARE(result.pixel(0, 31), qRgba(255, 0, 0, 255));
+        result = QImage::fromData(quantizing.optimize(image, Property::off), "png")
+                   .convertToFormat(QImage::Format_ARGB32);
+        QCOMPARE(qAlpha(result.pixel(0, 0)), 255);
+
+        // Outputs with a palette allow quantisation without the option
+        result = QImage::fromData(AssetOptimizer().optimize(image, Property::off, 8), "png")
+                   .convertToFormat(QImage::Format_ARGB32);
+        QCOMPARE(qAlpha(result.pixel(0, 0)), 255);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestMisc)
@@ -1,9 +1,20 @@
 #include <QTest>
+#include <QSignalSpy>
+#include <QMimeData>
+#include <QTemporaryDir>
 #include <QAbstractItemModel>
 #include <QAbstractItemModelTester>
 #include "model/screensmodel.hpp"
 #include "model/colorsmodel.hpp"
 #include "model/fontsmodel.hpp"
+#include "model/skinvalidator.hpp"
+#include "model/propertiesmodel.hpp"
+#include "model/modelsnapshot.hpp"
+#include "model/screenestimator.hpp"
+#include "repository/skinrepository.hpp"
+#include "repository/assetoptimizer.hpp"
+#include <QtConcurrent>
+#include <memory>
 
 class TestScreensModel : public QObject
 {
@@ -77,8 +88,677 @@ private slots:
         QCOMPARE(model.widgetAttr(w, Property::text), "text_b");
         QCOMPARE(model.widgetAttr(w, Property::previewValue), "value");
     }
+
+    void test_bulkOperations()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        qRegisterMetaType<QVector<QPair<uint, int>>>();
+
+        model.insertRow(0, QModelIndex());
+        auto s = model.index(0, 0, QModelIndex());
+        model.setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(1000, 1000)));
+        model.insertRows(0, 3, s);
+        QModelIndexList widgets;
+        QVector<uint> ids;
+        const QVector<QPoint> points = { QPoint(10, 100), QPoint(300, 20), QPoint(40, 60) };
+        for (int i = 0; i < 3; ++i) {
+            auto w = model.index(i, 0, s);
+            model.setWidgetAttr(w, Property::size, QVariant::fromValue(SizeAttr(50, 20)));
+            model.moveWidget(w, points[i]);
+            widgets.append(w);
+            ids.append(model.idFromIndex(w));
+        }
+        auto positionOf = [&](int i) { return model.widgetById(ids[i])->absolutePosition(); };
+
+        QSignalSpy batchSpy(&model, &ScreensModel::widgetsChanged);
+        QSignalSpy singleSpy(&model, &ScreensModel::widgetChanged);
+        int steps = model.undoStack()->count();
+
+        // One command and one notification for all widgets
+        model.alignWidgets(widgets, Qt::AlignLeft);
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(positionOf(i), QPoint(10, points[i].y()));
+        }
+        QCOMPARE(model.undoStack()->count(), steps + 1);
+        QCOMPARE(batchSpy.count(), 1);
+        QCOMPARE(singleSpy.count(), 0);
+        auto changes = batchSpy.first().at(0).value<QVector<QPair<uint, int>>>();
+        QCOMPARE(changes.size(), 3);
+        model.undoStack()->undo();
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(positionOf(i), points[i]);
+        }
+
+        // Outer widgets stay in place, gaps become equal
+        model.distributeWidgets(widgets, Qt::Horizontal);
+        QCOMPARE(positionOf(0).x(), 10);
+        QCOMPARE(positionOf(2).x(), 155);
+        QCOMPARE(positionOf(1).x(), 300);
+
+        // Consecutive nudges are merged
+        steps = model.undoStack()->count();
+        model.nudgeWidgets(widgets, QPoint(0, 5));
+        model.nudgeWidgets(widgets, QPoint(0, 5));
+        QCOMPARE(model.undoStack()->count(), steps + 1);
+        QCOMPARE(positionOf(0), QPoint(10, 110));
+
+        // Other moves of the same widgets stay separate steps
+        model.alignWidgets(widgets, Qt::AlignTop);
+        model.alignWidgets(widgets, Qt::AlignLeft);
+        model.nudgeWidgets(widgets, QPoint(1, 0));
+        QCOMPARE(model.undoStack()->count(), steps + 4);
+        model.undoStack()->undo();
+        model.undoStack()->undo();
+        model.undoStack()->undo();
+        QCOMPARE(positionOf(0), QPoint(10, 110));
+
+        QVERIFY(model.setWidgetsAttr(widgets, Property::transparent, true));
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(model.widgetById(ids[i])->getAttr(Property::transparent).toBool(), true);
+        }
+        model.undoStack()->undo();
+        QCOMPARE(model.widgetById(ids[1])->getAttr(Property::transparent).toBool(), false);
+
+        // Remove in one step, undo restores the order
+        steps = model.undoStack()->count();
+        model.removeWidgets({ model.indexFromId(ids[2]), model.indexFromId(ids[0]) });
+        QCOMPARE(model.rowCount(s), 1);
+        QCOMPARE(model.idFromIndex(model.index(0, 0, s)), ids[1]);
+        QCOMPARE(model.undoStack()->count(), steps + 1);
+        model.undoStack()->undo();
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(model.idFromIndex(model.index(i, 0, s)), ids[i]);
+        }
+
+        // Children of a removed screen are not removed separately
+        model.removeWidgets({ model.indexFromId(ids[1]), s });
+        QCOMPARE(model.rowCount(), 0);
+        model.undoStack()->undo();
+        QCOMPARE(model.rowCount(s), 3);
+    }
+
+    void test_clipboard()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+
+        model.insertRow(0, QModelIndex());
+        auto s = model.index(0, 0, QModelIndex());
+        model.setWidgetAttr(s, Property::name, "Main");
+        model.insertRows(0, 2, s);
+        auto w = model.index(0, 0, s);
+        model.setWidgetAttr(w, Property::size, QVariant::fromValue(SizeAttr(50, 20)));
+
+        // Whole subtree is pasted in one step under a unique name
+        QScopedPointer<QMimeData> screen(model.copyWidgets({ s }));
+        QVERIFY(!screen->text().isEmpty());
+        int steps = model.undoStack()->count();
+        QVERIFY(model.pasteWidgets(screen.data(), QModelIndex(), 1));
+        QCOMPARE(model.undoStack()->count(), steps + 1);
+        QCOMPARE(model.rowCount(), 2);
+        auto copy = model.index(1, 0, QModelIndex());
+        QCOMPARE(model.widgetById(model.idFromIndex(copy))->name(), QString("Main_copy"));
+        QCOMPARE(model.rowCount(copy), 2);
+        auto size = model.widgetAttr(model.index(0, 0, copy), Property::size).value<SizeAttr>();
+        QCOMPARE(size.getSize(QSize(0, 0)), QSize(50, 20));
+        model.undoStack()->undo();
+        QCOMPARE(model.rowCount(), 1);
+
+        // Plain skin xml from another application
+        QMimeData xml;
+        xml.setText("<screen name=\"Xml\"><widget name=\"a\"/></screen>");
+        QVERIFY(model.pasteWidgets(&xml, QModelIndex(), 1));
+        QCOMPARE(model.rowCount(model.index(1, 0, QModelIndex())), 1);
+
+        // Widgets belong to screens
+        QScopedPointer<QMimeData> widget(model.copyWidgets({ w }));
+        QVERIFY(!model.pasteWidgets(widget.data(), QModelIndex(), 0));
+        QVERIFY(model.pasteWidgets(widget.data(), s, 2));
+        QCOMPARE(model.rowCount(s), 3);
+
+        // Copies go right after the original
+        uint id = model.idFromIndex(w);
+        model.duplicateWidgets({ w });
+        QCOMPARE(model.rowCount(s), 4);
+        QCOMPARE(model.idFromIndex(model.index(0, 0, s)), id);
+        auto dup = model.index(1, 0, s);
+        QVERIFY(model.idFromIndex(dup) != id);
+        size = model.widgetAttr(dup, Property::size).value<SizeAttr>();
+        QCOMPARE(size.getSize(QSize(0, 0)), QSize(50, 20));
+    }
+
+    void test_copyInclude()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QByteArray include = "<skin>\n<screen name=\"included\"/>\n</skin>\n";
+        auto write = [&](const QString& name, const QByteArray& data) {
+            QFile file(QDir(dir.path()).filePath(name));
+            return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+        };
+        QVERIFY(write("skin.xml", R"(<skin><include filename="inc.xml"/></skin>)"));
+        QVERIFY(write("inc.xml", include));
+
+        SkinRepository repository;
+        SkinRepository::Scope scope(&repository);
+        QVERIFY(repository.open(dir.path()));
+        auto* model = SkinRepository::screens();
+        QCOMPARE(model->rowCount(), 1);
+
+        // Copying an include row must not rewrite the include file
+        std::unique_ptr<QMimeData> data(model->copyWidgets({ model->index(0, 0) }));
+        QVERIFY(data->text().contains(R"(<include filename="inc.xml"/>)"));
+        QVERIFY(!data->text().contains("included"));
+        QFile file(QDir(dir.path()).filePath("inc.xml"));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), include);
+    }
+
+    void test_deploy()
+    {
+        QTemporaryDir dir;
+        QTemporaryDir target;
+        QVERIFY(dir.isValid() && target.isValid());
+        auto write = [&](const QString& name, const QByteArray& data) {
+            const QString path = QDir(dir.path()).filePath(name);
+            QFile file(path);
+            return QDir().mkpath(QFileInfo(path).path()) && file.open(QIODevice::WriteOnly)
+                   && file.write(data) == data.size();
+        };
+        QVERIFY(write("skin.xml", R"(<skin><screen name="main"/></skin>)"));
+        QVERIFY(write("extra/readme.txt", "text"));
+        QVERIFY(write(".git/config", "[core]"));
+        QVERIFY(write("extra/.readme.txt.swp", "swap"));
+
+        // Only skin content is deployed
+        DeployReport report = AssetOptimizer().deploy(dir.path(), target.path());
+        QVERIFY2(report.error.isEmpty(), qPrintable(report.error));
+        const QDir copy(target.path());
+        QVERIFY(copy.exists("skin.xml"));
+        QVERIFY(copy.exists("extra/readme.txt"));
+        QVERIFY(!copy.exists(".git"));
+        QVERIFY(!copy.exists("extra/.readme.txt.swp"));
+    }
+
+    void test_validator()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        colors->append(Color("red", qRgb(255, 0, 0)));
+
+        model.insertRow(0, QModelIndex());
+        auto s = model.index(0, 0, QModelIndex());
+        model.setWidgetAttr(s, Property::name, "main");
+        model.setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(720, 576)));
+        model.insertRows(0, 3, s);
+        auto setXml = [&](int row, const QString& text) {
+            QXmlStreamReader xml(text);
+            xml.readNextStartElement();
+            QVERIFY(model.setWidgetDataFromXml(model.index(row, 0, s), xml));
+        };
+        setXml(0, R"(<widget name="w0" backgroundColor="red" position="700,0" size="50,20"/>)");
+        setXml(1, R"(<widget name="w1" foregroundColor="blue" font="Missing;20" bogus="1"/>)");
+        setXml(2, R"(<panel name="other"/>)");
+        const uint w0 = model.idFromIndex(model.index(0, 0, s));
+        const uint w1 = model.idFromIndex(model.index(1, 0, s));
+        const uint panel = model.idFromIndex(model.index(2, 0, s));
+
+        SkinValidator validator(&model);
+        QAbstractItemModelTester modelTester(&validator, this);
+        validator.setOutputRect(QRect(0, 0, 720, 576));
+        validator.validateNow();
+        QVERIFY(!validator.isBusy());
+        QCOMPARE(validator.diagnostics(w0).size(), 1);
+        QCOMPARE(validator.diagnostics(w0).first().severity, Diagnostic::Warning);
+        QCOMPARE(validator.diagnostics(w1).size(), 3);
+        QCOMPARE(validator.diagnostics(panel).size(), 1);
+        QCOMPARE(validator.rowCount(), 5);
+        // Errors go first
+        QCOMPARE(validator.index(0, SkinValidator::ColumnSeverity).data(SkinValidator::SeverityRole),
+                 QVariant(Diagnostic::Error));
+
+        // Users of new resources are checked again
+        colors->append(Color("blue", qRgb(0, 0, 255)));
+        model.insertRow(1, QModelIndex());
+        model.setWidgetAttr(model.index(1, 0, QModelIndex()), Property::name, "other");
+        validator.validateNow();
+        QCOMPARE(validator.diagnostics(w1).size(), 2);
+        QVERIFY(validator.diagnostics(panel).isEmpty());
+
+        // Changes are checked in the background
+        QSignalSpy spy(&validator, &SkinValidator::finished);
+        model.moveWidget(model.indexFromId(w0), QPoint(0, 0));
+        QVERIFY(validator.isBusy());
+        QVERIFY(spy.wait());
+        QVERIFY(validator.diagnostics(w0).isEmpty());
+
+        model.removeWidgets({ model.indexFromId(w1) });
+        QCOMPARE(validator.rowCount(), 0);
+    }
+
+    void test_layoutCache()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        model.setOutputSize(QSize(1280, 720));
+
+        model.insertRow(0, QModelIndex());
+        auto s = model.index(0, 0, QModelIndex());
+        model.setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(400, 200)));
+        model.setWidgetAttr(
+          s, Property::position, QVariant::fromValue(PositionAttr("center,center")));
+        model.insertRow(0, s);
+        auto w = model.index(0, 0, s);
+        model.setWidgetAttr(w, Property::size, QVariant::fromValue(SizeAttr(100, 50)));
+        model.setWidgetAttr(w, Property::position, QVariant::fromValue(PositionAttr("center,10")));
+
+        const WidgetData& screen = model.widget(s);
+        const WidgetData& widget = model.widget(w);
+        screen.updateLayout();
+        QCOMPARE(screen.absolutePosition(), QPoint(440, 260));
+        QCOMPARE(widget.absolutePosition(), QPoint(150, 10));
+
+        // Relative children follow the parent
+        model.setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(600, 200)));
+        QCOMPARE(widget.absolutePosition(), QPoint(250, 10));
+        QCOMPARE(screen.absolutePosition(), QPoint(340, 260));
+
+        // And screens follow the output
+        model.setOutputSize(QSize(720, 576));
+        QCOMPARE(screen.absolutePosition(), QPoint(60, 188));
+        QCOMPARE(widget.absolutePosition(), QPoint(250, 10));
+    }
+
+    void test_propertiesModel()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+
+        model.insertRow(0, QModelIndex());
+        auto s = model.index(0, 0, QModelIndex());
+        model.insertRows(0, 2, s);
+        auto w0 = model.index(0, 0, s);
+        auto w1 = model.index(1, 0, s);
+        model.setWidgetAttr(w0, Property::name, "a");
+        model.setWidgetAttr(w1, Property::name, "b");
+        model.setWidgetAttr(w0, Property::zPosition, 1);
+        model.setWidgetAttr(w1, Property::zPosition, 1);
+
+        PropertiesModel props(&model);
+        QSignalSpy resetSpy(&props, &QAbstractItemModel::modelReset);
+        QSignalSpy changedSpy(&props, &QAbstractItemModel::dataChanged);
+        props.setWidget(w0);
+        QCOMPARE(resetSpy.size(), 1);
+        const QPersistentModelIndex name =
+          props.index(0, PropertiesModel::ColumnValue, props.index(0, 0));
+        const QPersistentModelIndex zPosition =
+          props.index(3, PropertiesModel::ColumnValue, props.index(0, 0));
+        QCOMPARE(name.data().toString(), QString("a"));
+
+        // The tree is rebound, not rebuilt
+        props.setWidget(w1);
+        QCOMPARE(resetSpy.size(), 1);
+        QVERIFY(!changedSpy.isEmpty());
+        QVERIFY(name.isValid());
+        QCOMPARE(name.data().toString(), QString("b"));
+
+        // Values shared by the selection are shown
+        props.setTargets({ w0, w1 });
+        QVERIFY(name.data(MixedValuesRole).toBool());
+        QVERIFY(!name.data().isValid());
+        QVERIFY(!zPosition.data(MixedValuesRole).toBool());
+        QCOMPARE(zPosition.data().toInt(), 1);
+        QVERIFY(props.setData(zPosition, 5));
+        QCOMPARE(model.widget(w0).zPosition(), 5);
+        QCOMPARE(model.widget(w1).zPosition(), 5);
+
+        props.setWidget(QModelIndex());
+        QCOMPARE(resetSpy.size(), 2);
+        QCOMPARE(props.rowCount(), 0);
+    }
+
+    void test_bulkLoad()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        QAbstractItemModelTester modelTester(&model, this);
+        model.insertRow(0, QModelIndex());
+        QVERIFY(model.undoStack()->count() > 0);
+
+        QSignalSpy resetSpy(&model, &QAbstractItemModel::modelReset);
+        QSignalSpy insertSpy(&model, &QAbstractItemModel::rowsInserted);
+        QXmlStreamReader xml(R"(<skin>
+            <screen name="a"><widget name="w" position="10,10" size="20,20"/></screen>
+            <screen name="b"/>
+        </skin>)");
+        xml.readNextStartElement();
+        model.beginBulkLoad();
+        while (xml.readNextStartElement()) {
+            model.appendFromXml(xml);
+        }
+        model.endBulkLoad();
+
+        // Old screens are replaced and new ones published at once
+        QCOMPARE(resetSpy.size(), 1);
+        QCOMPARE(insertSpy.size(), 0);
+        QCOMPARE(model.rowCount(), 2);
+        QCOMPARE(model.undoStack()->count(), 0);
+        auto w = model.index(0, 0, model.index(0, 0));
+        QCOMPARE(model.widget(w).name(), QString("w"));
+        QVERIFY(model.widgetById(model.idFromIndex(w)) == &model.widget(w));
+
+        model.clear();
+        QCOMPARE(resetSpy.size(), 2);
+        QCOMPARE(model.rowCount(), 0);
+        QCOMPARE(model.undoStack()->count(), 0);
+    }
+
+    void test_repositoryScope()
+    {
+        // The default repository and the shared storage live in the main thread
+        auto& editor = SkinRepository::instance();
+        // Each repository is its own document, so they load in parallel
+        auto load = [](int xres) {
+            SkinRepository repository;
+            repository.setHeadless(true);
+            QXmlStreamReader xml(QString(R"(<skin>
+                <output id="0"><resolution xres="%1" yres="576"/></output>
+                <screen name="main" position="center,0" size="100,100"/>
+            </skin>)")
+                                   .arg(xres));
+            if (!repository.fromXmlDocument(xml))
+                return -1;
+            SkinRepository::Scope scope(&repository);
+            if (&SkinRepository::current() != &repository)
+                return -1;
+            auto* screens = SkinRepository::screens();
+            return screens->widget(screens->index(0, 0)).absolutePosition().x();
+        };
+        const QList<int> widths = { 720, 1280, 1920, 3840 };
+        const QList<int> positions = QtConcurrent::blockingMapped<QList<int>>(widths, load);
+        QCOMPARE(positions, QList<int>({ 310, 590, 910, 1870 }));
+        QCOMPARE(&SkinRepository::current(), &editor);
+    }
+
+    void test_snapshot()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        model.insertRows(0, 2, QModelIndex());
+        for (int i = 0; i < 2; ++i) {
+            auto s = model.index(i, 0);
+            model.setWidgetAttr(s, Property::name, QString("screen%1").arg(i));
+            model.insertRow(0, s);
+            model.setWidgetAttr(model.index(0, 0, s), Property::name, "w");
+        }
+        const uint w0 = model.idFromIndex(model.index(0, 0, model.index(0, 0)));
+
+        ModelSnapshotBuilder builder(&model);
+        auto first = builder.take();
+        QVERIFY(builder.take() == first);
+        QCOMPARE(first->screens.size(), 2);
+        QCOMPARE(first->find(w0)->name(), QString("w"));
+
+        // Only the path to the changed widget is copied
+        model.setWidgetAttr(model.indexFromId(w0), Property::name, "changed");
+        auto second = builder.take();
+        QVERIFY(second->generation > first->generation);
+        QVERIFY(second->screens[0] != first->screens[0]);
+        QVERIFY(second->screens[1] == first->screens[1]);
+        QCOMPARE(second->find(w0)->name(), QString("changed"));
+        QCOMPARE(first->find(w0)->name(), QString("w"));
+
+        // Readers in other threads see their generation only
+        auto future = QtConcurrent::run([first, w0] { return first->find(w0)->name(); });
+        model.removeWidgets({ model.indexFromId(w0) });
+        QCOMPARE(future.result(), QString("w"));
+        QVERIFY(!builder.take()->find(w0));
+        QVERIFY(first->find(w0));
+    }
+
+    void test_screenEstimator()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        model.insertRow(0, QModelIndex());
+        auto s = model.index(0, 0, QModelIndex());
+        model.setWidgetAttr(s, Property::name, "main");
+        model.setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(100, 100)));
+        model.insertRows(0, 2, s);
+        auto setXml = [&](int row, const QString& text) {
+            QXmlStreamReader xml(text);
+            xml.readNextStartElement();
+            QVERIFY(model.setWidgetDataFromXml(model.index(row, 0, s), xml));
+        };
+        setXml(0, R"(<widget name="w0" position="0,0" size="50,100" pixmap="a.png"/>)");
+        setXml(1, R"(<eLabel name="w1" position="50,0" size="50,50" transparent="1" text="x"/>)");
+        const uint screen = model.idFromIndex(s);
+
+        // Opaque pixmap hides its background and half of the screen,
+        // the transparent label is blended over the screen
+        ModelSnapshotBuilder builder(&model);
+        auto snapshot = builder.take();
+        auto size = [](const QString& name) {
+            return name == "a.png" ? QSize(10, 10) : QSize();
+        };
+        ScreenEstimate e = ScreenEstimator::estimate(*snapshot->screens[0], 16, size);
+        QCOMPARE(e.screenId, screen);
+        QCOMPARE(e.pixmapCount, 1);
+        QCOMPARE(e.pixmapBytes, qint64(200));
+        QCOMPARE(e.screenArea, qint64(10000));
+        QCOMPARE(e.paintedArea, qint64(12500));
+        QCOMPARE(e.blendedLayers, 1);
+        QCOMPARE(e.overdraw(), 1.25);
+
+        ScreenEstimator estimator(&model);
+        QAbstractItemModelTester modelTester(&estimator, this);
+        estimator.estimateNow();
+        QCOMPARE(estimator.rowCount(), 1);
+        QCOMPARE(estimator.index(0, 0).data(ScreenEstimator::WidgetIdRole).toUInt(), screen);
+        // There is no such file
+        QCOMPARE(estimator.estimates().first().pixmapCount, 0);
+
+        // Changes are estimated in the background
+        QSignalSpy spy(&estimator, &ScreenEstimator::finished);
+        model.setWidgetAttr(model.index(1, 0, s), Property::transparent, false);
+        QVERIFY(spy.wait());
+        QCOMPARE(estimator.estimates().first().blendedLayers, 0);
+        QCOMPARE(estimator.estimates().first().paintedArea, qint64(10000));
+
+        // Invalidated while a run is pending, the stale result is not cached
+        // and the screen is estimated again
+        auto connection = connect(&estimator, &ScreenEstimator::started, [&estimator] {
+            estimator.setBpp(16);
+        });
+        spy.clear();
+        model.setWidgetAttr(model.index(1, 0, s), Property::transparent, true);
+        QVERIFY(spy.wait());
+        disconnect(connection);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(estimator.estimates().first().blendedLayers, 1);
+        QCOMPARE(estimator.estimates().first().paintedArea, qint64(12500));
+    }
+
+    void test_retarget()
+    {
+        SkinRepository repository;
+        QXmlStreamReader xml(R"(<skin>
+            <output id="0"><resolution xres="1280" yres="720" bpp="32"/></output>
+            <windowstyle id="0" type="skinned"><title offset="20,5" font="Regular;20"/></windowstyle>
+            <screen name="main" position="center,center" size="640,360">
+                <widget name="list" position="10,20" size="100,50" font="Regular;20"
+                        itemHeight="30" borderWidth="1" shadowOffset="2,2"/>
+                <eLabel name="label" position="center,50%" size="60,20"/>
+            </screen>
+        </skin>)");
+        QVERIFY(repository.fromXmlDocument(xml));
+        SkinRepository::Scope scope(&repository);
+        auto* model = SkinRepository::screens();
+        auto* outputs = SkinRepository::outputs();
+        auto* styles = SkinRepository::styles();
+        const auto screen = model->index(0, 0);
+        const auto list = model->index(0, 0, screen);
+        const auto label = model->index(1, 0, screen);
+        auto attr = [model](const QModelIndex& index, int key) {
+            return model->widget(index).attrString(key);
+        };
+
+        QSignalSpy spy(model, &ScreensModel::widgetsChanged);
+        QVERIFY(!model->retarget(QSize(1280, 720), *outputs, *styles));
+        QVERIFY(model->retarget(QSize(1920, 1080), *outputs, *styles));
+        // One undo step and one notification
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(model->undoStack()->count(), 1);
+        QCOMPARE(outputs->getOutput(0).size(), QSize(1920, 1080));
+        QCOMPARE(model->outputSize(), QSize(1920, 1080));
+        QCOMPARE(attr(screen, Property::position), QString("center,center"));
+        QCOMPARE(attr(screen, Property::size), QString("960,540"));
+        QCOMPARE(attr(list, Property::position), QString("15,30"));
+        QCOMPARE(attr(list, Property::size), QString("150,75"));
+        QCOMPARE(attr(list, Property::font), QString("Regular;30"));
+        QCOMPARE(attr(list, Property::itemHeight), QString("45"));
+        QCOMPARE(attr(list, Property::borderWidth), QString("2"));
+        QCOMPARE(attr(list, Property::shadowOffset), QString("3,3"));
+        QCOMPARE(attr(label, Property::position), QString("center,50%"));
+        QCOMPARE(attr(label, Property::size), QString("90,30"));
+        QCOMPARE(styles->getStyle(0).title().position.toStr(), QString("30,8"));
+        QCOMPARE(styles->getStyle(0).title().font.toStr(), QString("Regular;30"));
+
+        model->undoStack()->undo();
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(outputs->getOutput(0).size(), QSize(1280, 720));
+        QCOMPARE(attr(screen, Property::size), QString("640,360"));
+        QCOMPARE(attr(list, Property::position), QString("10,20"));
+        QCOMPARE(attr(list, Property::font), QString("Regular;20"));
+        QCOMPARE(styles->getStyle(0).title().position.toStr(), QString("20,5"));
+    }
+
+    void test_mergeChildren()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+        QAbstractItemModelTester modelTester(&model, this);
+        auto parse = [](const QString& text) {
+            QVector<WidgetData*> items;
+            QXmlStreamReader xml(text);
+            xml.readNextStartElement();
+            while (xml.readNextStartElement()) {
+                auto* screen = new WidgetData();
+                screen->fromXml(xml);
+                items.append(screen);
+            }
+            return items;
+        };
+        QXmlStreamReader xml(R"(<skin>
+            <screen name="a"><widget name="w" position="10,10" size="20,20"/></screen>
+            <screen name="b"/>
+        </skin>)");
+        xml.readNextStartElement();
+        model.beginBulkLoad();
+        while (xml.readNextStartElement()) {
+            model.appendFromXml(xml);
+        }
+        model.endBulkLoad();
+        QCOMPARE(model.rowCount(), 2);
+        const uint a = model.idFromIndex(model.index(0, 0));
+        const uint w = model.idFromIndex(model.index(0, 0, model.index(0, 0)));
+
+        const QString changed = R"(<skin>
+            <screen name="a">
+                <widget name="w" position="20,10" size="20,20"/>
+                <widget name="x"/>
+            </screen>
+            <screen name="c"/>
+        </skin>)";
+        QVERIFY(model.mergeChildren(QModelIndex(), parse(changed), "Reload"));
+        QCOMPARE(model.undoStack()->count(), 1);
+
+        // Matched widgets keep their ids
+        QCOMPARE(model.idFromIndex(model.index(0, 0)), a);
+        QCOMPARE(model.rowCount(model.index(0, 0)), 2);
+        QCOMPARE(model.widgetById(w)->attrString(Property::position), QString("20,10"));
+        QCOMPARE(model.widget(model.index(1, 0)).name(), QString("c"));
+
+        // Same content gives no undo step
+        QVERIFY(!model.mergeChildren(QModelIndex(), parse(changed), "Reload"));
+        QCOMPARE(model.undoStack()->count(), 1);
+
+        model.undoStack()->undo();
+        QCOMPARE(model.widgetById(w)->attrString(Property::position), QString("10,10"));
+        QCOMPARE(model.rowCount(model.index(0, 0)), 1);
+        QCOMPARE(model.widget(model.index(1, 0)).name(), QString("b"));
+
+        // Reordered siblings are moved, ids and preview values are kept
+        const uint b = model.idFromIndex(model.index(1, 0));
+        model.setWidgetAttr(model.indexFromId(w), Property::previewValue, "42");
+        const int steps = model.undoStack()->count();
+        const QString reordered = R"(<skin>
+            <screen name="b"/>
+            <screen name="a"><widget name="w" position="10,10" size="20,20"/></screen>
+        </skin>)";
+        QVERIFY(model.mergeChildren(QModelIndex(), parse(reordered), "Reload"));
+        QCOMPARE(model.undoStack()->count(), steps + 1);
+        QCOMPARE(model.idFromIndex(model.index(0, 0)), b);
+        QCOMPARE(model.idFromIndex(model.index(1, 0)), a);
+        QCOMPARE(model.idFromIndex(model.index(0, 0, model.index(1, 0))), w);
+        QCOMPARE(model.widgetAttr(model.indexFromId(w), Property::previewValue), "42");
+        model.undoStack()->undo();
+        QCOMPARE(model.idFromIndex(model.index(0, 0)), a);
+        QCOMPARE(model.idFromIndex(model.index(1, 0)), b);
+    }
+
+    void test_openCloseBenchmark()
+    {
+        auto* colors = new ColorsModel(this);
+        auto* colorRoles = new ColorRolesModel(*colors, this);
+        auto* fonts = new FontsModel(this);
+        ScreensModel model(*colors, *colorRoles, *fonts, this);
+
+        QString text = "<skin>";
+        for (int i = 0; i < 200; ++i) {
+            text += QString(R"(<screen name="s%1" position="center,center" size="720,576">)")
+                      .arg(i);
+            for (int j = 0; j < 50; ++j) {
+                text += R"(<widget name="w" position="10,10" size="100,20" font="Regular;20"/>)";
+            }
+            text += "</screen>";
+        }
+        text += "</skin>";
+
+        QBENCHMARK
+        {
+            QXmlStreamReader xml(text);
+            xml.readNextStartElement();
+            model.beginBulkLoad();
+            while (xml.readNextStartElement()) {
+                model.appendFromXml(xml);
+            }
+            model.endBulkLoad();
+            model.clear();
+        }
+        QCOMPARE(model.rowCount(), 0);
+    }
 };
 
-QTEST_APPLESS_MAIN(TestScreensModel)
+QTEST_GUILESS_MAIN(TestScreensModel)
 
 #include "tst_screensmodel.moc"
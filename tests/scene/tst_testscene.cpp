@@ -1,6 +1,11 @@
 #include <QtTest>
+#include <QGraphicsSceneMouseEvent>
 #include "scene/screenview.hpp"
 #include "repository/skinrepository.hpp"
+#include "base/xmlstreamwriter.hpp"
+#include "model/thumbnailsmodel.hpp"
+#include "scene/spatialgrid.hpp"
+#include "scene/geometryindex.hpp"
 
 // add necessary includes here
 
@@ -37,10 +42,455 @@ private slots:
         qDebug() << selection->currentIndex().data();
     }
 
+    void test_resolveCache()
+    {
+        auto& repository = SkinRepository::instance();
+        auto before = repository.resolveCacheStats();
+        // Path prefixed with the skin directory name
+        auto path = repository.resolveFilename("scene/skin.xml");
+        QVERIFY(!path.isEmpty());
+        QCOMPARE(repository.resolveFilename("scene/skin.xml"), path);
+        auto after = repository.resolveCacheStats();
+        QCOMPARE(after.misses - before.misses, quint64(1));
+        QCOMPARE(after.hits - before.hits, quint64(1));
+        // Unresolved names are looked up every time
+        QVERIFY(repository.resolveFilename("scene/nonexistent.png").isNull());
+        QVERIFY(repository.resolveFilename("scene/nonexistent.png").isNull());
+        QCOMPARE(repository.resolveCacheStats().misses - after.misses, quint64(2));
+    }
+
+    void test_modelCache()
+    {
+        auto& repository = SkinRepository::instance();
+        QString origin = repository.dir().path();
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QFile::copy(QFINDTESTDATA("skin.xml"), QDir(dir.path()).filePath("skin.xml")));
+
+        repository.setCacheEnabled(true);
+        QVERIFY(repository.open(dir.path()));
+        QVERIFY(!repository.isLoadedFromCache());
+        QFile cache(repository.cacheFilePath());
+        QVERIFY(cache.open(QIODevice::ReadOnly));
+        QByteArray cached = cache.readAll();
+        cache.close();
+        QByteArray xml = skinXml();
+
+        // Loaded from the cache
+        QVERIFY(repository.open(dir.path()));
+        QVERIFY(repository.isLoadedFromCache());
+        QCOMPARE(skinXml(), xml);
+        QCOMPARE(m_model->rowCount(), 1);
+        QCOMPARE(m_model->rowCount(m_model->index(0, 0)), 1);
+
+        // Source changes skip the stale cache and rewrite it
+        QFile file(repository.skinFilePath());
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(R"(<skin><screen name="changed"><widget name="a"/><widget name="b"/>)"
+                   R"(</screen></skin>)");
+        file.close();
+        QVERIFY(repository.open(dir.path()));
+        QVERIFY(!repository.isLoadedFromCache());
+        QCOMPARE(m_model->widget(m_model->index(0, 0)).name(), QString("changed"));
+        QCOMPARE(m_model->rowCount(m_model->index(0, 0)), 2);
+        QVERIFY(cache.open(QIODevice::ReadOnly));
+        QVERIFY(cache.readAll() != cached);
+        cache.close();
+
+        QVERIFY(repository.open(dir.path()));
+        QVERIFY(repository.isLoadedFromCache());
+        QCOMPARE(m_model->widget(m_model->index(0, 0)).name(), QString("changed"));
+        QCOMPARE(m_model->rowCount(m_model->index(0, 0)), 2);
+
+        repository.setCacheEnabled(false);
+        QVERIFY(repository.open(origin));
+    }
+
+    void test_thumbnails()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        ThumbnailsModel thumbnails(m_model);
+        thumbnails.setCacheDirectory(dir.path());
+        QCOMPARE(thumbnails.rowCount(), m_model->rowCount());
+
+        QModelIndex screen = m_model->index(0, 0);
+        uint id = m_model->idFromIndex(screen);
+        auto takeSnapshot = [&] { return ScreenSnapshot::fromScreen(*m_model->widgetById(id)); };
+        auto snapshot = takeSnapshot();
+        const QSize size = thumbnails.thumbnailSize();
+        QCOMPARE(snapshot.items.size(), 2);
+        QCOMPARE(snapshot.render(size).size(), size);
+        QCOMPARE(takeSnapshot().hash(size), snapshot.hash(size));
+
+        // Changes in the subtree bump the screen generation and the content hash
+        quint64 generation = thumbnails.generation(id);
+        m_model->moveWidget(m_model->index(0, 0, screen), QPoint(10, 20));
+        QVERIFY(thumbnails.generation(id) > generation);
+        QVERIFY(takeSnapshot().hash(size) != snapshot.hash(size));
+        m_model->undoStack()->undo();
+
+        // Rendered in the background when the view asks for it and stored on disk
+        thumbnails.data(thumbnails.index(0, 0), Qt::DecorationRole);
+        QTRY_COMPARE(QDir(dir.path()).entryList({ "*.png" }).size(), 1);
+
+        // Old entries are removed from the disk cache
+        const QString old = QDir(dir.path()).filePath("old.png");
+        QFile file(old);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.setFileTime(QDateTime::currentDateTime().addDays(-60),
+                                 QFileDevice::FileModificationTime));
+        file.close();
+        thumbnails.setCacheDirectory(dir.path());
+        QVERIFY(!QFileInfo::exists(old));
+        QCOMPARE(QDir(dir.path()).entryList({ "*.png" }).size(), 1);
+    }
+
+    void test_includeThumbnails()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        auto write = [&](const QString& name, const QByteArray& data) {
+            QFile file(QDir(dir.path()).filePath(name));
+            return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+        };
+        QVERIFY(write("skin.xml",
+                      R"(<skin><screen name="top"/><include filename="inc.xml"/></skin>)"));
+        QVERIFY(write("inc.xml",
+                      R"(<skin><screen name="a"><widget name="w"/></screen>)"
+                      R"(<screen name="b"/></skin>)"));
+
+        SkinRepository repository;
+        SkinRepository::Scope scope(&repository);
+        QVERIFY(repository.open(dir.path()));
+        auto* model = SkinRepository::screens();
+        QTemporaryDir cache;
+        QVERIFY(cache.isValid());
+        ThumbnailsModel thumbnails(model);
+        thumbnails.setCacheDirectory(cache.path());
+
+        // Screens of the include are listed instead of the include itself
+        QCOMPARE(thumbnails.rowCount(), 3);
+        QCOMPARE(thumbnails.index(1, 0).data().toString(), QString("a"));
+        QCOMPARE(thumbnails.index(2, 0).data().toString(), QString("b"));
+        const QModelIndex include = model->index(1, 0);
+        const QModelIndex screen = model->index(0, 0, include);
+        QCOMPARE(thumbnails.mapToSource(thumbnails.index(1, 0)), screen);
+
+        // Edits inside an included screen invalidate that screen
+        const uint id = model->idFromIndex(screen);
+        const quint64 generation = thumbnails.generation(id);
+        model->moveWidget(model->index(0, 0, screen), QPoint(10, 20));
+        QVERIFY(thumbnails.generation(id) > generation);
+        QCOMPARE(thumbnails.generation(model->idFromIndex(include)), quint64(0));
+
+        thumbnails.data(thumbnails.index(1, 0), Qt::DecorationRole);
+        QTRY_COMPARE(QDir(cache.path()).entryList({ "*.png" }).size(), 1);
+    }
+
+    void test_mipmaps()
+    {
+        QCOMPARE(PixmapStorage::mipmapLevel(1.0), 0);
+        QCOMPARE(PixmapStorage::mipmapLevel(0.6), 0);
+        QCOMPARE(PixmapStorage::mipmapLevel(0.3), 1);
+        QCOMPARE(PixmapStorage::mipmapLevel(0.2), 2);
+        QCOMPARE(PixmapStorage::mipmapLevel(0.001), PixmapStorage::maxMipmapLevel);
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = QDir(dir.path()).filePath("image.png");
+        QImage image(64, 32, QImage::Format_ARGB32);
+        image.fill(Qt::red);
+        QVERIFY(image.save(path));
+
+        QCOMPARE(PixmapStorage::mipmap(path, 0).size(), QSize(64, 32));
+        QCOMPARE(PixmapStorage::mipmap(path, 1).size(), QSize(32, 16));
+        QCOMPARE(PixmapStorage::mipmap(path, 3).size(), QSize(8, 4));
+        QCOMPARE(PixmapStorage::mipmap(path, 3).toImage().pixelColor(4, 2), QColor(Qt::red));
+    }
+
+    void test_pixmapReload()
+    {
+        struct Watcher : PixmapWatcher
+        {
+            using PixmapWatcher::PixmapWatcher;
+            void fileChangedEvent() override { ++changes; }
+            int changes = 0;
+        };
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString path = QDir(dir.path()).filePath("image.png");
+        auto encode = [](const QSize& size) {
+            QImage image(size, QImage::Format_ARGB32);
+            image.fill(Qt::blue);
+            QByteArray data;
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::WriteOnly);
+            image.save(&buffer, "png");
+            return data;
+        };
+        auto writeInPlace = [&](const QByteArray& data) {
+            QFile file(path);
+            return file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+                   && file.write(data) == data.size();
+        };
+        QVERIFY(writeInPlace(encode(QSize(16, 16))));
+
+        Watcher watcher(path);
+        QCOMPARE(PixmapStorage::pixmap(path).size(), QSize(16, 16));
+
+        // Rewritten without replacing the file, the directory does not change
+        // and the stamp poll finds it
+        QVERIFY(writeInPlace(encode(QSize(24, 8))));
+        QTRY_VERIFY(watcher.changes > 0);
+        QCOMPARE(PixmapStorage::pixmap(path).size(), QSize(24, 8));
+    }
+
+    void test_spatialGrid()
+    {
+        SpatialGrid grid(100);
+        grid.insert(1, QRect(10, 10, 20, 20));
+        grid.insert(2, QRect(150, 10, 200, 20)); // spans several cells
+        grid.insert(3, QRect(-50, -50, 10, 10));
+        grid.insert(4, QRect(0, 0, 100000, 10)); // too large for cells
+        auto sorted = [](QVector<uint> ids) {
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        QCOMPARE(sorted(grid.query(QRect(0, 0, 50, 50))), QVector<uint>({ 1, 4 }));
+        QCOMPARE(sorted(grid.query(QRect(300, 0, 10, 10))), QVector<uint>({ 2, 4 }));
+        QCOMPARE(grid.query(QRect(-60, -60, 15, 15)), QVector<uint>({ 3 }));
+
+        grid.insert(1, QRect(500, 500, 10, 10));
+        QCOMPARE(sorted(grid.query(QRect(0, 0, 50, 50))), QVector<uint>({ 4 }));
+        grid.remove(4);
+        QCOMPARE(grid.query(QRect(495, 495, 10, 10)), QVector<uint>({ 1 }));
+        QCOMPARE(grid.size(), 3);
+    }
+
+    void test_virtualItems()
+    {
+        m_model->insertRow(m_model->rowCount(), QModelIndex());
+        QModelIndex s = m_model->index(m_model->rowCount() - 1, 0);
+        m_model->setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(4000, 4000)));
+        const int count = 100;
+        m_model->insertRows(0, count, s);
+        for (int i = 0; i < count; ++i) {
+            auto w = m_model->index(i, 0, s);
+            m_model->setWidgetAttr(w, Property::size, QVariant::fromValue(SizeAttr(100, 100)));
+            m_model->moveWidget(w, QPoint(i % 10 * 400, i / 10 * 400));
+        }
+
+        // Only widgets near the visible area get items
+        SkinScene scene(m_model);
+        scene.setVisibleRect(QRectF(0, 0, 300, 300));
+        ScreenView view(m_model, s, &scene);
+        QVERIFY(view.itemCount() > 0);
+        QVERIFY(view.itemCount() < count / 4);
+
+        // Items follow the viewport and a selected widget keeps its item
+        auto selection = new QItemSelectionModel(m_model, this);
+        view.setSelectionModel(selection);
+        selection->select(m_model->index(count - 1, 0, s), QItemSelectionModel::Select);
+        uint last = m_model->idFromIndex(m_model->index(count - 1, 0, s));
+        QCOMPARE(scene.selectedItems().size(), 1);
+        view.setVisibleRect(QRectF(1000, 1000, 300, 300));
+        QCOMPARE(scene.selectedItems().size(), 1);
+        auto* selected = qgraphicsitem_cast<WidgetGraphicsItem*>(scene.selectedItems().first());
+        QCOMPARE(selected->widgetId(), last);
+        QVERIFY(view.itemCount() < count / 4);
+
+        view.setVisibleRect(QRectF());
+        QCOMPARE(view.itemCount(), count);
+
+        m_model->removeWidgets({ s });
+        delete selection;
+    }
+
+    void test_repaintAttributes()
+    {
+        m_model->insertRow(m_model->rowCount(), QModelIndex());
+        QModelIndex s = m_model->index(m_model->rowCount() - 1, 0);
+        m_model->setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(400, 400)));
+        m_model->insertRow(0, s);
+        auto w = m_model->index(0, 0, s);
+        m_model->setWidgetAttr(w, Property::size, QVariant::fromValue(SizeAttr(100, 20)));
+        const uint id = m_model->idFromIndex(w);
+
+        SkinScene scene(m_model);
+        ScreenView view(m_model, s, &scene);
+        WidgetGraphicsItem* item = nullptr;
+        for (auto* i : scene.items()) {
+            auto* widget = qgraphicsitem_cast<WidgetGraphicsItem*>(i);
+            if (widget && widget->widgetId() == id) {
+                item = widget;
+            }
+        }
+        QVERIFY(item);
+
+        // Attributes painted without being cached still repaint the item
+        QSignalSpy spy(&scene, &QGraphicsScene::changed);
+        QCoreApplication::processEvents();
+        auto repainted = [&] {
+            for (const auto& args : qAsConst(spy)) {
+                for (const auto& rect : args.first().value<QList<QRectF>>()) {
+                    if (rect.intersects(item->sceneBoundingRect()))
+                        return true;
+                }
+            }
+            return false;
+        };
+        spy.clear();
+        m_model->setWidgetAttr(w, Property::text, "text");
+        QTRY_VERIFY(repainted());
+        spy.clear();
+        m_model->setWidgetAttr(w, Property::font, QVariant::fromValue(FontAttr("Regular;30")));
+        QTRY_VERIFY(repainted());
+
+        m_model->removeWidgets({ s });
+    }
+
+    void test_dragCommit()
+    {
+        m_model->insertRow(m_model->rowCount(), QModelIndex());
+        QModelIndex s = m_model->index(m_model->rowCount() - 1, 0);
+        m_model->setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(400, 400)));
+        m_model->insertRow(0, s);
+        auto w = m_model->index(0, 0, s);
+        m_model->setWidgetAttr(w, Property::size, QVariant::fromValue(SizeAttr(50, 20)));
+        m_model->moveWidget(w, QPoint(100, 100));
+        const uint id = m_model->idFromIndex(w);
+        auto position = [&] { return m_model->widgetById(id)->attrString(Property::position); };
+
+        SkinScene scene(m_model);
+        ScreenView view(m_model, s, &scene);
+        WidgetGraphicsItem* item = nullptr;
+        for (auto* i : scene.items()) {
+            auto* widget = qgraphicsitem_cast<WidgetGraphicsItem*>(i);
+            if (widget && widget->widgetId() == id) {
+                item = widget;
+            }
+        }
+        QVERIFY(item);
+        item->setSelected(true);
+
+        QPointF start;
+        QPointF last;
+        auto send = [&](QEvent::Type type, const QPointF& pos) {
+            QGraphicsSceneMouseEvent event(type);
+            event.setScenePos(pos);
+            event.setLastScenePos(last);
+            event.setButtonDownScenePos(Qt::LeftButton, start);
+            event.setButton(type == QEvent::GraphicsSceneMouseMove ? Qt::NoButton
+                                                                   : Qt::LeftButton);
+            event.setButtons(type == QEvent::GraphicsSceneMouseRelease ? Qt::NoButton
+                                                                       : Qt::LeftButton);
+            QCoreApplication::sendEvent(&scene, &event);
+            last = pos;
+        };
+        auto press = [&] {
+            start = last = item->sceneBoundingRect().center();
+            send(QEvent::GraphicsSceneMousePress, start);
+            QCOMPARE(scene.mouseGrabberItem(), item);
+        };
+
+        // The model gets one command on release
+        int steps = m_model->undoStack()->count();
+        press();
+        send(QEvent::GraphicsSceneMouseMove, start + QPointF(15, 0));
+        send(QEvent::GraphicsSceneMouseMove, start + QPointF(30, 0));
+        QCOMPARE(position(), QString("100,100"));
+        send(QEvent::GraphicsSceneMouseRelease, start + QPointF(30, 0));
+        QCOMPARE(position(), QString("130,100"));
+        QCOMPARE(m_model->undoStack()->count(), steps + 1);
+
+        // A lost grab commits the drag as well
+        press();
+        send(QEvent::GraphicsSceneMouseMove, start + QPointF(0, 20));
+        scene.mouseGrabberItem()->ungrabMouse();
+        QCOMPARE(position(), QString("130,120"));
+        QCOMPARE(m_model->undoStack()->count(), steps + 2);
+
+        // Later moves go to the model right away again
+        item->moveBy(5, 0);
+        QCOMPARE(position(), QString("135,120"));
+
+        m_model->removeWidgets({ s });
+    }
+
+    void test_geometryIndex()
+    {
+        m_model->insertRow(m_model->rowCount(), QModelIndex());
+        QModelIndex s = m_model->index(m_model->rowCount() - 1, 0);
+        m_model->setWidgetAttr(s, Property::size, QVariant::fromValue(SizeAttr(1000, 1000)));
+        m_model->insertRows(0, 2, s);
+        auto a = m_model->index(0, 0, s);
+        auto b = m_model->index(1, 0, s);
+        m_model->setWidgetAttr(a, Property::size, QVariant::fromValue(SizeAttr(200, 100)));
+        m_model->moveWidget(a, QPoint(100, 100));
+        m_model->setWidgetAttr(b, Property::size, QVariant::fromValue(SizeAttr(100, 100)));
+        m_model->moveWidget(b, QPoint(400, 100));
+
+        GeometryIndex index(m_model);
+        index.setScreen(m_model->idFromIndex(s));
+        QCOMPARE(index.size(), 2);
+
+        // Nested widgets are indexed in screen coordinates
+        m_model->insertRows(0, 1, a);
+        auto c = m_model->index(0, 0, a);
+        m_model->setWidgetAttr(c, Property::size, QVariant::fromValue(SizeAttr(50, 50)));
+        m_model->moveWidget(c, QPoint(10, 10));
+        const uint idA = m_model->idFromIndex(a);
+        const uint idB = m_model->idFromIndex(b);
+        const uint idC = m_model->idFromIndex(c);
+        QCOMPARE(index.size(), 3);
+        QCOMPARE(index.rect(idC), QRect(110, 110, 50, 50));
+
+        auto sorted = [](QVector<uint> ids) {
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        QCOMPARE(sorted(index.contained(QRect(0, 0, 350, 300))), sorted({ idA, idC }));
+        QCOMPARE(sorted(index.at(QPoint(120, 120))), sorted({ idA, idC }));
+        QCOMPARE(index.intersecting(QRect(450, 150, 10, 10)), QVector<uint>{ idB });
+        QVERIFY(index.overlapping(idC).isEmpty());
+
+        // Children follow their parent
+        m_model->moveWidget(a, QPoint(350, 100));
+        QCOMPARE(index.rect(idC), QRect(360, 110, 50, 50));
+        QCOMPARE(index.overlapping(idC), QVector<uint>{ idB });
+
+        // Nearest edges within the tolerance, dragged widgets are ignored
+        auto snap = index.snap(QRect(403, 253, 50, 50), GeometryIndex::SnapAll, 5, { idC });
+        QCOMPARE(snap.offset, QPoint(-3, 0));
+        QVERIFY(!snap.lines.isEmpty());
+        snap = index.snap(index.rect(idC), GeometryIndex::SnapAll, 5, { idC });
+        QCOMPARE(snap.offset, QPoint(0, 0));
+        snap = index.snap(QRect(700, 700, 10, 10), GeometryIndex::SnapAll, 5, {});
+        QVERIFY(snap.lines.isEmpty());
+
+        m_model->removeWidgets({ c });
+        QCOMPARE(index.size(), 2);
+        m_model->removeWidgets({ s });
+        QCOMPARE(index.size(), 0);
+    }
+
 private:
     ScreensModel* m_model;
     SkinScene* m_view;
 
+    QByteArray skinXml()
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        XmlStreamWriter xml(&buffer);
+        SkinRepository::instance().toXml(xml);
+        return data;
+    }
+
     void printTree() { printSubTree(QModelIndex()); }
 
     void printSubTree(QModelIndex index, int level = 0)
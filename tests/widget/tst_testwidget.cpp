@@ -142,10 +142,39 @@ private slots:
         QVERIFY(ok);
         QCOMPARE(widgets->widgetAttr(i, Property::transparent), true);
         QCOMPARE(spy.count(), 1);
-        QCOMPARE(spy.first().at(0), i);
+        QCOMPARE(spy.first().at(0).toUInt(), widgets->idFromIndex(i));
         QCOMPARE(spy.first().at(1), Property::transparent);
     }
 
+    void test_widgetIds()
+    {
+        auto colors = new ColorsModel(this);
+        auto colorRoles = new ColorRolesModel(*colors, this);
+        auto fonts = new FontsModel(this);
+        auto widgets = new ScreensModel(*colors, *colorRoles, *fonts, this);
+
+        widgets->insertRows(0, 2);
+        uint id = widgets->idFromIndex(widgets->index(1, 0));
+        QVERIFY(id != UniqueId::invalid);
+        QVERIFY(id != widgets->idFromIndex(widgets->index(0, 0)));
+        QCOMPARE(widgets->widgetById(id), &widgets->widget(widgets->index(1, 0)));
+
+        // Id follows the widget when rows are inserted before it
+        widgets->insertRows(0, 1);
+        QCOMPARE(widgets->indexFromId(id), widgets->index(2, 0));
+        QCOMPARE(widgets->indexFromId(id, ScreensModel::ColumnName), widgets->index(2, 1));
+
+        // Removed widget is not reachable, but comes back with the same id
+        widgets->removeRows(2, 1);
+        QVERIFY(widgets->widgetById(id) == nullptr);
+        QVERIFY(!widgets->indexFromId(id).isValid());
+        widgets->undoStack()->undo();
+        QCOMPARE(widgets->indexFromId(id), widgets->index(2, 0));
+
+        QVERIFY(!widgets->indexFromId(UniqueId::invalid).isValid());
+        QCOMPARE(widgets->idFromIndex(QModelIndex()), UniqueId::invalid);
+    }
+
     void test_colorPalleteSignals()
     {
         auto colors = new ColorsModel(this);
@@ -169,18 +198,18 @@ private slots:
         }
 
         // Tell model to send notifications about our widget
-        WidgetObserverRegistrator r0{ widgets, i0 };
+        WidgetObserverRegistrator r0{ widgets, widgets->idFromIndex(i0) };
         QSignalSpy spy(widgets, &ScreensModel::widgetChanged);
 
         colors->setData(colors->index(0, ColorsModel::ColumnColor),
                         QVariant::fromValue(colDarkRed));
 
         QCOMPARE(spy.count(), 1);
-        QCOMPARE(spy.first().at(0), i0);
+        QCOMPARE(spy.first().at(0).toUInt(), widgets->idFromIndex(i0));
         QCOMPARE(spy.first().at(1), Property::foregroundColor);
         QCOMPARE(widgets->widget(i0).getQColor(Property::foregroundColor), colDarkRed);
 
-        WidgetObserverRegistrator r1{ widgets, i1 };
+        WidgetObserverRegistrator r1{ widgets, widgets->idFromIndex(i1) };
         QCOMPARE(widgets->widget(i1).getQColor(Property::foregroundColor), colDarkRed);
     }
 
@@ -223,7 +252,7 @@ private slots:
 
         widgets->insertRows(0, 1);
         auto index = widgets->index(0, 0);
-        WidgetObserverRegistrator reg{ widgets, index };
+        WidgetObserverRegistrator reg{ widgets, widgets->idFromIndex(index) };
         QCOMPARE(widgets->widget(index).getQColor(Property::backgroundColor), Qt::red);
 
         style.setColor(Role::LabelForeground, ColorAttr(QString("green")));
@@ -233,7 +262,7 @@ private slots:
         QSignalSpy spy(widgets, &ScreensModel::widgetChanged);
         colors->setData(colors->index(0, ColorsModel::ColumnColor), QColor(Qt::darkGreen));
         QCOMPARE(spy.count(), 1);
-        QCOMPARE(spy.first().at(0), index);
+        QCOMPARE(spy.first().at(0).toUInt(), widgets->idFromIndex(index));
         QCOMPARE(spy.first().at(1), Property::foregroundColor);
         QCOMPARE(widgets->widget(index).getQColor(Property::foregroundColor), Qt::darkGreen);
     }